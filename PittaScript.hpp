@@ -1,9 +1,17 @@
 #pragma once
 #include "src/PittaValue.hpp"
+#include "src/PittaArray.hpp"
+#include "src/PittaMap.hpp"
 #include "src/PittaStl.hpp"
 #include "src/PittaTokenScanner.hpp"
 #include "src/PittaResolver.hpp"
+#include "src/PittaOptimiser.hpp"
 #include "src/PittaParser.hpp"
 #include "src/PittaRuntime.hpp"
 #include "src/PittaInterpreter.hpp"
+#include "src/PittaCompiler.hpp"
+#include "src/PittaVM.hpp"
+#include "src/PittaScriptCache.hpp"
+#include "src/PittaIsolate.hpp"
+#include "src/PittaJobs.hpp"
 #include "src/PittaIntegration.hpp"
\ No newline at end of file
@@ -2,10 +2,15 @@
 #include "src/PittaRuntime.hpp"
 #include "src/PittaInterpreter.hpp"
 #include "src/PittaResolver.hpp"
+#include "src/PittaOptimiser.hpp"
 #include "src/PittaStl.hpp"
+#include "src/PittaVM.hpp"
+#include "src/PittaIsolate.hpp"
 #include <fstream>
 #include <sstream>
 #include <chrono>
+#include <thread>
+#include <atomic>
 
 int fib(int n) {
 	if (n <= 1) return n;
@@ -18,23 +23,206 @@ int fib(int n) {
 #include "src/SharedData.hpp"
 
 
+//Scans a large generated script, to keep track of how fast the lexer is
+void lexerBenchmark() {
+	const std::string chunk =
+		"# A class with a few methods\n"
+		"class Particle {\n"
+		"\tinit(x, y) {\n"
+		"\t\tthis.x = x; // Position\n"
+		"\t\tthis.y = y;\n"
+		"\t\tthis.name = \"a particle with a fairly long name\";\n"
+		"\t}\n"
+		"\tstep(dt) {\n"
+		"\t\tif (this.x >= 100 and this.y != 0x1F) {\n"
+		"\t\t\tthis.x = this.x + 1.5 * dt;\n"
+		"\t\t}\n"
+		"\t\treturn this.x << 2 | 0b1010;\n"
+		"\t}\n"
+		"}\n"
+		"\n"
+		"func simulate(count) {\n"
+		"\tvar total = 0;\n"
+		"\tvar i = 0;\n"
+		"\twhile (i < count) {\n"
+		"\t\ttotal = total + Particle(i, i * 2).step(0.016);\n"
+		"\t\ti = i + 1;\n"
+		"\t}\n"
+		"\treturn total;\n"
+		"}\n"
+		"print \"Total: \" ++ str(simulate(1000));\n\n";
+
+	std::string source;
+	const size_t targetSize = 16 * 1024 * 1024;
+	source.reserve(targetSize + chunk.size());
+	while (source.size() < targetSize)
+		source += chunk;
+
+	pitta::Runtime runtime;
+	const double megabytes = source.size() / (1024.0 * 1024.0);
+	const int runs = 5;
+
+	auto measure = [&](const char* name, auto scan) {
+		double best = 0.0;
+		size_t tokenCount = 0;
+		for (int i = 0; i < runs; i++) {
+			std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+			pitta::Scanner scanner(std::string_view(source), &runtime);
+			tokenCount = scan(scanner);
+			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+			const double seconds = std::chrono::duration<double>(end - begin).count();
+			best = std::max(best, megabytes / seconds);
+		}
+		printf("%s: %zu tokens, %.1f MB/s\n", name, tokenCount, best);
+	};
+
+	printf("Scanning %.1f MB, best of %d\n", megabytes, runs);
+	measure("Spans", [](pitta::Scanner& scanner) { return scanner.scanSpans().size(); });
+	measure("Tokens", [](pitta::Scanner& scanner) { return scanner.scanTokens().size(); });
+}
+
+//Runs the same script in many isolates at once, across every core, and checks each gives the answer it gives alone
+void isolateStressTest() {
+	const std::string script =
+		"class Counter {\n"
+		"\tinit(start) { this.count = start; }\n"
+		"\tadd(n) { this.count = this.count + n; return this; }\n"
+		"}\n"
+		"func makeAdder(n) {\n"
+		"\tfunc add(x) { return x + n; }\n"
+		"\treturn add;\n"
+		"}\n"
+		"func main() {\n"
+		"\tvar total = 0;\n"
+		"\tvar name = \"\";\n"
+		"\tfor (var i = 0; i < 20000; i = i + 1) {\n"
+		"\t\tvar adder = makeAdder(i);\n"
+		"\t\ttotal = total + (adder(Counter(i).add(3).count) % 1000);\n"
+		"\t\tvar position = vec2(1.5, 2.5);\n"
+		"\t\tposition.tag = i % 7;\n"
+		"\t\ttotal = total + position.tag;\n"
+		"\t\tname = \"run \" ++ str(i % 50);\n"
+		"\t}\n"
+		"\treturn str(total) ++ \" \" ++ name;\n"
+		"}\n";
+
+	auto runOne = [&script](bool useVM) {
+		pitta::Isolate isolate;
+		if (!isolate.run(script, useVM))
+			return std::string("error");
+		return isolate.interpreter.getFunction("main").call().toString();
+	};
+
+	const std::string expected = runOne(false);
+	const unsigned threadCount = std::max(2u, std::thread::hardware_concurrency());
+	const int isolateCount = int(threadCount) * 8;
+	std::atomic<int> next{ 0 };
+	std::atomic<int> failures{ 0 };
+
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	for (unsigned i = 0; i < threadCount; i++) {
+		workers.emplace_back([&]() {
+			//Half the isolates run on each engine
+			for (int isolate = next++; isolate < isolateCount; isolate = next++) {
+				if (runOne(isolate % 2 == 1) != expected)
+					failures++;
+			}
+		});
+	}
+	for (std::thread& worker : workers)
+		worker.join();
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	printf("Expected \"%s\"\n", expected.c_str());
+	printf("%d isolates on %u threads: %d gave something else, %lld[ms]\n", isolateCount, threadCount, failures.load(),
+		(long long)std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count());
+
+	//Tasks that run parallel_for themselves, so a worker joining its slices runs others, and collects, in its own heap
+	const std::string jobsScript =
+		"func leaf(i, j) {\n"
+		"\tvar name = \"\";\n"
+		"\tfor (var k = 0; k < 50; k = k + 1) { name = \"leaf \" ++ str(k) ++ str(i + j); }\n"
+		"\treturn i * j;\n"
+		"}\n"
+		"func inner(j) {\n"
+		"\tvar results = parallel_for(0, 64, leaf, j);\n"
+		"\tvar total = 0;\n"
+		"\tfor (var i = 0; i < len(results); i = i + 1) { total = total + results[i]; }\n"
+		"\treturn total;\n"
+		"}\n"
+		"func main() {\n"
+		"\tvar results = parallel_for(0, 16, inner);\n"
+		"\tvar total = 0;\n"
+		"\tfor (var j = 0; j < len(results); j = j + 1) { total = total + results[j]; }\n"
+		"\treturn str(total);\n"
+		"}\n";
+	//The sum of i * j over every i below 64 and j below 16
+	const std::string jobsExpected = "241920";
+	for (int useVM = 0; useVM < 2; useVM++) {
+		begin = std::chrono::steady_clock::now();
+		pitta::Isolate isolate;
+		isolate.enableJobs(threadCount);
+		const std::string result = isolate.run(jobsScript, useVM == 1) ? isolate.interpreter.getFunction("main").call().toString() : "error";
+		end = std::chrono::steady_clock::now();
+		printf("Nested parallel_for on the %s with %u workers: %s, %lld[ms]\n", useVM == 1 ? "vm" : "tree walker", threadCount,
+			result == jobsExpected ? "as expected" : ("gave \"" + result + "\"").c_str(),
+			(long long)std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count());
+	}
+}
+
+//Runs the block scope benchmark on both engines, to keep track of what entering a block costs each of them
+void blockBenchmark() {
+	std::ifstream file("ProgramBlocks.txt");
+	std::stringstream source;
+	source << file.rdbuf();
+
+	for (int useVM = 0; useVM < 2; useVM++) {
+		pitta::Isolate isolate;
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		const bool ran = isolate.run(source.str(), useVM == 1);
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		printf("%s: %s%lld[ms]\n", useVM == 1 ? "Bytecode vm" : "Tree walker", ran ? "" : "failed, ",
+			(long long)std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count());
+	}
+}
+
 int main() {
 	std::stringstream buffer;
 
-	std::string programs[] = { "ProgramFib.txt", "ProgramCollision.txt", "ProgramIntegrate.txt", "ProgramPlayground.txt", "example_config"};
-	const int numOfPrograms = 5;
+	std::string programs[] = { "ProgramFib.txt", "ProgramCollision.txt", "ProgramIntegrate.txt", "ProgramPlayground.txt", "example_config", "ProgramCalls.txt"};
+	const int numOfPrograms = 6;
 	printf("What program do you want to run?:\n");
 	for (int i = 0; i < numOfPrograms; i++)
 		printf("\t%s\t%d\n", programs[i].c_str(), i);
+	printf("\tLexer benchmark\t%d\n", numOfPrograms);
+	printf("\tIsolate stress test\t%d\n", numOfPrograms + 1);
+	printf("\tBlock scope benchmark\t%d\n", numOfPrograms + 2);
 	printf(">>");
 	std::string choice = "";
 	std::getline(std::cin, choice);
 	int choiceNum = std::atoi(choice.c_str());
+	if (choiceNum == numOfPrograms) {
+		lexerBenchmark();
+		return 0;
+	}
+	if (choiceNum == numOfPrograms + 1) {
+		isolateStressTest();
+		return 0;
+	}
+	if (choiceNum == numOfPrograms + 2) {
+		blockBenchmark();
+		return 0;
+	}
 	if (choiceNum < 0 || choiceNum >= numOfPrograms) {
 		printf("That was not a valid choice \n\n\n");
 		return main();
 	}
 
+	printf("Run it with the tree walking interpreter (0) or the bytecode vm (1)?\n>>");
+	std::getline(std::cin, choice);
+	const bool useVM = std::atoi(choice.c_str()) == 1;
+
 	std::ifstream file(programs[choiceNum]);
 	buffer << file.rdbuf();
 
@@ -71,11 +259,28 @@ int main() {
 	std::chrono::steady_clock::time_point end_resolve = std::chrono::steady_clock::now();
 	std::cout << "Resolve time = " << std::chrono::duration_cast<std::chrono::milliseconds>(end_resolve - begin_resolve).count() << "[ms]" << std::endl;
 
+	if (!runtime.hadError) {
+		pitta::Optimiser optimiser(&interpreter);
+		std::chrono::steady_clock::time_point begin_optimise = std::chrono::steady_clock::now();
+		optimiser.optimise(tree);
+		std::chrono::steady_clock::time_point end_optimise = std::chrono::steady_clock::now();
+		std::cout << "Optimise time = " << std::chrono::duration_cast<std::chrono::milliseconds>(end_optimise - begin_optimise).count() << "[ms]" << std::endl;
+	}
+
 	if (!runtime.hadError) {
 		std::chrono::steady_clock::time_point begin_run = std::chrono::steady_clock::now();
-		interpreter.interpret(tree.statements);
+		if (useVM) {
+			pitta::VM vm(&interpreter);
+			vm.interpret(tree.statements);
+		}
+		else
+			interpreter.interpret(tree.statements);
 		std::chrono::steady_clock::time_point end_run = std::chrono::steady_clock::now();
 		std::cout << "Run time = " << std::chrono::duration_cast<std::chrono::milliseconds>(end_run - begin_run).count() << "[ms]" << std::endl;
+		std::cout << "Property cache hits = " << runtime.inlineCaches.hits << ", misses = " << runtime.inlineCaches.misses << std::endl;
+		std::cout << "GC collections = " << runtime.gcStats.collections << ", freed = " << runtime.gcStats.objectsFreed
+			<< ", in use = " << runtime.gcStats.bytesInUse << "[B], longest pause = "
+			<< std::chrono::duration_cast<std::chrono::microseconds>(runtime.gcStats.longestPause).count() << "[us]" << std::endl;
 	}
 	else {
 		printf("There was an error, cannot run!\n");
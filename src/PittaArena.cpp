@@ -0,0 +1,82 @@
+#include "PittaArena.hpp"
+#include <stdlib.h>
+#include <algorithm>
+
+namespace pitta {
+
+	void* Arena::allocate(size_t size, size_t alignment) {
+		char* start = (char*)((uintptr_t(cursor) + alignment - 1) & ~uintptr_t(alignment - 1));
+		if (cursor == nullptr || start + size > end) {
+			//Blocks come from malloc, which is aligned for anything a node holds
+			const size_t blockSize = std::max<size_t>(PITTA_ARENA_BLOCK_SIZE, size + alignment);
+			char* block = (char*)malloc(blockSize);
+			if (block == nullptr)
+				throw std::bad_alloc();
+			blocks.emplace_back(block);
+			bytesReserved += blockSize;
+
+			cursor = block;
+			end = block + blockSize;
+			start = (char*)((uintptr_t(cursor) + alignment - 1) & ~uintptr_t(alignment - 1));
+		}
+
+		cursor = start + size;
+		bytesUsed += size;
+		return start;
+	}
+
+	size_t Arena::getBytesUsed()const {
+		return bytesUsed;
+	}
+	size_t Arena::getBytesReserved()const {
+		return bytesReserved;
+	}
+
+	Arena::Arena(Arena&& other) noexcept :
+		blocks(std::move(other.blocks)),
+		cursor(other.cursor),
+		end(other.end),
+		bytesUsed(other.bytesUsed),
+		bytesReserved(other.bytesReserved),
+		finalisers(other.finalisers)
+	{
+		other.blocks.clear();
+		other.cursor = other.end = nullptr;
+		other.bytesUsed = other.bytesReserved = 0;
+		other.finalisers = nullptr;
+	}
+
+	Arena& Arena::operator=(Arena&& other) noexcept {
+		if (this != &other) {
+			release();
+			blocks = std::move(other.blocks);
+			cursor = other.cursor;
+			end = other.end;
+			bytesUsed = other.bytesUsed;
+			bytesReserved = other.bytesReserved;
+			finalisers = other.finalisers;
+
+			other.blocks.clear();
+			other.cursor = other.end = nullptr;
+			other.bytesUsed = other.bytesReserved = 0;
+			other.finalisers = nullptr;
+		}
+		return *this;
+	}
+
+	Arena::~Arena() {
+		release();
+	}
+
+	void Arena::release() {
+		for (Finaliser* finaliser = finalisers; finaliser != nullptr; finaliser = finaliser->next)
+			finaliser->destroy(finaliser->object);
+		finalisers = nullptr;
+
+		for (char* block : blocks)
+			free(block);
+		blocks.clear();
+		cursor = end = nullptr;
+		bytesUsed = bytesReserved = 0;
+	}
+}
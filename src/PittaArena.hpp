@@ -0,0 +1,71 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//Size of each block an arena hands memory out of. Anything bigger than this gets a block of its own
+#ifndef PITTA_ARENA_BLOCK_SIZE
+#define PITTA_ARENA_BLOCK_SIZE (64 * 1024)
+#endif
+
+namespace pitta {
+
+	//Bump pointer allocator for objects that all die together, such as the nodes of a syntax tree.
+	//Objects are laid out one after another in large blocks and are all destroyed along with the arena
+	class Arena {
+	public:
+		template<class T, class... Args>
+		T* make(Args&&... args) {
+			if constexpr (std::is_trivially_destructible<T>::value)
+				return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+			else {
+				//The destructor is remembered in a header just in front of the object
+				constexpr size_t headerSize = (sizeof(Finaliser) + alignof(T) - 1) / alignof(T) * alignof(T);
+				char* memory = (char*)allocate(headerSize + sizeof(T), alignof(T) > alignof(Finaliser) ? alignof(T) : alignof(Finaliser));
+				T* object = new (memory + headerSize) T(std::forward<Args>(args)...);
+
+				Finaliser* finaliser = new (memory + headerSize - sizeof(Finaliser)) Finaliser{ &destroy<T>, object, finalisers };
+				finalisers = finaliser;
+				return object;
+			}
+		}
+
+		void* allocate(size_t size, size_t alignment);
+
+		//Bytes handed out so far, and bytes reserved from the system for them
+		size_t getBytesUsed()const;
+		size_t getBytesReserved()const;
+
+		Arena() = default;
+		Arena(Arena&& other) noexcept;
+		Arena& operator=(Arena&& other) noexcept;
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+		~Arena();
+
+	private:
+		struct Finaliser {
+			void (*destroy)(void*);
+			void* object;
+			Finaliser* next;
+		};
+
+		template<class T>
+		static void destroy(void* object) {
+			static_cast<T*>(object)->~T();
+		}
+
+		std::vector<char*> blocks;
+		char* cursor = nullptr;
+		char* end = nullptr;
+		size_t bytesUsed = 0;
+		size_t bytesReserved = 0;
+		//Newest first, so objects are destroyed in the reverse order they were made
+		Finaliser* finalisers = nullptr;
+
+		void release();
+	};
+}
@@ -0,0 +1,160 @@
+#include "PittaArray.hpp"
+#include <algorithm>
+
+namespace pitta {
+
+	size_t ArrayObject::size()const {
+		switch (storage) {
+		case Storage::Ints:
+			return ints.size();
+		case Storage::Floats:
+			return floats.size();
+		default:
+			return values.size();
+		}
+	}
+	bool ArrayObject::empty()const {
+		return size() == 0;
+	}
+	ArrayObject::Storage ArrayObject::getStorage()const {
+		return storage;
+	}
+
+	Value ArrayObject::get(const Value& index)const {
+		return get(checkIndex(index));
+	}
+	Value ArrayObject::get(size_t index)const {
+		switch (storage) {
+		case Storage::Ints:
+			return ints[index];
+		case Storage::Floats:
+			return floats[index];
+		default:
+			return values[index];
+		}
+	}
+
+	void ArrayObject::set(const Value& index, const Value& value) {
+		const size_t i = checkIndex(index);
+		prepareFor(value);
+		switch (storage) {
+		case Storage::Ints:
+			ints[i] = value.intValue();
+			break;
+		case Storage::Floats:
+			floats[i] = value.floatValue();
+			break;
+		default:
+			values[i] = value;
+		}
+	}
+
+	void ArrayObject::push(const Value& value) {
+		prepareFor(value);
+		switch (storage) {
+		case Storage::Ints:
+			ints.emplace_back(value.intValue());
+			break;
+		case Storage::Floats:
+			floats.emplace_back(value.floatValue());
+			break;
+		default:
+			values.emplace_back(value);
+		}
+	}
+
+	Value ArrayObject::pop() {
+		if (empty())
+			throw new PittaRuntimeException("Can't pop from an empty array.");
+		Value last = get(size() - 1);
+		switch (storage) {
+		case Storage::Ints:
+			ints.pop_back();
+			break;
+		case Storage::Floats:
+			floats.pop_back();
+			break;
+		default:
+			values.pop_back();
+		}
+		return last;
+	}
+
+	void ArrayObject::reserve(size_t count) {
+		switch (storage) {
+		case Storage::Ints:
+			ints.reserve(count);
+			break;
+		case Storage::Floats:
+			floats.reserve(count);
+			break;
+		default:
+			values.reserve(count);
+		}
+	}
+
+	std::string ArrayObject::asString()const {
+		if (printing)
+			return "[...]";
+		printing = true;
+
+		std::string result = "[";
+		const size_t count = size();
+		try {
+			for (size_t i = 0; i < count; i++) {
+				if (i > 0)
+					result += ", ";
+				result += get(i).toString();
+			}
+		}
+		catch (...) {
+			printing = false;
+			throw;
+		}
+		printing = false;
+		return result + "]";
+	}
+
+	void ArrayObject::trace(Heap& heap)const {
+		//Unboxed numbers can't refer to anything
+		for (const Value& value : values)
+			heap.mark(value);
+	}
+
+	size_t ArrayObject::checkIndex(const Value& index)const {
+		if (index.getType() != Int)
+			throw new PittaRuntimeException("Arrays can only be indexed by ints, not " + c_typeToString.at(index.getType()) + ".");
+		const int i = index.intValue();
+		if (i < 0 || size_t(i) >= size())
+			throw new PittaRuntimeException("Index " + std::to_string(i) + " is out of range for an array of " + std::to_string(size()) + " elements.");
+		return size_t(i);
+	}
+
+	void ArrayObject::prepareFor(const Value& value) {
+		const Type type = value.getType();
+		if (empty()) {
+			const Storage adopted = type == Int ? Storage::Ints : type == Float ? Storage::Floats : Storage::Values;
+			if (adopted != storage) {
+				//Whatever was reserved before the first element arrived is reserved for the storage it picked
+				const size_t capacity = storage == Storage::Ints ? ints.capacity() : storage == Storage::Floats ? floats.capacity() : values.capacity();
+				storage = adopted;
+				reserve(capacity);
+			}
+			return;
+		}
+		if ((storage == Storage::Ints && type != Int) || (storage == Storage::Floats && type != Float))
+			box();
+	}
+
+	void ArrayObject::box() {
+		const size_t count = size();
+		values.reserve(std::max<size_t>(count * 2, 8));
+		for (size_t i = 0; i < count; i++)
+			values.emplace_back(get(i));
+		//Swapped out rather than cleared, so the old buffer is freed
+		std::vector<int>().swap(ints);
+		std::vector<float>().swap(floats);
+		storage = Storage::Values;
+	}
+
+}
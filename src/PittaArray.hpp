@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "PittaValue.hpp"
+#include "PittaHeap.hpp"
+
+namespace pitta {
+
+	//A growable list of values in one contiguous buffer. While every element is an int, or every element is a float,
+	//they are kept unboxed as plain numbers; the first element of any other type, or of the other number type, boxes the
+	//whole array into values for good. An empty array takes whichever storage suits the next element it is given
+	class ArrayObject : public GCObject {
+	public:
+		enum class Storage : uint8_t {
+			Ints, Floats, Values
+		};
+
+		size_t size()const;
+		bool empty()const;
+		Storage getStorage()const;
+
+		//Indices are checked, and out of range ones throw
+		Value get(const Value& index)const;
+		Value get(size_t index)const;
+		//Values stored in an array can't be bound, since the array could outlive what they are bound to
+		void set(const Value& index, const Value& value);
+
+		void push(const Value& value);
+		Value pop();
+		void reserve(size_t count);
+
+		std::string asString()const;
+
+		void trace(Heap& heap)const override;
+
+		ArrayObject() = default;
+		ArrayObject(const ArrayObject&) = delete;
+
+	private:
+		Storage storage = Storage::Ints;
+		std::vector<int> ints;
+		std::vector<float> floats;
+		std::vector<Value> values;
+		//Set while the array is being turned into a string, so one that contains itself doesn't recurse forever
+		mutable bool printing = false;
+
+		size_t checkIndex(const Value& index)const;
+		//Makes sure the storage can hold the value, boxing everything if it can't
+		void prepareFor(const Value& value);
+		void box();
+	};
+
+}
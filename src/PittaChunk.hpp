@@ -0,0 +1,149 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "PittaValue.hpp"
+#include "PittaPropertyCache.hpp"
+
+namespace pitta {
+
+	//Every instruction the vm understands. Operands follow the opcode in the byte stream, and are listed
+	//next to each instruction. u16 operands are stored big endian
+#define PITTA_OPCODES(OP)\
+	OP(CONSTANT)		/* u16 constant index */\
+	OP(NIL)\
+	OP(UNDEFINED)\
+	OP(TRUE)\
+	OP(FALSE)\
+	OP(POP)\
+	OP(GET_LOCAL)		/* u8 stack slot */\
+	OP(SET_LOCAL)		/* u8 stack slot */\
+	OP(GET_GLOBAL)		/* u16 name constant */\
+	OP(DEFINE_GLOBAL)	/* u16 name constant */\
+	OP(SET_GLOBAL)		/* u16 name constant */\
+	OP(GET_UPVALUE)		/* u8 upvalue index */\
+	OP(SET_UPVALUE)		/* u8 upvalue index */\
+	OP(GET_PROPERTY)	/* u16 name constant, u16 property cache */\
+	OP(SET_PROPERTY)	/* u16 name constant, u16 property cache */\
+	OP(GET_SUPER)		/* u16 name constant */\
+	OP(GET_INDEX)\
+	OP(SET_INDEX)\
+	OP(BUILD_ARRAY)		/* u8 element count */\
+	OP(APPEND_ARRAY)	/* u8 element count, for literals with too many elements to build at once */\
+	OP(BUILD_MAP)		/* u8 entry count */\
+	OP(APPEND_MAP)		/* u8 entry count */\
+	OP(EQUAL)\
+	OP(NOT_EQUAL)\
+	OP(GREATER)\
+	OP(GREATER_EQUAL)\
+	OP(LESS)\
+	OP(LESS_EQUAL)\
+	OP(ADD)\
+	OP(SUBTRACT)\
+	OP(MULTIPLY)\
+	OP(DIVIDE)\
+	OP(MODULO)\
+	OP(BIT_AND)\
+	OP(BIT_OR)\
+	OP(BIT_XOR)\
+	OP(SHIFT_LEFT)\
+	OP(SHIFT_RIGHT)\
+	OP(CONCAT)\
+	OP(NOT)\
+	OP(NEGATE)\
+	OP(BIT_NOT)\
+	/* Arithmetic and comparisons rewrite themselves to these once they see two ints or two floats */\
+	OP(ADD_INT)\
+	OP(SUBTRACT_INT)\
+	OP(MULTIPLY_INT)\
+	OP(DIVIDE_INT)\
+	OP(LESS_INT)\
+	OP(LESS_EQUAL_INT)\
+	OP(GREATER_INT)\
+	OP(GREATER_EQUAL_INT)\
+	OP(ADD_FLOAT)\
+	OP(SUBTRACT_FLOAT)\
+	OP(MULTIPLY_FLOAT)\
+	OP(DIVIDE_FLOAT)\
+	OP(LESS_FLOAT)\
+	OP(LESS_EQUAL_FLOAT)\
+	OP(GREATER_FLOAT)\
+	OP(GREATER_EQUAL_FLOAT)\
+	OP(PRINT)\
+	OP(JUMP)			/* u16 forward offset */\
+	OP(JUMP_IF_FALSE)	/* u16 forward offset */\
+	OP(LOOP)			/* u16 backward offset */\
+	OP(CALL)			/* u8 argument count */\
+	OP(INVOKE)			/* u16 name constant, u16 property cache, u8 argument count */\
+	OP(CLOSURE)			/* u16 function index, then a (u8 isLocal, u8 index) pair per upvalue */\
+	OP(CLOSE_UPVALUE)\
+	OP(RETURN)\
+	OP(CLASS)			/* u16 name constant, u8 method count, u8 has superclass */
+
+#define PITTA_OPCODE_ENUM(name) name,
+	enum class OpCode : uint8_t {
+		PITTA_OPCODES(PITTA_OPCODE_ENUM)
+	};
+#undef PITTA_OPCODE_ENUM
+
+	class CompiledFunction;
+
+	class Chunk {
+	public:
+		//Specialised instructions are written over the ones they replace as the chunk runs
+		mutable std::vector<uint8_t> code;
+		//Source line of each byte in code, for runtime errors
+		std::vector<int> lines;
+		std::vector<Value> constants;
+		//Functions declared inside this one, created by OP_CLOSURE
+		std::vector<CompiledFunction*> functions;
+		//One for each property access in the chunk, filled in as it runs
+		mutable std::vector<PropertyCache> propertyCaches;
+
+		void write(uint8_t byte, int line) {
+			code.emplace_back(byte);
+			lines.emplace_back(line);
+		}
+
+		void write(OpCode op, int line) {
+			write(static_cast<uint8_t>(op), line);
+		}
+
+		void writeShort(uint16_t value, int line) {
+			write(uint8_t(value >> 8), line);
+			write(uint8_t(value & 0xff), line);
+		}
+
+		size_t addConstant(const Value& value) {
+			constants.emplace_back(value);
+			return constants.size() - 1;
+		}
+
+		size_t addPropertyCache() {
+			propertyCaches.emplace_back();
+			return propertyCaches.size() - 1;
+		}
+
+		Chunk() = default;
+		Chunk(const Chunk&) = delete;
+		~Chunk();
+	};
+
+	class CompiledFunction {
+	public:
+		const std::string name;
+		const int arity;
+		int upvalueCount = 0;
+		Chunk chunk;
+
+		CompiledFunction(const std::string& name, int arity) :
+			name(name),
+			arity(arity)
+		{}
+	};
+
+	inline Chunk::~Chunk() {
+		for (CompiledFunction* function : functions)
+			delete function;
+	}
+}
@@ -2,13 +2,34 @@
 
 namespace pitta {
 
+	Value NativeField::bindTo(void* object)const {
+		void* field = locate(object);
+		switch (type) {
+		case Int:
+			return Value((int*)field);
+		case Float:
+			return Value((float*)field);
+		case Bool:
+			return Value((bool*)field);
+		case String:
+			return Value((std::string*)field);
+		default:
+			throw new PittaRuntimeException("Native fields can only be ints, floats, bools or strings.");
+		}
+	}
+
+	Value Callable::invoke(Interpreter* interpreter, Instance* self, Arguments arguments) {
+		return (*self->bindMethod(this))(interpreter, arguments);
+	}
+
 	std::string Class::asString()const {
 		return name;
 	}
 
-	Callable* Class::findMethod(const std::string& methodName)const {
-		if (methods.count(methodName) > 0)
-			return methods.at(methodName);
+	Callable* Class::findMethod(Symbol methodName)const {
+		auto method = methods.find(methodName);
+		if (method != methods.end())
+			return method->second;
 
 		if (superclass != nullptr)
 			return superclass->findMethod(methodName);
@@ -16,39 +37,68 @@ namespace pitta {
 		return nullptr;
 	}
 
-	Value Class::operator()(Interpreter* interpreter, const std::vector<Value>& arguments)const {
+	Value Class::operator()(Interpreter* interpreter, Arguments arguments)const {
 		Instance* newInstance = new Instance(this);
 
 		interpreter->registerNewInstance(newInstance);
 
-		Callable* initaliser = findMethod("init");
-		if (initaliser != nullptr) {
-			Callable* boundInit = initaliser->bind(newInstance);
-			(*boundInit)(interpreter, arguments);
-			delete boundInit;
-		}
+		static const Symbol initName("init");
+		Callable* initaliser = findMethod(initName);
+		if (initaliser != nullptr)
+			initaliser->invoke(interpreter, newInstance, arguments);
 
 		return newInstance;
 	}
 
-	int findArity(const std::unordered_map<std::string, Callable*>& methods){
-		if (methods.count("init") == 0)
+	const Shape* Class::getRootShape()const {
+		return rootShape;
+	}
+
+	uint16_t Class::findNativeField(Symbol fieldName)const {
+		//Integrated classes only expose a handful of fields, so a scan beats hashing
+		for (size_t i = 0; i < nativeFields.size(); i++) {
+			if (nativeFields[i].name == fieldName)
+				return uint16_t(i);
+		}
+		return Shape::c_noSlot;
+	}
+	const NativeField& Class::getNativeField(uint16_t index)const {
+		return nativeFields[index];
+	}
+
+	void Class::trace(Heap& heap)const {
+		heap.mark(superclass);
+		for (auto& [_, method] : methods)
+			heap.mark(method);
+	}
+
+	int findArity(const std::unordered_map<Symbol, Callable*>& methods){
+		auto initialiser = methods.find("init");
+		if (initialiser == methods.end())
 			return 0;
-		return methods.at("init")->getArity();
+		return initialiser->second->getArity();
 	}
 
-	Class::Class(const std::string& name, Class const* superclass, std::unordered_map<std::string, Callable*>&& methods) :
+	std::unordered_map<Symbol, Callable*> internMethodNames(const std::unordered_map<std::string, Callable*>& methods) {
+		std::unordered_map<Symbol, Callable*> interned;
+		for (auto& [name, method] : methods)
+			interned.emplace(name, method);
+		return interned;
+	}
+
+	Class::Class(const std::string& name, Class const* superclass, std::unordered_map<Symbol, Callable*>&& methods) :
 		Callable(findArity(methods), name),
 		name(name),
 		superclass(superclass),
-		methods(std::move(methods))
+		methods(std::move(methods)),
+		rootShape(new Shape())
 	{}
 	Class::Class(const std::string& name, Class const* superclass, const std::unordered_map<std::string, Callable*>& methods):
-		Callable(findArity(methods), name),
-		name(name),
-		superclass(superclass),
-		methods(methods)
+		Class(name, superclass, internMethodNames(methods))
 	{}
+	Class::~Class() {
+		Shape::release(rootShape);
+	}
 
 
 	std::string Instance::asString()const {
@@ -57,37 +107,163 @@ namespace pitta {
 	Class const* const Instance::getDefinition()const {
 		return classDefinition;
 	}
-	Value Instance::get(const Token& name) {
-		return get(name.lexeme);
+	Value Instance::get(const Token& name, Heap& heap) {
+		return get(name.lexeme, heap);
+	}
+	Value Instance::get(Symbol name, Heap& heap) {
+		const uint16_t nativeIndex = classDefinition->findNativeField(name);
+		if (nativeIndex != Shape::c_noSlot)
+			return nativeField(nativeIndex).unbound(heap);
+
+		const uint16_t slot = shape->find(name);
+		if (slot != Shape::c_noSlot)
+			return field(slot);
+
+		Callable* method = classDefinition->findMethod(name);
+		if (method != nullptr)
+			return bindMethod(method);
+
+		throw new PittaRuntimeException("Cannot find field with name " + name.str() + ".");
+		return Undefined;
+	}
+	Value Instance::get(Symbol name, PropertyCache& cache, InlineCacheStats& stats, Heap& heap) {
+		Value fieldValue;
+		Callable* method = getMethod(name, cache, stats, fieldValue, heap);
+		if (method != nullptr)
+			return bindMethod(method);
+		return fieldValue;
 	}
-	Value Instance::get(const std::string& name) {
-		if (fields.count(name) > 0) {
-			return fields.at(name);
+	Callable* Instance::getMethod(Symbol name, PropertyCache& cache, InlineCacheStats& stats, Value& fieldValue, Heap& heap) {
+		const PropertyCache::Entry* entry = cache.find(shape);
+		if (entry != nullptr) {
+			stats.hits += 1;
+			if (entry->method == nullptr)
+				fieldValue = entry->isNative ? nativeField(entry->slot).unbound(heap) : field(entry->slot);
+			return entry->method;
 		}
+
+		stats.misses += 1;
+		const uint16_t nativeIndex = classDefinition->findNativeField(name);
+		if (nativeIndex != Shape::c_noSlot) {
+			cache.add(PropertyCache::Entry{ shape, nullptr, shape, nativeIndex, true });
+			fieldValue = nativeField(nativeIndex).unbound(heap);
+			return nullptr;
+		}
+
+		const uint16_t slot = shape->find(name);
+		if (slot != Shape::c_noSlot) {
+			cache.add(PropertyCache::Entry{ shape, nullptr, shape, slot });
+			fieldValue = field(slot);
+			return nullptr;
+		}
+
 		Callable* method = classDefinition->findMethod(name);
-		if (method != nullptr) {
-			Callable* newMethod = method->bind(this);
-			generatedCallables.emplace_back(newMethod);
-			return newMethod;
+		if (method == nullptr)
+			throw new PittaRuntimeException("Cannot find field with name " + name.str() + ".");
+
+		cache.add(PropertyCache::Entry{ shape, method, shape, Shape::c_noSlot });
+		return method;
+	}
+
+	Callable* Instance::bindMethod(Callable* method) {
+		for (auto& [unbound, bound] : boundMethods) {
+			if (unbound == method)
+				return bound;
 		}
 
-		throw new PittaRuntimeException("Cannot find field with name " + name + ".");
-		return Undefined;
+		Callable* bound = method->bind(this);
+		boundMethods.emplace_back(method, bound);
+		return bound;
+	}
+
+	void Instance::trace(Heap& heap)const {
+		heap.mark(classDefinition);
+		for (uint16_t slot = 0; slot < shape->getFieldCount(); slot++)
+			heap.mark(field(slot));
+		for (auto& [_, bound] : boundMethods)
+			heap.mark(bound);
 	}
 
 	void Instance::set(const Token& name, const Value& value) {
 		set(name.lexeme, value);
 	}
-	void Instance::set(const std::string& name, const Value& value) {
-		fields[name] = value;
+	void Instance::set(Symbol name, const Value& value) {
+		const uint16_t nativeIndex = classDefinition->findNativeField(name);
+		if (nativeIndex != Shape::c_noSlot) {
+			nativeField(nativeIndex).assign(value);
+			return;
+		}
+
+		const uint16_t slot = shape->find(name);
+		if (slot != Shape::c_noSlot)
+			field(slot).assign(value);
+		else
+			addField(shape->withField(name), value);
+	}
+	void Instance::set(Symbol name, const Value& value, PropertyCache& cache, InlineCacheStats& stats) {
+		const PropertyCache::Entry* entry = cache.find(shape);
+		if (entry != nullptr) {
+			stats.hits += 1;
+			if (entry->isNative)
+				nativeField(entry->slot).assign(value);
+			else if (entry->newShape == shape)
+				field(entry->slot).assign(value);
+			else
+				addField(entry->newShape, value);
+			return;
+		}
+
+		stats.misses += 1;
+		const uint16_t nativeIndex = classDefinition->findNativeField(name);
+		if (nativeIndex != Shape::c_noSlot) {
+			cache.add(PropertyCache::Entry{ shape, nullptr, shape, nativeIndex, true });
+			nativeField(nativeIndex).assign(value);
+			return;
+		}
+
+		const uint16_t slot = shape->find(name);
+		if (slot != Shape::c_noSlot) {
+			cache.add(PropertyCache::Entry{ shape, nullptr, shape, slot });
+			field(slot).assign(value);
+			return;
+		}
+
+		const Shape* newShape = shape->withField(name);
+		cache.add(PropertyCache::Entry{ shape, nullptr, newShape, shape->getFieldCount() });
+		addField(newShape, value);
+	}
+
+	Value& Instance::field(uint16_t slot) {
+		if (slot < PITTA_INLINE_FIELDS)
+			return inlineFields[slot];
+		return extraFields[slot - PITTA_INLINE_FIELDS];
+	}
+	const Value& Instance::field(uint16_t slot)const {
+		if (slot < PITTA_INLINE_FIELDS)
+			return inlineFields[slot];
+		return extraFields[slot - PITTA_INLINE_FIELDS];
+	}
+
+	Value Instance::nativeField(uint16_t index)const {
+		return classDefinition->getNativeField(index).bindTo(getNativeObject());
+	}
+
+	void Instance::addField(const Shape* newShape, const Value& value) {
+		const uint16_t slot = shape->getFieldCount();
+		shape = newShape;
+		if (slot < PITTA_INLINE_FIELDS)
+			inlineFields[slot] = value;
+		else
+			extraFields.emplace_back(value);
 	}
 
 	Instance::Instance(Class const* definition) :
-		classDefinition(definition)
+		classDefinition(definition),
+		shape(definition->getRootShape())
 	{}
 	Instance::~Instance() {
-		for (auto callable : generatedCallables)
-			delete callable;
+		for (auto& [_, bound] : boundMethods)
+			delete bound;
 	}
 
 
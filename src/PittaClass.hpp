@@ -3,9 +3,26 @@
 #include "PittaValue.hpp"
 #include "PittaFunction.hpp"
 #include "PittaInterpreter.hpp"
+#include "PittaShape.hpp"
+
+//How many fields an instance stores inside itself before it needs a separate allocation
+#ifndef PITTA_INLINE_FIELDS
+#define PITTA_INLINE_FIELDS 4
+#endif
 
 namespace pitta {
 
+	//A field kept in an integrated class's C++ object rather than in the instance
+	struct NativeField {
+		Symbol name;
+		Type type;
+		//Gives the address of the field inside the object
+		void* (*locate)(void* object);
+
+		//A value bound to the field inside the object
+		Value bindTo(void* object)const;
+	};
+
 	class Class : public Callable{
 	public:
 		const std::string name;
@@ -13,35 +30,77 @@ namespace pitta {
 
 		std::string asString()const;
 
-		Value operator()(Interpreter* interpreter, const std::vector<Value>& arguments)const override;
+		Value operator()(Interpreter* interpreter, Arguments arguments)const override;
+
+		Callable* findMethod(Symbol methodName)const;
+
+		//The shape every new instance starts with, before any fields are added
+		const Shape* getRootShape()const;
+
+		//Returns Shape::c_noSlot if the class keeps no field with the name in its C++ objects
+		uint16_t findNativeField(Symbol fieldName)const;
+		const NativeField& getNativeField(uint16_t index)const;
 
-		Callable* findMethod(const std::string& methodName)const;
+		void trace(Heap& heap)const override;
 
-		Class(const std::string& name, Class const* superclass, std::unordered_map<std::string, Callable*>&& methods);
+		Class(const std::string& name, Class const* superclass, std::unordered_map<Symbol, Callable*>&& methods);
 		Class(const std::string& name, Class const* superclass, const std::unordered_map<std::string, Callable*>& methods);
-		virtual ~Class() = default;
+		virtual ~Class();
 	protected:
-		std::unordered_map<std::string, Callable*> methods;
+		std::unordered_map<Symbol, Callable*> methods;
+		//Described once for the whole class, so binding an object to an instance doesn't have to visit its fields
+		std::vector<NativeField> nativeFields;
+
+	private:
+		Shape* rootShape;
 	};
 	
-	class Instance {
+	class Instance : public GCObject {
 	public:
 
 		std::string asString()const;
 
 		Class const* const getDefinition()const;
 
-		Value get(const Token& name);
-		Value get(const std::string& name);
+		//A native string field is copied into the heap, since the value read can outlive the C++ object
+		Value get(const Token& name, Heap& heap);
+		Value get(Symbol name, Heap& heap);
+		//Looks the name up through an access site's cache
+		Value get(Symbol name, PropertyCache& cache, InlineCacheStats& stats, Heap& heap);
+		//As above, but a method is returned without being bound so it can be invoked on this instance directly.
+		//Returns nullptr for a field, whose value is put in fieldValue
+		Callable* getMethod(Symbol name, PropertyCache& cache, InlineCacheStats& stats, Value& fieldValue, Heap& heap);
 
+		//The value can't be bound, unless it is going into a native field
 		void set(const Token& name, const Value& values);
-		void set(const std::string& name, const Value& value);
+		void set(Symbol name, const Value& value);
+		void set(Symbol name, const Value& value, PropertyCache& cache, InlineCacheStats& stats);
+
+		//The method bound to this instance. Each method is only bound once, and lives as long as the instance
+		Callable* bindMethod(Callable* method);
+
+		void trace(Heap& heap)const override;
 
 		Instance(Class const* definition);
 		virtual ~Instance();
 	protected:
 		Class const*const classDefinition;
-		std::unordered_map<std::string, Value> fields;
-		std::vector<Callable*> generatedCallables;
+
+		//The C++ object an integrated instance wraps, which its class's native fields are found in
+		virtual void* getNativeObject()const {
+			return nullptr;
+		}
+
+	private:
+		const Shape* shape;
+		Value inlineFields[PITTA_INLINE_FIELDS];
+		std::vector<Value> extraFields;
+		//Pairs of a class's method and its copy bound to this instance
+		std::vector<std::pair<Callable*, Callable*>> boundMethods;
+
+		Value& field(uint16_t slot);
+		const Value& field(uint16_t slot)const;
+		Value nativeField(uint16_t index)const;
+		void addField(const Shape* newShape, const Value& value);
 	};
 }
\ No newline at end of file
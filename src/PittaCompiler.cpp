@@ -0,0 +1,635 @@
+#include "PittaCompiler.hpp"
+#include <algorithm>
+
+namespace pitta {
+
+	CompiledFunction* Compiler::compile(const std::vector<Stmt<void, Value>*>& statements) {
+		hadError = false;
+
+		FunctionState script{ nullptr, new CompiledFunction("script", 0), FunctionType::SCRIPT };
+		current = &script;
+		//Slot zero of every frame holds the function being called
+		script.locals.push_back(Local{ "", 0, false });
+
+		for (Stmt<void, Value>* stmt : statements)
+			compile(stmt);
+		emitReturn();
+
+		current = nullptr;
+		if (hadError) {
+			delete script.function;
+			return nullptr;
+		}
+		return script.function;
+	}
+
+	Compiler::Compiler(Runtime* runtime) :
+		runtime(runtime)
+	{}
+
+
+
+	Chunk& Compiler::currentChunk() {
+		return current->function->chunk;
+	}
+
+	void Compiler::error(const Token& token, const std::string& message) {
+		runtime->error(token, message);
+		hadError = true;
+	}
+
+	void Compiler::emit(OpCode op) {
+		currentChunk().write(op, line);
+	}
+
+	void Compiler::emit(OpCode op, uint8_t operand) {
+		currentChunk().write(op, line);
+		currentChunk().write(operand, line);
+	}
+
+	void Compiler::emitShort(OpCode op, uint16_t operand) {
+		currentChunk().write(op, line);
+		currentChunk().writeShort(operand, line);
+	}
+
+	void Compiler::emitLoop(size_t loopStart) {
+		//Jumping back over the loop instruction itself as well
+		const size_t offset = currentChunk().code.size() - loopStart + 3;
+		if (offset > UINT16_MAX) {
+			runtime->error(line, "Loop body too large.");
+			hadError = true;
+		}
+		emitShort(OpCode::LOOP, uint16_t(offset));
+	}
+
+	size_t Compiler::emitJump(OpCode op) {
+		emitShort(op, UINT16_MAX);
+		return currentChunk().code.size() - 2;
+	}
+
+	void Compiler::patchJump(size_t jump) {
+		const size_t offset = currentChunk().code.size() - jump - 2;
+		if (offset > UINT16_MAX) {
+			runtime->error(line, "Too much code to jump over.");
+			hadError = true;
+		}
+		currentChunk().code[jump] = uint8_t(offset >> 8);
+		currentChunk().code[jump + 1] = uint8_t(offset & 0xff);
+	}
+
+	void Compiler::patchJumps(std::vector<size_t>& jumps) {
+		for (size_t jump : jumps)
+			patchJump(jump);
+		jumps.clear();
+	}
+
+	void Compiler::emitReturn() {
+		//Initialisers always hand back the new instance, everything else defaults to undefined
+		if (current->type == FunctionType::INITIALISER)
+			emit(OpCode::GET_LOCAL, 0);
+		else
+			emit(OpCode::UNDEFINED);
+		emit(OpCode::RETURN);
+	}
+
+	uint16_t Compiler::makeConstant(const Value& value) {
+		const size_t index = currentChunk().addConstant(value);
+		if (index > UINT16_MAX) {
+			runtime->error(line, "Too many constants in one function.");
+			hadError = true;
+		}
+		return uint16_t(index);
+	}
+
+	uint16_t Compiler::identifierConstant(const Token& name) {
+		return makeConstant(name.lexeme);
+	}
+
+	uint16_t Compiler::propertyCache() {
+		const size_t index = currentChunk().addPropertyCache();
+		if (index > UINT16_MAX) {
+			runtime->error(line, "Too many property accesses in one function.");
+			hadError = true;
+		}
+		return uint16_t(index);
+	}
+
+
+
+	void Compiler::beginScope() {
+		current->scopeDepth += 1;
+	}
+
+	void Compiler::endScope() {
+		current->scopeDepth -= 1;
+
+		auto& locals = current->locals;
+		while (!locals.empty() && locals.back().depth > current->scopeDepth) {
+			emit(locals.back().isCaptured ? OpCode::CLOSE_UPVALUE : OpCode::POP);
+			locals.pop_back();
+		}
+	}
+
+	void Compiler::discardLocals(int depth) {
+		const auto& locals = current->locals;
+		for (auto local = locals.rbegin(); local != locals.rend() && local->depth > depth; ++local)
+			emit(local->isCaptured ? OpCode::CLOSE_UPVALUE : OpCode::POP);
+	}
+
+	void Compiler::beginLoop(Loop& loop) {
+		loop.enclosing = current->loop;
+		loop.scopeDepth = current->scopeDepth;
+		current->loop = &loop;
+	}
+
+	void Compiler::endLoop(Loop& loop) {
+		patchJumps(loop.breakJumps);
+		current->loop = loop.enclosing;
+	}
+
+	void Compiler::addLocal(Symbol name) {
+		if (current->locals.size() >= PITTA_MAX_LOCALS) {
+			runtime->error(line, "Too many local variables in function.");
+			hadError = true;
+			return;
+		}
+		current->locals.push_back(Local{ name, current->scopeDepth, false });
+	}
+
+	int Compiler::resolveLocal(FunctionState* state, Symbol name) {
+		for (int i = int(state->locals.size()) - 1; i >= 0; i--) {
+			if (state->locals[i].name == name)
+				return i;
+		}
+		return -1;
+	}
+
+	int Compiler::addUpvalue(FunctionState* state, uint8_t index, bool isLocal) {
+		for (size_t i = 0; i < state->upvalues.size(); i++) {
+			const UpvalueReference& upvalue = state->upvalues[i];
+			if (upvalue.index == index && upvalue.isLocal == isLocal)
+				return int(i);
+		}
+
+		if (state->upvalues.size() >= PITTA_MAX_LOCALS) {
+			runtime->error(line, "Too many closure variables in function.");
+			hadError = true;
+			return 0;
+		}
+
+		state->upvalues.push_back(UpvalueReference{ index, isLocal });
+		return int(state->upvalues.size()) - 1;
+	}
+
+	int Compiler::resolveUpvalue(FunctionState* state, Symbol name) {
+		if (state->enclosing == nullptr)
+			return -1;
+
+		const int local = resolveLocal(state->enclosing, name);
+		if (local != -1) {
+			state->enclosing->locals[local].isCaptured = true;
+			return addUpvalue(state, uint8_t(local), true);
+		}
+
+		const int upvalue = resolveUpvalue(state->enclosing, name);
+		if (upvalue != -1)
+			return addUpvalue(state, uint8_t(upvalue), false);
+
+		return -1;
+	}
+
+	void Compiler::namedVariable(const Token& name, uint16_t environmentDepth, bool isAssignment) {
+		line = name.line;
+
+		if (environmentDepth != c_globalVariable) {
+			const int local = resolveLocal(current, name.lexeme);
+			if (local != -1) {
+				emit(isAssignment ? OpCode::SET_LOCAL : OpCode::GET_LOCAL, uint8_t(local));
+				return;
+			}
+
+			const int upvalue = resolveUpvalue(current, name.lexeme);
+			if (upvalue != -1) {
+				emit(isAssignment ? OpCode::SET_UPVALUE : OpCode::GET_UPVALUE, uint8_t(upvalue));
+				return;
+			}
+		}
+
+		emitShort(isAssignment ? OpCode::SET_GLOBAL : OpCode::GET_GLOBAL, identifierConstant(name));
+	}
+
+	void Compiler::defineVariable(const Token& name, uint16_t variableId) {
+		//Locals simply stay where their value was pushed
+		if (variableId == c_globalVariable)
+			emitShort(OpCode::DEFINE_GLOBAL, identifierConstant(name));
+		else
+			addLocal(name.lexeme);
+	}
+
+	void Compiler::function(FunctionStmt<void, Value>* stmt, FunctionType type) {
+		FunctionState state{ current, new CompiledFunction(stmt->name.lexeme, int(stmt->params.size())), type };
+		current = &state;
+		line = stmt->name.line;
+
+		beginScope();
+		const bool isMethod = type == FunctionType::METHOD || type == FunctionType::INITIALISER;
+		state.locals.push_back(Local{ isMethod ? c_classSelfReferenceKey : "", current->scopeDepth, false });
+		for (const Token& param : stmt->params)
+			addLocal(param.lexeme);
+
+		for (Stmt<void, Value>* bodyStmt : stmt->body)
+			compile(bodyStmt);
+		emitReturn();
+
+		CompiledFunction* compiled = state.function;
+		compiled->upvalueCount = int(state.upvalues.size());
+		current = state.enclosing;
+
+		currentChunk().functions.emplace_back(compiled);
+		emitShort(OpCode::CLOSURE, uint16_t(currentChunk().functions.size() - 1));
+		for (const UpvalueReference& upvalue : state.upvalues) {
+			currentChunk().write(upvalue.isLocal ? 1 : 0, line);
+			currentChunk().write(upvalue.index, line);
+		}
+	}
+
+	void Compiler::compile(Stmt<void, Value>* stmt) {
+		stmt->accept(this);
+	}
+
+	void Compiler::compile(Expr<Value>* expr) {
+		expr->accept(this);
+	}
+
+
+
+
+
+
+
+
+	Value Compiler::visitArrayLiteralExpr(ArrayLiteral<Value>* expr) {
+		//Built from at most a byte's worth of elements at a time, so a long literal never fills the stack
+		const size_t count = expr->elements.size();
+		size_t compiled = 0;
+		do {
+			const size_t batch = std::min<size_t>(count - compiled, UINT8_MAX);
+			for (size_t i = compiled; i < compiled + batch; i++)
+				compile(expr->elements[i]);
+			line = expr->closingBracket.line;
+			emit(compiled == 0 ? OpCode::BUILD_ARRAY : OpCode::APPEND_ARRAY, uint8_t(batch));
+			compiled += batch;
+		} while (compiled < count);
+		return Null;
+	}
+	Value Compiler::visitAssignExpr(Assign<Value>* expr) {
+		compile(expr->value);
+		namedVariable(expr->name, expr->environmentDepth, true);
+		return Null;
+	}
+
+	Value Compiler::visitBinaryExpr(Binary<Value>* expr) {
+		compile(expr->left);
+		compile(expr->right);
+		line = expr->op.line;
+
+		switch (expr->op.type) {
+		case MINUS:			emit(OpCode::SUBTRACT); break;
+		case PLUS:			emit(OpCode::ADD); break;
+		case SLASH:			emit(OpCode::DIVIDE); break;
+		case STAR:			emit(OpCode::MULTIPLY); break;
+		case EQUAL_EQUAL:	emit(OpCode::EQUAL); break;
+		case BANG_EQUAL:	emit(OpCode::NOT_EQUAL); break;
+		case LESS:			emit(OpCode::LESS); break;
+		case GREATER:		emit(OpCode::GREATER); break;
+		case LESS_EQUAL:	emit(OpCode::LESS_EQUAL); break;
+		case GREATER_EQUAL:	emit(OpCode::GREATER_EQUAL); break;
+		case SHIFT_LEFT:	emit(OpCode::SHIFT_LEFT); break;
+		case SHIFT_RIGHT:	emit(OpCode::SHIFT_RIGHT); break;
+		case STRING_CONCAT:	emit(OpCode::CONCAT); break;
+		case BIT_AND:		emit(OpCode::BIT_AND); break;
+		case BIT_OR:		emit(OpCode::BIT_OR); break;
+		case BIT_XOR:		emit(OpCode::BIT_XOR); break;
+		case PERCENT:		emit(OpCode::MODULO); break;
+		default:
+			error(expr->op, "Unknown binary operator requested");
+		}
+		return Null;
+	}
+
+	Value Compiler::visitCallExpr(Call<Value>* expr) {
+		//Calling a property leaves the instance where "this" goes, so methods don't need binding
+		compile(expr->method != nullptr ? expr->method->object : expr->callee);
+		for (Expr<Value>* arg : expr->arguments)
+			compile(arg);
+
+		line = expr->closingParenthesis.line;
+		if (expr->arguments.size() > UINT8_MAX)
+			error(expr->closingParenthesis, "Can't have more than " + std::to_string(UINT8_MAX) + " arguments.");
+
+		if (expr->method != nullptr) {
+			emitShort(OpCode::INVOKE, identifierConstant(expr->method->name));
+			currentChunk().writeShort(propertyCache(), line);
+			currentChunk().write(uint8_t(expr->arguments.size()), line);
+		}
+		else
+			emit(OpCode::CALL, uint8_t(expr->arguments.size()));
+		return Null;
+	}
+
+	Value Compiler::visitGetExpr(Get<Value>* expr) {
+		compile(expr->object);
+		line = expr->name.line;
+		emitShort(OpCode::GET_PROPERTY, identifierConstant(expr->name));
+		currentChunk().writeShort(propertyCache(), line);
+		return Null;
+	}
+
+	Value Compiler::visitGetIndexExpr(GetIndex<Value>* expr) {
+		compile(expr->object);
+		compile(expr->index);
+		line = expr->closingBracket.line;
+		emit(OpCode::GET_INDEX);
+		return Null;
+	}
+	Value Compiler::visitGroupingExpr(Grouping<Value>* expr) {
+		compile(expr->expression);
+		return Null;
+	}
+
+	Value Compiler::visitLiteralExpr(Literal<Value>* expr) {
+		switch (expr->value.getType()) {
+		case Bool:
+			emit(expr->value.asBool() ? OpCode::TRUE : OpCode::FALSE);
+			break;
+		case Null:
+			emit(OpCode::NIL);
+			break;
+		case Undefined:
+			emit(OpCode::UNDEFINED);
+			break;
+		default:
+			emitShort(OpCode::CONSTANT, makeConstant(expr->value));
+		}
+		return Null;
+	}
+
+	Value Compiler::visitLogicalExpr(Logical<Value>* expr) {
+		compile(expr->left);
+		line = expr->op.line;
+
+		if (expr->op.type == OR) {
+			const size_t elseJump = emitJump(OpCode::JUMP_IF_FALSE);
+			const size_t endJump = emitJump(OpCode::JUMP);
+			patchJump(elseJump);
+			emit(OpCode::POP);
+			compile(expr->right);
+			patchJump(endJump);
+		}
+		else {
+			const size_t endJump = emitJump(OpCode::JUMP_IF_FALSE);
+			emit(OpCode::POP);
+			compile(expr->right);
+			patchJump(endJump);
+		}
+		return Null;
+	}
+
+	Value Compiler::visitMapLiteralExpr(MapLiteral<Value>* expr) {
+		//Each entry takes two stack slots, so half as many go in each batch as for arrays
+		const size_t count = expr->keys.size();
+		size_t compiled = 0;
+		do {
+			const size_t batch = std::min<size_t>(count - compiled, UINT8_MAX / 2);
+			for (size_t i = compiled; i < compiled + batch; i++) {
+				compile(expr->keys[i]);
+				compile(expr->values[i]);
+			}
+			line = expr->closingBrace.line;
+			emit(compiled == 0 ? OpCode::BUILD_MAP : OpCode::APPEND_MAP, uint8_t(batch));
+			compiled += batch;
+		} while (compiled < count);
+		return Null;
+	}
+	Value Compiler::visitSetExpr(Set<Value>* expr) {
+		compile(expr->object);
+		compile(expr->value);
+		line = expr->name.line;
+		emitShort(OpCode::SET_PROPERTY, identifierConstant(expr->name));
+		currentChunk().writeShort(propertyCache(), line);
+		return Null;
+	}
+
+	Value Compiler::visitSetIndexExpr(SetIndex<Value>* expr) {
+		compile(expr->object);
+		compile(expr->index);
+		compile(expr->value);
+		line = expr->closingBracket.line;
+		emit(OpCode::SET_INDEX);
+		return Null;
+	}
+	Value Compiler::visitSuperExpr(Super<Value>* expr) {
+		const Token thisToken(THIS, c_classSelfReferenceKey, expr->keyword.line, Undefined);
+		namedVariable(thisToken, expr->environmentDepth, false);
+		namedVariable(expr->keyword, expr->environmentDepth, false);
+		emitShort(OpCode::GET_SUPER, identifierConstant(expr->method));
+		return Null;
+	}
+
+	Value Compiler::visitThisExpr(This<Value>* expr) {
+		namedVariable(expr->keyword, expr->environmentDepth, false);
+		return Null;
+	}
+
+	Value Compiler::visitUnaryExpr(Unary<Value>* expr) {
+		compile(expr->right);
+		line = expr->op.line;
+
+		switch (expr->op.type) {
+		case MINUS:		emit(OpCode::NEGATE); break;
+		case BANG:		emit(OpCode::NOT); break;
+		case BIT_NOT:	emit(OpCode::BIT_NOT); break;
+		default:
+			error(expr->op, "Non-unary token being treated as a unary expression");
+		}
+		return Null;
+	}
+
+	Value Compiler::visitVariableExpr(Variable<Value>* expr) {
+		namedVariable(expr->name, expr->environmentDepth, false);
+		return Null;
+	}
+
+
+
+
+
+
+
+
+	void Compiler::visitBlockStmt(Block<void, Value>* stmt) {
+		beginScope();
+		for (Stmt<void, Value>* inner : stmt->statements)
+			compile(inner);
+		endScope();
+	}
+
+	void Compiler::visitBreakStmt(Break<void, Value>* stmt) {
+		line = stmt->keyword.line;
+		discardLocals(current->loop->scopeDepth);
+		current->loop->breakJumps.push_back(emitJump(OpCode::JUMP));
+	}
+
+	void Compiler::visitClassStmt(ClassStmt<void, Value>* stmt) {
+		line = stmt->name.line;
+		const bool isLocal = stmt->variableId != c_globalVariable;
+
+		//Locals get their slot before the methods are compiled so that they can refer to the class
+		if (isLocal) {
+			emit(OpCode::NIL);
+			addLocal(stmt->name.lexeme);
+		}
+
+		beginScope();
+		if (stmt->superclass != nullptr) {
+			compile(stmt->superclass);
+			addLocal("super");
+		}
+
+		for (FunctionStmt<void, Value>* method : stmt->methods)
+			function(method, method->name.lexeme == "init" ? FunctionType::INITIALISER : FunctionType::METHOD);
+
+		line = stmt->name.line;
+		emitShort(OpCode::CLASS, identifierConstant(stmt->name));
+		currentChunk().write(uint8_t(stmt->methods.size()), line);
+		currentChunk().write(stmt->superclass != nullptr ? 1 : 0, line);
+
+		if (isLocal) {
+			emit(OpCode::SET_LOCAL, uint8_t(resolveLocal(current, stmt->name.lexeme)));
+			emit(OpCode::POP);
+		}
+		else
+			emitShort(OpCode::DEFINE_GLOBAL, identifierConstant(stmt->name));
+
+		endScope();
+	}
+
+	void Compiler::visitContinueStmt(Continue<void, Value>* stmt) {
+		line = stmt->keyword.line;
+		discardLocals(current->loop->scopeDepth);
+		current->loop->continueJumps.push_back(emitJump(OpCode::JUMP));
+	}
+
+	void Compiler::visitExpressionStmt(Expression<void, Value>* stmt) {
+		compile(stmt->expression);
+		emit(OpCode::POP);
+	}
+
+	void Compiler::visitForStmt(For<void, Value>* stmt) {
+		beginScope();
+		if (stmt->initializer != nullptr)
+			compile(stmt->initializer);
+
+		Loop loop;
+		beginLoop(loop);
+		const size_t loopStart = currentChunk().code.size();
+		size_t exitJump = 0;
+		if (stmt->condition != nullptr) {
+			compile(stmt->condition);
+			exitJump = emitJump(OpCode::JUMP_IF_FALSE);
+			emit(OpCode::POP);
+		}
+
+		compile(stmt->body);
+		patchJumps(loop.continueJumps);
+		if (stmt->increment != nullptr) {
+			compile(stmt->increment);
+			emit(OpCode::POP);
+		}
+		emitLoop(loopStart);
+
+		if (stmt->condition != nullptr) {
+			patchJump(exitJump);
+			emit(OpCode::POP);
+		}
+		endLoop(loop);
+		endScope();
+	}
+
+	void Compiler::visitFunctionStmt(FunctionStmt<void, Value>* stmt) {
+		//Declared up front so that the function can call itself
+		if (stmt->variableId != c_globalVariable)
+			addLocal(stmt->name.lexeme);
+
+		function(stmt, FunctionType::FUNCTION);
+
+		if (stmt->variableId == c_globalVariable)
+			emitShort(OpCode::DEFINE_GLOBAL, identifierConstant(stmt->name));
+	}
+
+	void Compiler::visitIfStmt(If<void, Value>* stmt) {
+		compile(stmt->condition);
+
+		const size_t thenJump = emitJump(OpCode::JUMP_IF_FALSE);
+		emit(OpCode::POP);
+		compile(stmt->thenBranch);
+
+		const size_t elseJump = emitJump(OpCode::JUMP);
+		patchJump(thenJump);
+		emit(OpCode::POP);
+		if (stmt->elseBranch != nullptr)
+			compile(stmt->elseBranch);
+		patchJump(elseJump);
+	}
+
+	void Compiler::visitPrintStmt(Print<void, Value>* stmt) {
+		compile(stmt->expression);
+		emit(OpCode::PRINT);
+	}
+
+	void Compiler::visitReturnStmt(Return<void, Value>* stmt) {
+		line = stmt->keyword.line;
+
+		if (stmt->value == nullptr) {
+			emitReturn();
+			return;
+		}
+
+		compile(stmt->value);
+		//Like the tree walker, initialisers evaluate but ignore whatever they are asked to return
+		if (current->type == FunctionType::INITIALISER) {
+			emit(OpCode::POP);
+			emitReturn();
+		}
+		else
+			emit(OpCode::RETURN);
+	}
+
+	void Compiler::visitVarStmt(Var<void, Value>* stmt) {
+		line = stmt->name.line;
+		if (stmt->initializer != nullptr)
+			compile(stmt->initializer);
+		else
+			emit(OpCode::UNDEFINED);
+
+		defineVariable(stmt->name, stmt->variableId);
+	}
+
+	void Compiler::visitWhileStmt(While<void, Value>* stmt) {
+		Loop loop;
+		beginLoop(loop);
+		const size_t loopStart = currentChunk().code.size();
+		compile(stmt->condition);
+
+		const size_t exitJump = emitJump(OpCode::JUMP_IF_FALSE);
+		emit(OpCode::POP);
+		compile(stmt->body);
+		patchJumps(loop.continueJumps);
+		emitLoop(loopStart);
+
+		patchJump(exitJump);
+		emit(OpCode::POP);
+		endLoop(loop);
+	}
+
+}
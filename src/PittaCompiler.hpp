@@ -0,0 +1,134 @@
+#pragma once
+#include "PittaStatements.hpp"
+#include "PittaChunk.hpp"
+#include "PittaRuntime.hpp"
+
+#ifndef PITTA_MAX_LOCALS
+#define PITTA_MAX_LOCALS 256
+#endif
+
+namespace pitta {
+
+	//Lowers a resolved tree into bytecode for the VM. The resolver must have swept the statements first, as
+	//the compiler relies on it to tell globals apart from locals
+	class Compiler : private StatementVisitor<void, Value>, private ExpressionVisitor<Value> {
+	public:
+
+		//Returns the top level script as a function taking no arguments, or nullptr if there was a compile error.
+		//The caller owns the returned function
+		CompiledFunction* compile(const std::vector<Stmt<void, Value>*>& statements);
+
+		Compiler(Runtime* runtime);
+
+	private:
+		enum class FunctionType : char {
+			SCRIPT,
+			FUNCTION,
+			INITIALISER,
+			METHOD
+		};
+
+		struct Local {
+			Symbol name;
+			int depth;
+			bool isCaptured;
+		};
+
+		struct UpvalueReference {
+			uint8_t index;
+			bool isLocal;
+		};
+
+		struct Loop {
+			Loop* enclosing;
+			//Locals deeper than this were declared in the body, and are dropped when jumping out of it
+			int scopeDepth;
+			//Jumps still to be pointed at the end of the loop, and at the start of the next iteration
+			std::vector<size_t> breakJumps;
+			std::vector<size_t> continueJumps;
+		};
+
+		struct FunctionState {
+			FunctionState* enclosing;
+			CompiledFunction* function;
+			FunctionType type;
+			std::vector<Local> locals;
+			std::vector<UpvalueReference> upvalues;
+			int scopeDepth = 0;
+			//Innermost loop being compiled in this function
+			Loop* loop = nullptr;
+		};
+
+		Runtime* runtime;
+		FunctionState* current = nullptr;
+		int line = 0;
+		bool hadError = false;
+
+		Chunk& currentChunk();
+
+		void error(const Token& token, const std::string& message);
+
+		void emit(OpCode op);
+		void emit(OpCode op, uint8_t operand);
+		void emitShort(OpCode op, uint16_t operand);
+		void emitLoop(size_t loopStart);
+		size_t emitJump(OpCode op);
+		void patchJump(size_t jump);
+		void patchJumps(std::vector<size_t>& jumps);
+		void emitReturn();
+
+		uint16_t makeConstant(const Value& value);
+		uint16_t identifierConstant(const Token& name);
+		uint16_t propertyCache();
+
+		void beginScope();
+		void endScope();
+		//Emits the pops for locals deeper than depth, without forgetting them, for jumps out of their scope
+		void discardLocals(int depth);
+		void beginLoop(Loop& loop);
+		void endLoop(Loop& loop);
+
+		void addLocal(Symbol name);
+		int resolveLocal(FunctionState* state, Symbol name);
+		int addUpvalue(FunctionState* state, uint8_t index, bool isLocal);
+		int resolveUpvalue(FunctionState* state, Symbol name);
+
+		void namedVariable(const Token& name, uint16_t environmentDepth, bool isAssignment);
+		void defineVariable(const Token& name, uint16_t variableId);
+
+		void function(FunctionStmt<void, Value>* stmt, FunctionType type);
+
+		void compile(Stmt<void, Value>* stmt);
+		void compile(Expr<Value>* expr);
+
+		Value visitArrayLiteralExpr(ArrayLiteral<Value>* expr) override;
+		Value visitAssignExpr(Assign<Value>* expr) override;
+		Value visitBinaryExpr(Binary<Value>* expr) override;
+		Value visitCallExpr(Call<Value>* expr) override;
+		Value visitGetExpr(Get<Value>* expr) override;
+		Value visitGetIndexExpr(GetIndex<Value>* expr) override;
+		Value visitGroupingExpr(Grouping<Value>* expr) override;
+		Value visitLiteralExpr(Literal<Value>* expr) override;
+		Value visitLogicalExpr(Logical<Value>* expr) override;
+		Value visitMapLiteralExpr(MapLiteral<Value>* expr) override;
+		Value visitSetExpr(Set<Value>* expr) override;
+		Value visitSetIndexExpr(SetIndex<Value>* expr) override;
+		Value visitSuperExpr(Super<Value>* expr) override;
+		Value visitThisExpr(This<Value>* expr) override;
+		Value visitUnaryExpr(Unary<Value>* expr) override;
+		Value visitVariableExpr(Variable<Value>* expr) override;
+
+		void visitBlockStmt(Block<void, Value>* stmt) override;
+		void visitBreakStmt(Break<void, Value>* stmt) override;
+		void visitClassStmt(ClassStmt<void, Value>* stmt) override;
+		void visitContinueStmt(Continue<void, Value>* stmt) override;
+		void visitExpressionStmt(Expression<void, Value>* stmt) override;
+		void visitForStmt(For<void, Value>* stmt) override;
+		void visitFunctionStmt(FunctionStmt<void, Value>* stmt) override;
+		void visitIfStmt(If<void, Value>* stmt) override;
+		void visitPrintStmt(Print<void, Value>* stmt) override;
+		void visitReturnStmt(Return<void, Value>* stmt) override;
+		void visitVarStmt(Var<void, Value>* stmt) override;
+		void visitWhileStmt(While<void, Value>* stmt) override;
+	};
+}
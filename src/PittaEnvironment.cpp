@@ -1,5 +1,6 @@
 #include "PittaEnvironment.hpp"
 #include "PittaHigherTypes.hpp"
+#include "PittaHeap.hpp"
 
 namespace pitta {
 
@@ -7,7 +8,7 @@ namespace pitta {
 		define(name.lexeme, value);
 	}
 
-	void Environment::define(const std::string& name, const Value& value) {
+	void Environment::define(Symbol name, const Value& value) {
 		values.emplace(name, value);
 	}
 
@@ -15,27 +16,32 @@ namespace pitta {
 		assign(name.lexeme, value);
 	}
 
-	void Environment::assign(const std::string& name, const Value& value) {
-		values[name] = value;
+	void Environment::assign(Symbol name, const Value& value) {
+		values[name].assign(value);
 	}
 
-	void Environment::assignAt(int distance, const Token& name, const Value& value) {
-		ancestor(distance)->assign(name, value);
+	void Environment::defineAt(uint16_t slot, const Value& value) {
+		this->slot(slot) = value;
 	}
 
-	Value Environment::getAt(int distance, const std::string& name) {
-		return ancestor(distance)->get(name);
+	void Environment::assignAt(int distance, uint16_t slot, const Value& value) {
+		ancestor(distance)->slot(slot).assign(value);
+	}
+
+	const Value& Environment::getAt(int distance, uint16_t slot) {
+		return ancestor(distance)->slot(slot);
 	}
 
 
-	Value Environment::get(const std::string& name) {
-		if (values.count(name) > 0)
-			return values.at(name);
+	Value Environment::get(Symbol name) {
+		auto value = values.find(name);
+		if (value != values.end())
+			return value->second;
 
 		if (enclosing != nullptr)
 			return enclosing->get(name);
 
-		throw new PittaRuntimeException("Undefined variable '" + name + "'. Cannot read value.");
+		throw new PittaRuntimeException("Undefined variable '" + name.str() + "'. Cannot read value.");
 	}
 	Value Environment::get(const Token& token) {
 		return get(token.lexeme);
@@ -52,7 +58,7 @@ namespace pitta {
 		std::unordered_set<std::string> names;
 		names.reserve(values.size());
 		for (auto& [name, _] : values)
-			names.emplace(name);
+			names.emplace(name.str());
 		return names;
 	}
 	std::unordered_map<std::string, Value> Environment::getDefinedValues(const std::unordered_set<std::string>& without) {
@@ -61,21 +67,35 @@ namespace pitta {
 
 		for (auto& [name, value] : values)
 			if (without.count(name) == 0)
-				definedValues.emplace(name, value);
+				definedValues.emplace(name.str(), value);
 		
 		return definedValues;
 	}
 
 
+	void Environment::trace(Heap& heap)const {
+		for (auto& [_, value] : values)
+			heap.mark(value);
+		for (uint16_t i = 0; i < slotCount && i < PITTA_INLINE_SLOTS; i++)
+			heap.mark(inlineSlots[i]);
+		for (const Value& value : extraSlots)
+			heap.mark(value);
+	}
+
+
 	Environment::Environment() :
 		enclosing()
 	{
 		addTypeBindings(this);
 	}
 
-	Environment::Environment(const shared_data<Environment>& enclosing) :
-		enclosing(enclosing)
-	{}
+	Environment::Environment(const shared_data<Environment>& enclosing, uint16_t slotCount) :
+		enclosing(enclosing),
+		slotCount(slotCount)
+	{
+		if (slotCount > PITTA_INLINE_SLOTS)
+			extraSlots.resize(slotCount - PITTA_INLINE_SLOTS);
+	}
 
 
 	Environment* Environment::ancestor(int distance) {
@@ -84,4 +104,10 @@ namespace pitta {
 			environment = environment->enclosing.get();
 		return environment;
 	}
+
+	Value& Environment::slot(uint16_t index) {
+		if (index < PITTA_INLINE_SLOTS)
+			return inlineSlots[index];
+		return extraSlots[index - PITTA_INLINE_SLOTS];
+	}
 }
\ No newline at end of file
@@ -5,45 +5,68 @@
 #include <stdint.h>
 #include <unordered_set>
 
+//How many local slots an environment stores inside itself before it needs a separate allocation
+#ifndef PITTA_INLINE_SLOTS
+#define PITTA_INLINE_SLOTS 4
+#endif
+
 namespace pitta {
 
-	class Environment{
+	class Heap;
+
+	//Counted from inside, so making one for every block and call is a single allocation
+	class Environment : public intrusive_count {
 	public:
 
 		shared_data<Environment> enclosing;
 
 		void define(const Token& name, const Value& value);
 
-		void define(const std::string& name, const Value& value);
+		void define(Symbol name, const Value& value);
 
 		void assign(const Token& name, const Value& value);
 
-		void assign(const std::string& name, const Value& value);
+		void assign(Symbol name, const Value& value);
+
+		//Slot based access for locals, with slots handed out by the resolver
+		void defineAt(uint16_t slot, const Value& value);
 
-		void assignAt(int distance, const Token& name, const Value& value);
+		void assignAt(int distance, uint16_t slot, const Value& value);
 
 
-		Value get(const std::string& name);
+		Value get(Symbol name);
 		Value get(const Token& token);
 
 		Environment& operator|=(const Environment& other);
 
 
-		Value getAt(int distance, const std::string& name);
+		const Value& getAt(int distance, uint16_t slot);
 
 		std::unordered_set<std::string> getDefinedValueNames()const;
 		std::unordered_map<std::string, Value> getDefinedValues(const std::unordered_set<std::string>& without = {});
 
+		//Marks the values held directly in this environment, not the ones it encloses
+		void trace(Heap& heap)const;
+
 
 		Environment();
 		
-		Environment(const shared_data<Environment>& enclosing);
+		Environment(const shared_data<Environment>& enclosing, uint16_t slotCount = 0);
 
 	private:
+		friend class Heap;
+
+		//Environments are freed by their reference count rather than the collector, which only uses this to visit each once
+		mutable uint32_t markEpoch = 0;
 
-		std::unordered_map<std::string, Value> values;
+		//Only the global environment is keyed by name; every local scope has a fixed number of slots
+		std::unordered_map<Symbol, Value> values;
+		uint16_t slotCount = 0;
+		Value inlineSlots[PITTA_INLINE_SLOTS];
+		std::vector<Value> extraSlots;
 
 		Environment* ancestor(int distance);
+		Value& slot(uint16_t index);
 
 	};
 
@@ -1,6 +1,8 @@
 #pragma once
 #include "PittaTokenScanner.hpp"
+#include "PittaPropertyCache.hpp"
 #include <typeindex>
+#include <stdint.h>
 
 namespace pitta {
 
@@ -16,6 +18,22 @@ namespace pitta {
 	template<class R> class Set;
 	template<class R> class This;
 	template<class R> class Super;
+	template<class R> class ArrayLiteral;
+	template<class R> class GetIndex;
+	template<class R> class SetIndex;
+	template<class R> class MapLiteral;
+
+	//Depth given to any variable the resolver could not find in a local scope. These are looked up
+	//by name in the global environment rather than by slot
+	constexpr uint16_t c_globalVariable = UINT16_MAX;
+
+	//What a binary operator has specialised itself to, from the types of the operands it last saw. A specialised
+	//operator only checks that its operands still have those types, and goes back to Generic when they don't
+	enum class BinaryKind : uint8_t {
+		Generic,
+		IntAdd, IntSubtract, IntMultiply, IntDivide, IntLess, IntLessEqual, IntGreater, IntGreaterEqual,
+		FloatAdd, FloatSubtract, FloatMultiply, FloatDivide, FloatLess, FloatLessEqual, FloatGreater, FloatGreaterEqual
+	};
 
 	template<class T>
 	class ExpressionVisitor {
@@ -32,6 +50,10 @@ namespace pitta {
 		virtual T visitSetExpr(Set<T>* expr) = 0;
 		virtual T visitThisExpr(This<T>* expr) = 0;
 		virtual T visitSuperExpr(Super<T>* expr) = 0;
+		virtual T visitArrayLiteralExpr(ArrayLiteral<T>* expr) = 0;
+		virtual T visitGetIndexExpr(GetIndex<T>* expr) = 0;
+		virtual T visitSetIndexExpr(SetIndex<T>* expr) = 0;
+		virtual T visitMapLiteralExpr(MapLiteral<T>* expr) = 0;
 
 		virtual ~ExpressionVisitor() = default;
 	};
@@ -96,14 +118,30 @@ public:\
 }\
 
 
+	template<class T>
+	class ArrayLiteral : public Expr<T> {
+	public:
+		Token closingBracket;
+		std::vector<Expr<T>*> elements;
+
+		T accept(ExpressionVisitor<T>* visitor)override {
+			return visitor->visitArrayLiteralExpr(this);
+		}
+		std::type_index getType()const override { return typeid(ArrayLiteral); }
+		ArrayLiteral(Token closingBracket, std::vector<Expr<T>*> elements) :
+			closingBracket(closingBracket),
+			elements(elements)
+		{}
+	};
+
 	template<class T>
 	class Assign : public Expr<T> {
 	public:
 		Token name;
 		Expr<T>* value;
 
-		uint16_t environmentDepth;
-		uint16_t variableId;
+		uint16_t environmentDepth = c_globalVariable;
+		uint16_t variableId = 0;
 
 		T accept(ExpressionVisitor<T>* visitor)override {
 			return visitor->visitAssignExpr(this);
@@ -121,6 +159,9 @@ public:\
 		Expr<T>* left;
 		Token op;
 		Expr<T>* right;
+
+		BinaryKind kind = BinaryKind::Generic;
+
 		T accept(ExpressionVisitor<T>* visitor)override {
 			return visitor->visitBinaryExpr(this);
 		}
@@ -134,9 +175,48 @@ public:\
 		{}
 	};
 
-	TripleArgExp(Call, Expr<T>*, callee, Token, closingParenthesis, std::vector<Expr<T>*>, arguments, visitCallExpr);
+	template<class T>
+	class Get : public Expr<T> {
+	public:
+		Expr<T>* object;
+		Token name;
+
+		PropertyCache cache;
+
+		T accept(ExpressionVisitor<T>* visitor)override {
+			return visitor->visitGetExpr(this);
+		}
+		std::type_index getType()const override { return typeid(Get); }
+		Get(Expr<T>* object, Token name) :
+			object(object),
+			name(name)
+		{}
+	};
+
+	template<class T>
+	class Call : public Expr<T> {
+	public:
+		Expr<T>* callee;
+		Token closingParenthesis;
+		std::vector<Expr<T>*> arguments;
 
-	DoubleArgExp(Get, Expr<T>*, object, Token, name, visitGetExpr);
+		//Set when the callee is a property access, so a method can be called on its instance without binding it first
+		Get<T>* method;
+
+		T accept(ExpressionVisitor<T>* visitor)override {
+			return visitor->visitCallExpr(this);
+		}
+		std::type_index getType()const override { return typeid(Call); }
+		Call(Expr<T>* callee, Token closingParenthesis, std::vector<Expr<T>*> arguments) :
+			callee(callee),
+			closingParenthesis(closingParenthesis),
+			arguments(arguments),
+			method(callee->getType() == typeid(Get<T>) ? static_cast<Get<T>*>(callee) : nullptr)
+		{}
+	};
+
+	//An element of an array, as in object[index]
+	TripleArgExp(GetIndex, Expr<T>*, object, Token, closingBracket, Expr<T>*, index, visitGetIndexExpr);
 
 	SingleArgExp(Grouping, Expr<T>*, expression, visitGroupingExpr);
 
@@ -144,11 +224,100 @@ public:\
 
 	TripleArgExp(Logical, Expr<T>*, left, Token, op, Expr<T>*, right, visitLogicalExpr);
 
-	TripleArgExp(Set, Expr<T>*, object, Token, name, Expr<T>*, value, visitSetExpr);
+	template<class T>
+	class MapLiteral : public Expr<T> {
+	public:
+		Token closingBrace;
+		//The key and value of each entry are at the same index
+		std::vector<Expr<T>*> keys;
+		std::vector<Expr<T>*> values;
+
+		T accept(ExpressionVisitor<T>* visitor)override {
+			return visitor->visitMapLiteralExpr(this);
+		}
+		std::type_index getType()const override { return typeid(MapLiteral); }
+		MapLiteral(Token closingBrace, std::vector<Expr<T>*> keys, std::vector<Expr<T>*> values) :
+			closingBrace(closingBrace),
+			keys(keys),
+			values(values)
+		{}
+	};
+
+	template<class T>
+	class Set : public Expr<T> {
+	public:
+		Expr<T>* object;
+		Token name;
+		Expr<T>* value;
+
+		PropertyCache cache;
+
+		T accept(ExpressionVisitor<T>* visitor)override {
+			return visitor->visitSetExpr(this);
+		}
+		std::type_index getType()const override { return typeid(Set); }
+		Set(Expr<T>* object, Token name, Expr<T>* value) :
+			object(object),
+			name(name),
+			value(value)
+		{}
+	};
+
+	template<class T>
+	class SetIndex : public Expr<T> {
+	public:
+		Expr<T>* object;
+		Token closingBracket;
+		Expr<T>* index;
+		Expr<T>* value;
+
+		T accept(ExpressionVisitor<T>* visitor)override {
+			return visitor->visitSetIndexExpr(this);
+		}
+		std::type_index getType()const override { return typeid(SetIndex); }
+		SetIndex(Expr<T>* object, Token closingBracket, Expr<T>* index, Expr<T>* value) :
+			object(object),
+			closingBracket(closingBracket),
+			index(index),
+			value(value)
+		{}
+	};
+
+	template<class T>
+	class Super : public Expr<T> {
+	public:
+		Token keyword;
+		Token method;
+
+		uint16_t environmentDepth = c_globalVariable;
+		uint16_t variableId = 0;
 
-	DoubleArgExp(Super, Token, keyword, Token, method, visitSuperExpr);
+		T accept(ExpressionVisitor<T>* visitor)override {
+			return visitor->visitSuperExpr(this);
+		}
+		std::type_index getType()const override { return typeid(Super); }
+		Super(Token keyword, Token method) :
+			keyword(keyword),
+			method(method)
+		{}
+	};
 
-	SingleArgExp(This, Token, keyword, visitThisExpr);
+	template<class T>
+	class This : public Expr<T> {
+	public:
+		Token keyword;
+
+		uint16_t environmentDepth = c_globalVariable;
+		uint16_t variableId = 0;
+
+		T accept(ExpressionVisitor<T>* visitor)override {
+			return visitor->visitThisExpr(this);
+		}
+		std::type_index getType()const override { return typeid(This); }
+		This(Token keyword) :
+			keyword(keyword)
+		{}
+	};
 
 	DoubleArgExp(Unary, Token, op, Expr<T>*, right, visitUnaryExpr);
 
@@ -157,7 +326,8 @@ public:\
 	public:
 		Token name;
 
-		uint16_t environmentDepth;
+		uint16_t environmentDepth = c_globalVariable;
+		uint16_t variableId = 0;
 
 		T accept(ExpressionVisitor<T>* visitor)override {
 			return visitor->visitVariableExpr(this);
@@ -175,12 +345,19 @@ public:\
 			return expr->accept(this);
 		}
 
+		std::string visitArrayLiteralExpr(ArrayLiteral<std::string>* expr) override{
+			std::string ret = "( array [";
+			for (Expr<std::string>* element : expr->elements)
+				ret += element->accept(this) + ", ";
+			return (expr->elements.empty() ? ret : ret.substr(0, ret.size() - 2)) + "] )";
+		}
+
 		std::string visitAssignExpr(Assign<std::string>* expr) override{
-			return "( " + expr->name.lexeme + " = " + expr->value->accept(this) + " )";
+			return "( " + expr->name.lexeme.str() + " = " + expr->value->accept(this) + " )";
 		}
 
 		std::string visitBinaryExpr(Binary<std::string>* expr) override{
-			const std::string ret = "( " + expr->op.lexeme + " " + expr->left->accept(this) + " " + expr->right->accept(this) + " )";
+			const std::string ret = "( " + expr->op.lexeme.str() + " " + expr->left->accept(this) + " " + expr->right->accept(this) + " )";
 			//printf("Visiting binary expression: %s\n", ret.c_str());
 			return ret;
 		}
@@ -199,6 +376,10 @@ public:\
 			return ret;
 		}
 
+		std::string visitGetIndexExpr(GetIndex<std::string>* expr) override{
+			return "( " + expr->object->accept(this) + " [" + expr->index->accept(this) + "] )";
+		}
+
 		std::string visitGroupingExpr(Grouping<std::string>* expr) override{
 			const std::string ret = "( group" + expr->expression->accept(this) + " )";
 			//printf("Visiting grouping expression: %s\n", ret.c_str());
@@ -212,11 +393,18 @@ public:\
 		}
 
 		std::string visitLogicalExpr(Logical<std::string>* expr) override{
-			const std::string ret = "( " + expr->left->accept(this) + " " + expr->op.lexeme + " " + expr->left->accept(this) + " )";
+			const std::string ret = "( " + expr->left->accept(this) + " " + expr->op.lexeme.str() + " " + expr->left->accept(this) + " )";
 			//printf("Visiting literal expression: %s\n", ret.c_str());
 			return ret;
 		}
 
+		std::string visitMapLiteralExpr(MapLiteral<std::string>* expr) override{
+			std::string ret = "( map {";
+			for (size_t i = 0; i < expr->keys.size(); i++)
+				ret += expr->keys[i]->accept(this) + ": " + expr->values[i]->accept(this) + ", ";
+			return (expr->keys.empty() ? ret : ret.substr(0, ret.size() - 2)) + "} )";
+		}
+
 		std::string visitSetExpr(Set<std::string>* expr) override{
 			throw 0;
 			//TODO
@@ -224,6 +412,10 @@ public:\
 			return ret;
 		}
 
+		std::string visitSetIndexExpr(SetIndex<std::string>* expr) override{
+			return "( " + expr->object->accept(this) + " [" + expr->index->accept(this) + "] = " + expr->value->accept(this) + " )";
+		}
+
 		std::string visitSuperExpr(Super<std::string>* expr) override{
 			throw 0;
 			//TODO
@@ -239,13 +431,13 @@ public:\
 		}
 
 		std::string visitUnaryExpr(Unary<std::string>* expr) override{
-			const std::string ret = "( " + expr->op.lexeme + " " + expr->right->accept(this) + " )";
+			const std::string ret = "( " + expr->op.lexeme.str() + " " + expr->right->accept(this) + " )";
 			//printf("Visiting unary expression: %s\n", ret.c_str());
 			return ret;
 		}
 
 		std::string visitVariableExpr(Variable<std::string>* expr) override{
-			const std::string ret = "( var '" + expr->name.lexeme + "' )";
+			const std::string ret = "( var '" + expr->name.lexeme.str() + "' )";
 			//printf("Visiting unary expression: %s\n", ret.c_str());
 			return ret;
 		}
@@ -2,30 +2,42 @@
 
 #include "PittaValue.hpp"
 #include "PittaInterpreter.hpp"
+#include "PittaHeap.hpp"
+#include <array>
 
 
 namespace pitta {
 
-	typedef Value(*FunctionSigniture)(Interpreter*, const std::vector<Value>&);
+	typedef Value(*FunctionSigniture)(Interpreter*, Arguments);
 	class Instance;
 
-	class Callable {
+	class Callable : public GCObject {
 	public:
+		//The arity of natives that take any number of arguments
+		static constexpr int c_variadic = -1;
 
 		virtual int getArity()const {
 			return arity;
 		}
 
+		bool acceptsArgumentCount(int count)const {
+			const int expected = getArity();
+			return expected == count || expected == c_variadic;
+		}
+
 		const std::string& getName()const{
 			return name;
 		}
-		virtual Value operator()(Interpreter* interpreter, const std::vector<Value>& arguments)const = 0;
+		virtual Value operator()(Interpreter* interpreter, Arguments arguments)const = 0;
 
 		virtual Callable* bind(Instance* instance) {
 			throw new PittaRuntimeException("This type of function cannot be bound.");
 			return nullptr;
 		}
 
+		//Calls the function as a method of self. Unless overridden this binds it to self first
+		virtual Value invoke(Interpreter* interpreter, Instance* self, Arguments arguments);
+
 		Callable(int arity, const std::string& name):
 			arity(arity),
 			name(name)
@@ -36,10 +48,66 @@ namespace pitta {
 		const std::string name;
 	};
 
+	//A script function or class found once, for C++ to call as often as it likes. Keeps what it refers to alive,
+	//even if the script later defines something else under the same name. It must not outlive its interpreter
+	class ScriptFunction {
+	public:
+		//Converts each argument to a value and the result to R, which can be void to ignore it
+		template<class R = Value, class... Args>
+		R call(Args&&... arguments)const {
+			const std::array<Value, sizeof...(Args)> values = { toValue(interpreter->getHeap(), std::forward<Args>(arguments))... };
+			const Value result = interpreter->call(function.asCallable(), Arguments(values.data(), values.size()));
+			if constexpr (std::is_void<R>::value)
+				return;
+			else if constexpr (std::is_same<R, Value>::value)
+				return result;
+			else
+				return static_cast<R>(result);
+		}
+
+		template<class R = Value, class... Args>
+		R operator()(Args&&... arguments)const {
+			return call<R>(std::forward<Args>(arguments)...);
+		}
+
+		const Callable* getCallable()const {
+			return function.asCallable();
+		}
+
+		ScriptFunction(Interpreter* interpreter, const Callable* callable) :
+			interpreter(interpreter),
+			function(callable)
+		{
+			interpreter->getHeap().addRoot(&function);
+		}
+		ScriptFunction(const ScriptFunction& other) :
+			ScriptFunction(other.interpreter, other.getCallable())
+		{}
+		ScriptFunction& operator=(const ScriptFunction& other) {
+			interpreter->getHeap().removeRoot(&function);
+			interpreter = other.interpreter;
+			function = other.function;
+			interpreter->getHeap().addRoot(&function);
+			return *this;
+		}
+		~ScriptFunction() {
+			interpreter->getHeap().removeRoot(&function);
+		}
+
+	private:
+		Interpreter* interpreter;
+		Value function;
+	};
+
+	template<class R, class... Args>
+	R Interpreter::call(const std::string& functionName, Args&&... arguments) {
+		return getFunction(functionName).call<R>(std::forward<Args>(arguments)...);
+	}
+
 	class NativeCallable : public Callable{
 	public:
 
-		Value operator()(Interpreter* interpreter, const std::vector<Value>& arguments)const override {
+		Value operator()(Interpreter* interpreter, Arguments arguments)const override {
 			return func(interpreter, arguments);
 		}
 
@@ -60,35 +128,48 @@ namespace pitta {
 	public:
 		FunctionStmt<void, Value>* declaration;
 		shared_data<Environment> closure;
+		const bool isMethod;
+		//Set for methods that have been bound to an instance
+		Instance* const boundInstance;
 
-		Value operator()(Interpreter* interpreter, const std::vector<Value>& arguments)const override {
-			shared_data<Environment> environment = make_shared_data<Environment>(closure);
-			for (size_t i = 0; i < arguments.size(); i++)
-				environment->define(declaration->params[i], arguments[i]);
-
-			Value toReturn;
+		Value operator()(Interpreter* interpreter, Arguments arguments)const override {
+			return call(interpreter, boundInstance, arguments);
+		}
 
-			try {
-				interpreter->executeBlock(declaration->body, environment);
-			}
-			catch (PittaReturn* returnValue) {
-				toReturn = returnValue->value;
-				delete returnValue;
-			}
-			return toReturn;
+		Value invoke(Interpreter* interpreter, Instance* self, Arguments arguments) override {
+			return call(interpreter, self, arguments);
 		}
 
 		Callable* bind(Instance* instance) override{
-			shared_data<Environment> environment = make_shared_data<Environment>(closure);
-			environment->define(c_classSelfReferenceKey, instance);
-			
-			return new ScriptCallable(declaration, environment);
+			return new ScriptCallable(declaration, closure, true, instance);
+		}
+
+		void trace(Heap& heap)const override {
+			heap.mark(closure.get());
+			heap.mark(boundInstance);
 		}
 
-		ScriptCallable(FunctionStmt<void, Value>* declaration, shared_data<Environment> closure):
+		ScriptCallable(FunctionStmt<void, Value>* declaration, shared_data<Environment> closure, bool isMethod = false, Instance* boundInstance = nullptr):
 			Callable(declaration->params.size(), declaration->name.lexeme),
 			declaration(declaration),
-			closure(closure)
+			closure(std::move(closure)),
+			isMethod(isMethod),
+			boundInstance(boundInstance)
 		{}
+
+	private:
+		Value call(Interpreter* interpreter, Instance* self, Arguments arguments)const {
+			//Parameters are always the first slots declared in a function's scope, after "this" for methods
+			shared_data<Environment> environment = make_shared_data<Environment>(closure, declaration->localCount);
+			uint16_t slot = 0;
+			if (isMethod)
+				environment->defineAt(slot++, self);
+			for (const Value& argument : arguments)
+				environment->defineAt(slot++, argument);
+
+			if (interpreter->executeBlock(declaration->body, std::move(environment)) == ExecutionSignal::Return)
+				return interpreter->takeReturnValue();
+			return Undefined;
+		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include "PittaHeap.hpp"
+#include "PittaEnvironment.hpp"
+#include "PittaFunction.hpp"
+#include "PittaClass.hpp"
+#include "PittaArray.hpp"
+#include "PittaMap.hpp"
+#include <algorithm>
+
+namespace pitta {
+
+	Value Heap::makeString(std::string text) {
+		const size_t length = text.size();
+		StringObject* string = new StringObject(std::move(text));
+		add(string, sizeof(StringObject) + length);
+		return string;
+	}
+
+	void Heap::mark(const Value& value) {
+		switch (value.getType()) {
+		case String:
+			mark(value.asHeapString());
+			break;
+		case Function:
+		case ClassDef:
+			mark(value.asCallable());
+			break;
+		case ClassInstance:
+			mark(value.asInstance());
+			break;
+		case Array:
+			mark(value.asArray());
+			break;
+		case Map:
+			mark(value.asMap());
+			break;
+		default:
+			break;
+		}
+	}
+
+	void Heap::mark(const GCObject* object) {
+		if (object == nullptr || object->markEpoch == epoch || object->markEpoch == c_permanentEpoch)
+			return;
+		object->markEpoch = epoch;
+		grayObjects.emplace_back(object);
+	}
+
+	void Heap::mark(const Environment* environment) {
+		while (environment != nullptr && environment->markEpoch != epoch) {
+			environment->markEpoch = epoch;
+			environment->trace(*this);
+			environment = environment->enclosing.get();
+		}
+	}
+
+	void Heap::addRoot(const Value* root) {
+		roots.emplace_back(root);
+	}
+	void Heap::removeRoot(const Value* root) {
+		roots.erase(std::find(roots.begin(), roots.end(), root));
+	}
+
+	void Heap::addRootSource(GCRoots* source) {
+		rootSources.emplace_back(source);
+	}
+	void Heap::removeRootSource(GCRoots* source) {
+		rootSources.erase(std::find(rootSources.begin(), rootSources.end(), source));
+	}
+
+	void Heap::collect() {
+		const auto start = std::chrono::steady_clock::now();
+		//Anything left over from the last cycle has to go before the marks are reused
+		if (sweepCursor != nullptr)
+			sweep(SIZE_MAX);
+
+		//Objects made from here on are given the new epoch, so the sweep that follows leaves them alone
+		epoch += 1;
+		if (epoch == c_permanentEpoch)
+			epoch = 1;
+		for (GCRoots* source : rootSources)
+			source->markRoots(*this);
+		for (const Value* root : roots)
+			mark(*root);
+
+		while (!grayObjects.empty()) {
+			const GCObject* object = grayObjects.back();
+			grayObjects.pop_back();
+			object->trace(*this);
+		}
+
+		sweepCursor = &objects;
+		stats->collections += 1;
+		recordPause(start);
+	}
+
+	void Heap::setThreshold(size_t bytes) {
+		threshold = bytes;
+		nextCollection = std::max(threshold, stats->bytesInUse * 2);
+	}
+
+	Heap::Heap(GCStats* stats) :
+		stats(stats)
+	{}
+
+	Heap::~Heap() {
+		while (objects != nullptr) {
+			GCObject* next = objects->nextObject;
+			delete objects;
+			objects = next;
+		}
+	}
+
+	void Heap::add(GCObject* object, size_t size) {
+		object->size = uint32_t(size);
+		object->markEpoch = epoch;
+		object->nextObject = objects;
+		objects = object;
+
+		stats->bytesAllocated += size;
+		stats->bytesInUse += size;
+	}
+
+	void Heap::step() {
+		if (sweepCursor == nullptr) {
+			collect();
+			return;
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+		sweep(c_sweepBatch);
+		recordPause(start);
+	}
+
+	void Heap::sweep(size_t count) {
+		for (size_t i = 0; i < count && *sweepCursor != nullptr; i++) {
+			GCObject* object = *sweepCursor;
+			if (object->markEpoch == epoch) {
+				sweepCursor = &object->nextObject;
+				continue;
+			}
+
+			*sweepCursor = object->nextObject;
+			stats->bytesInUse -= object->size;
+			stats->objectsFreed += 1;
+			delete object;
+		}
+
+		if (*sweepCursor == nullptr) {
+			sweepCursor = nullptr;
+			nextCollection = std::max(threshold, stats->bytesInUse * 2);
+		}
+	}
+
+	void Heap::recordPause(std::chrono::steady_clock::time_point start) {
+		const auto pause = std::chrono::steady_clock::now() - start;
+		stats->totalPause += pause;
+		stats->longestPause = std::max<std::chrono::nanoseconds>(stats->longestPause, pause);
+	}
+
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <chrono>
+#include <stdint.h>
+#include "PittaValue.hpp"
+
+//Bytes the heap can grow to before its first collection. After each collection the limit is set to
+//twice what survived, but never below this
+#ifndef PITTA_GC_THRESHOLD
+#define PITTA_GC_THRESHOLD (1024 * 1024)
+#endif
+
+namespace pitta {
+
+	class Heap;
+	class Environment;
+
+	//Anything the collector can free. Objects that are never handed to a heap, such as native functions, can
+	//still be marked, they are just never swept
+	class GCObject {
+	public:
+		//Marks everything this object refers to
+		virtual void trace(Heap& heap)const {}
+
+		virtual ~GCObject() = default;
+
+	private:
+		friend class Heap;
+
+		GCObject* nextObject = nullptr;
+		uint32_t size = 0;
+		mutable uint32_t markEpoch = 0;
+	};
+
+	//The text of a string made while a script runs, such as by concatenation or str. Names and literals are interned
+	//rather than made into these, so the only strings the collector has to free are the ones nothing needs any more
+	class StringObject final : public GCObject {
+	public:
+		const std::string text;
+
+		explicit StringObject(std::string&& text) :
+			text(std::move(text))
+		{}
+		StringObject(const StringObject&) = delete;
+	};
+
+	//Something holding values the collector can't otherwise see, like an interpreter's environments or a vm's stack
+	class GCRoots {
+	public:
+		virtual void markRoots(Heap& heap) = 0;
+
+		virtual ~GCRoots() = default;
+	};
+
+	struct GCStats {
+		size_t bytesAllocated = 0;
+		size_t bytesInUse = 0;
+		size_t collections = 0;
+		size_t objectsFreed = 0;
+		std::chrono::nanoseconds totalPause{ 0 };
+		std::chrono::nanoseconds longestPause{ 0 };
+	};
+
+	//Owns every object a script creates, and frees the ones that can no longer be reached. Marking happens all at once,
+	//sweeping is spread over the safe points that follow
+	class Heap {
+	public:
+		//Hands the object to the heap, which deletes it once it is unreachable
+		template<class T>
+		T* track(T* object) {
+			add(object, sizeof(T));
+			return object;
+		}
+
+		//A string owned by this heap, which only values in this isolate may refer to
+		Value makeString(std::string text);
+
+		void mark(const Value& value);
+		void mark(const GCObject* object);
+		void mark(const Environment* environment);
+
+		//Values held outside of the script, by C++ code, that must survive collection
+		void addRoot(const Value* root);
+		void removeRoot(const Value* root);
+
+		void addRootSource(GCRoots* source);
+		void removeRootSource(GCRoots* source);
+
+		//For objects shared by every isolate, such as natives and the classes bound from C++. No heap writes its marks
+		//into them or traces through them, so they may only refer to other permanent objects
+		template<class T>
+		static T* permanent(T* object) {
+			object->markEpoch = c_permanentEpoch;
+			return object;
+		}
+
+		//Only call where every value still in use can be reached from a root. Collects if the heap has grown
+		//past its threshold, otherwise carries on with any unfinished sweep
+		void safePoint() {
+			if (stats->bytesInUse >= nextCollection || sweepCursor != nullptr)
+				step();
+		}
+
+		void collect();
+
+		void setThreshold(size_t bytes);
+
+		Heap(GCStats* stats);
+		Heap(const Heap&) = delete;
+		~Heap();
+
+	private:
+		static constexpr size_t c_sweepBatch = 256;
+		static constexpr uint32_t c_permanentEpoch = UINT32_MAX;
+
+		GCStats* stats;
+		size_t threshold = PITTA_GC_THRESHOLD;
+		size_t nextCollection = PITTA_GC_THRESHOLD;
+
+		GCObject* objects = nullptr;
+		//Where the unfinished sweep is up to, or nullptr when there isn't one
+		GCObject** sweepCursor = nullptr;
+		uint32_t epoch = 1;
+
+		std::vector<const GCObject*> grayObjects;
+		std::vector<const Value*> roots;
+		std::vector<GCRoots*> rootSources;
+
+		void add(GCObject* object, size_t size);
+		void step();
+		void sweep(size_t count);
+		void recordPause(std::chrono::steady_clock::time_point start);
+	};
+
+	//Turns something C++ hands a script into a value. Strings are copied into the heap, so passing a different one every
+	//time doesn't fill the string table
+	template<class T>
+	Value toValue(Heap& heap, T&& value) {
+		if constexpr (std::is_same<std::decay_t<T>, std::string>::value)
+			return heap.makeString(std::forward<T>(value));
+		else
+			return Value(std::forward<T>(value));
+	}
+
+}
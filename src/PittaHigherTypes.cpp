@@ -61,62 +61,56 @@ namespace pitta {
 
 
 
-	vec2* generateNewVec2(pitta::Interpreter*, const std::vector<pitta::Value>& arguments) {
+	vec2* generateNewVec2(pitta::Interpreter*, pitta::Arguments arguments) {
 		return new vec2(arguments[0].asFloat(), arguments[1].asFloat());
 	}
 
-	std::unordered_map<std::string, pitta::Value> getVec2Fields(vec2* vec) {
-		std::unordered_map<std::string, pitta::Value> binding;
-
-		binding.emplace("x", &vec->x);
-		binding.emplace("y", &vec->y);
-
-		return binding;
+	std::vector<pitta::NativeField> getVec2Fields() {
+		return IntegratedClass<vec2>::FieldBinder()
+			.add<&vec2::x>("x")
+			.add<&vec2::y>("y")
+			.get();
 	}
 
-	IntegratedClass<vec2>* vec2Binding = new pitta::IntegratedClass<vec2>(
-		"vec2", std::unordered_map<std::string, pitta::Callable*>(), 2, generateNewVec2, getVec2Fields
-		);
+	IntegratedClass<vec2>* vec2Binding = Heap::permanent(new pitta::IntegratedClass<vec2>(
+		"vec2", std::unordered_map<std::string, pitta::Callable*>(), 2, generateNewVec2, getVec2Fields()
+		));
 
 
 
-	vec3* generateNewVec3(pitta::Interpreter*, const std::vector<pitta::Value>& arguments) {
+	vec3* generateNewVec3(pitta::Interpreter*, pitta::Arguments arguments) {
 		return new vec3(arguments[0].asFloat(), arguments[1].asFloat(), arguments[2].asFloat());
 	}
 
-	std::unordered_map<std::string, pitta::Value> getVec3Fields(vec3* vec) {
-		std::unordered_map<std::string, pitta::Value> binding;
-
-		binding.emplace("x", &vec->x);
-		binding.emplace("y", &vec->y);
-		binding.emplace("z", &vec->z);
-
-		return binding;
+	std::vector<pitta::NativeField> getVec3Fields() {
+		return IntegratedClass<vec3>::FieldBinder()
+			.add<&vec3::x>("x")
+			.add<&vec3::y>("y")
+			.add<&vec3::z>("z")
+			.get();
 	}
 
-	IntegratedClass<vec3>* vec3Binding = new pitta::IntegratedClass<vec3>(
-		"vec3", std::unordered_map<std::string, pitta::Callable*>(), 3, generateNewVec3, getVec3Fields
-		);
+	IntegratedClass<vec3>* vec3Binding = Heap::permanent(new pitta::IntegratedClass<vec3>(
+		"vec3", std::unordered_map<std::string, pitta::Callable*>(), 3, generateNewVec3, getVec3Fields()
+		));
 
 
-	vec4* generateNewVec4(pitta::Interpreter*, const std::vector<pitta::Value>& arguments) {
+	vec4* generateNewVec4(pitta::Interpreter*, pitta::Arguments arguments) {
 		return new vec4(arguments[0].asFloat(), arguments[1].asFloat(), arguments[2].asFloat(), arguments[3].asFloat());
 	}
 
-	std::unordered_map<std::string, pitta::Value> getVec4Fields(vec4* vec) {
-		std::unordered_map<std::string, pitta::Value> binding;
-
-		binding.emplace("x", &vec->x);
-		binding.emplace("y", &vec->y);
-		binding.emplace("z", &vec->z);
-		binding.emplace("w", &vec->w);
-
-		return binding;
+	std::vector<pitta::NativeField> getVec4Fields() {
+		return IntegratedClass<vec4>::FieldBinder()
+			.add<&vec4::x>("x")
+			.add<&vec4::y>("y")
+			.add<&vec4::z>("z")
+			.add<&vec4::w>("w")
+			.get();
 	}
 
-	IntegratedClass<vec4>* vec4Binding = new pitta::IntegratedClass<vec4>(
-		"vec4", std::unordered_map<std::string, pitta::Callable*>(), 4, generateNewVec4, getVec4Fields
-		);
+	IntegratedClass<vec4>* vec4Binding = Heap::permanent(new pitta::IntegratedClass<vec4>(
+		"vec4", std::unordered_map<std::string, pitta::Callable*>(), 4, generateNewVec4, getVec4Fields()
+		));
 
 
 
@@ -35,6 +35,7 @@ namespace pitta {
 		vec2() = default;
 		vec2(float x, float y);
 	};
+	//The bindings are shared by every isolate, so they are permanent and never marked by any heap
 	extern IntegratedClass<vec2>* vec2Binding;
 
 	class vec3 {
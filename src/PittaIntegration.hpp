@@ -2,7 +2,8 @@
 
 #include "PittaClass.hpp"
 #include "PittaFunction.hpp"
-#include <functional>
+#include <tuple>
+#include <utility>
 
 namespace pitta {
 
@@ -12,7 +13,7 @@ namespace pitta {
 	class IntegratedClass;
 
 	template<class T>
-	using IntegratedFunctionSigniture = std::function<Value(Interpreter*, const std::vector<Value>&, T*)>;
+	using IntegratedFunctionSigniture = Value(*)(Interpreter*, Arguments, T*);
 
 	template<class T>
 	struct NameSigniturePair {
@@ -27,18 +28,68 @@ namespace pitta {
 	};
 
 	template<class T>
-	using NewInstanceGenerator = T* (*)(Interpreter* interpreter, const std::vector<Value>& arguments);
-	template<class T>
-	using FieldsFromInstance = std::unordered_map<std::string, Value>(*)(T*);
+	using NewInstanceGenerator = T* (*)(Interpreter* interpreter, Arguments arguments);
+
+	//Turns a value into a parameter of a bound C++ function, using the value's own conversions
+	template<class Parameter>
+	std::decay_t<Parameter> fromValue(const Value& value) {
+		if constexpr (std::is_same<std::decay_t<Parameter>, Value>::value)
+			return value;
+		else
+			return static_cast<std::decay_t<Parameter>>(value);
+	}
+
+	template<class Method>
+	struct MethodTraits;
+
+	template<class Owner, class Return, class... Parameters>
+	struct MethodTraits<Return(Owner::*)(Parameters...)> {
+		using ReturnType = Return;
+		using ParameterTypes = std::tuple<Parameters...>;
+		static constexpr int arity = sizeof...(Parameters);
+	};
+
+	template<class Owner, class Return, class... Parameters>
+	struct MethodTraits<Return(Owner::*)(Parameters...)const> : MethodTraits<Return(Owner::*)(Parameters...)> {};
+
+	template<class T, auto Method, size_t... Indices>
+	Value callMethod(Interpreter* interpreter, T* instance, Arguments arguments, std::index_sequence<Indices...>) {
+		using Traits = MethodTraits<decltype(Method)>;
+		if constexpr (std::is_void<typename Traits::ReturnType>::value) {
+			(instance->*Method)(fromValue<std::tuple_element_t<Indices, typename Traits::ParameterTypes>>(arguments[Indices])...);
+			return Null;
+		}
+		else
+			return toValue(interpreter->getHeap(), (instance->*Method)(fromValue<std::tuple_element_t<Indices, typename Traits::ParameterTypes>>(arguments[Indices])...));
+	}
+
+	//One of these is stamped out for each bound method, so calling it is a single indirect call with the conversions inlined.
+	//The arity has already been checked by whoever made the call
+	template<class T, auto Method>
+	Value methodThunk(Interpreter* interpreter, Arguments arguments, T* instance) {
+		return callMethod<T, Method>(interpreter, instance, arguments, std::make_index_sequence<MethodTraits<decltype(Method)>::arity>());
+	}
+
+	template<class Member>
+	struct MemberTraits;
+	template<class T, class Field>
+	struct MemberTraits<Field T::*> {
+		using FieldType = Field;
+	};
+
+	//Finds a bound field in an object through its member pointer, which is well defined whatever the layout of T
+	template<class T, auto Member>
+	void* fieldThunk(void* object) {
+		return &(static_cast<T*>(object)->*Member);
+	}
 
 	template<class T>
 	class IntegratedClass : public Class {
 	public:
-		Value operator()(Interpreter* interpreter, const std::vector<Value>& arguments)const override {
+		Value operator()(Interpreter* interpreter, Arguments arguments)const override {
 			shared_data<T> newCppInstance(generateNewInstance(interpreter, arguments));
-			auto fields = getFieldsFromInstance(newCppInstance.get());
 
-			IntegratedInstance<T>* newInstance = new IntegratedInstance<T>(this, newCppInstance, fields);
+			IntegratedInstance<T>* newInstance = new IntegratedInstance<T>(this, newCppInstance);
 
 			interpreter->registerNewInstance(newInstance);
 
@@ -47,8 +98,7 @@ namespace pitta {
 
 		Value createPittaInstance(T* forPittaToOwn, Interpreter* interpreter) {
 			shared_data<T> instanceWrapper(forPittaToOwn, shared_data<T>::usage_flag::Internal_Usage);
-			auto fields = getFieldsFromInstance(forPittaToOwn);
-			IntegratedInstance<T>* newInstance = new IntegratedInstance<T>(this, instanceWrapper, fields);
+			IntegratedInstance<T>* newInstance = new IntegratedInstance<T>(this, instanceWrapper);
 
 			interpreter->registerNewInstance(newInstance);
 
@@ -57,8 +107,7 @@ namespace pitta {
 
 		Value bindExistingInstance(T* instance, Interpreter* interpreter) {
 			shared_data<T> instanceWrapper(instance, shared_data<T>::usage_flag::External_Usage);
-			auto fields = getFieldsFromInstance(instance);
-			IntegratedInstance<T>* newInstance = new IntegratedInstance<T>(this, instanceWrapper, fields);
+			IntegratedInstance<T>* newInstance = new IntegratedInstance<T>(this, instanceWrapper);
 
 			interpreter->registerNewInstance(newInstance);
 
@@ -73,12 +122,40 @@ namespace pitta {
 			return ((IntegratedInstance<T>*)value.asInstance())->getInnerInstance().get();
 		}
 
-		IntegratedClass(const std::string& name, const std::unordered_map<std::string, Callable*>& methods, int generatorArity, NewInstanceGenerator<T> generator, FieldsFromInstance<T> fielder):
+		//Lists the members of T that scripts can read and write, along with how to find each in an object
+		class FieldBinder {
+		public:
+			std::vector<NativeField> get()const {
+				return fields;
+			}
+
+			template<auto Member>
+			FieldBinder& add(const std::string& name) {
+				using Field = typename MemberTraits<decltype(Member)>::FieldType;
+				static_assert(std::is_same<Field, int>::value || std::is_same<Field, float>::value
+					|| std::is_same<Field, bool>::value || std::is_same<Field, std::string>::value,
+					"Native fields can only be ints, floats, bools or strings");
+				const Type type = std::is_same<Field, int>::value ? Int
+					: std::is_same<Field, float>::value ? Float
+					: std::is_same<Field, bool>::value ? Bool
+					: String;
+
+				fields.push_back(NativeField{ Symbol(name), type, &fieldThunk<T, Member> });
+				return *this;
+			}
+
+		private:
+			std::vector<NativeField> fields;
+		};
+
+		IntegratedClass(const std::string& name, const std::unordered_map<std::string, Callable*>& methods, int generatorArity,
+			NewInstanceGenerator<T> generator, const std::vector<NativeField>& fields):
 			Class(name, nullptr, methods),
-			generateNewInstance(generator),
-			getFieldsFromInstance(fielder),
-			generatorArity(generatorArity)
+			generatorArity(generatorArity),
+			generateNewInstance(generator)
 		{
+			nativeFields = fields;
+
 			for (auto& [_, method] : methods)
 				generatedCallables.emplace_back(method);
 			
@@ -97,7 +174,6 @@ namespace pitta {
 		int generatorArity; 
 
 		NewInstanceGenerator<T> generateNewInstance;
-		FieldsFromInstance<T> getFieldsFromInstance;
 
 		std::vector<Callable*> generatedCallables;
 	};
@@ -109,12 +185,17 @@ namespace pitta {
 			return instance;
 		}
 
-		IntegratedInstance(IntegratedClass<T> const* definition, const shared_data<T> instance, std::unordered_map<std::string, Value>& fields):
+		//Nothing is copied out of the object. Its fields are found through the class's table whenever they are used
+		IntegratedInstance(IntegratedClass<T> const* definition, const shared_data<T>& instance):
 			Instance(definition),
 			instance(instance)
-		{
-			this->fields = fields;
+		{}
+
+	protected:
+		void* getNativeObject()const override {
+			return (void*)instance.get();
 		}
+
 	private:
 		shared_data<T> instance;
 	};
@@ -129,26 +210,42 @@ namespace pitta {
 				return callables;
 			}
 
+			//For functions that need the interpreter or the raw arguments. Lambdas can't capture anything
 			template<class Lambda>
 			Binder& add(const std::string& name, int arity, Lambda lambda) {
 				callables.try_emplace(name, new IntegratedCallable(arity, name, IntegratedFunctionSigniture<T>(lambda)));
 				return *this;
 			}
 
+			//Binds a member function of T, working out its arity and how to convert its arguments and result at compile time
+			template<auto Method>
+			Binder& bindMethod(const std::string& name) {
+				callables.try_emplace(name, new IntegratedCallable(MethodTraits<decltype(Method)>::arity, name, &methodThunk<T, Method>));
+				return *this;
+			}
+
 		private:
 			std::unordered_map<std::string, Callable*> callables;
 		};
 
-		Value operator()(Interpreter* interpreter, const std::vector<Value>& arguments)const override {
+		Value operator()(Interpreter* interpreter, Arguments arguments)const override {
 			return function(interpreter, arguments, boundInstance->getInnerInstance().get());
 		}
 
+		Value invoke(Interpreter* interpreter, Instance* self, Arguments arguments) override {
+			return function(interpreter, arguments, static_cast<IntegratedInstance<T>*>(self)->getInnerInstance().get());
+		}
+
 		Callable* bind(Instance* instance) override {
 			IntegratedCallable<T>* boundCallable = new IntegratedCallable<T>(getArity(), getName(), function);
 			boundCallable->boundInstance = (IntegratedInstance<T>*)instance;
 			return boundCallable;
 		}
 
+		void trace(Heap& heap)const override {
+			heap.mark(boundInstance);
+		}
+
 		IntegratedCallable(int arity, const std::string& name, IntegratedFunctionSigniture<T> sig):
 			Callable(arity, name),
 			function(sig),
@@ -190,40 +287,23 @@ namespace pitta {
 			printf("I am at %p\n", this);
 		}
 
-		static std::unordered_map<std::string, Value> getPittaBinding(IT* instance) {
-			std::unordered_map<std::string, Value> binding;
-
-			binding.emplace("name", &instance->name);
-			binding.emplace("age", &instance->age);
-			binding.emplace("funFact", &instance->funFact);
-
-			return binding;
+		static std::vector<NativeField> getPittaFields() {
+			return IntegratedClass<IT>::FieldBinder()
+				.add<&IT::name>("name")
+				.add<&IT::age>("age")
+				.add<&IT::funFact>("funFact")
+				.get();
 		}
-		static IT* generatePittaInstance(Interpreter* interpreter, const std::vector<Value>& arguments) {
+		static IT* generatePittaInstance(Interpreter* interpreter, Arguments arguments) {
 			return new IT(arguments[0].asString(), arguments[1].asInt(), arguments[2].asString());
 		}
 		static std::unordered_map<std::string, Callable*> getPittaFunctions() {
 			return IntegratedCallable<IT>::Binder()
-				.add("sayShortIntro", 0, [](Interpreter*, const std::vector<Value>&, IT* instance)->Value {
-				instance->sayShortIntro();
-				return Null;
-					})
-				.add("sayFunFact", 0, [](Interpreter*, const std::vector<Value>&, IT* instance)->Value {
-						instance->sayShortIntro();
-						return Null;
-					})
-				.add("fullIntro", 0, [](Interpreter*, const std::vector<Value>&, IT* instance)->Value {
-						instance->fullIntro();
-						return Null;
-					})
-				.add("dbc", 0, [](Interpreter*, const std::vector<Value>&, IT* instance)->Value {
-						instance->doubleCheck();
-						return Null;
-					})
-				.add("setFactoids", 2, [](Interpreter*, const std::vector<Value>& arguments, IT* instance)->Value {
-						instance->setFactoids(arguments[0].asString(), arguments[1].asInt());
-						return Null;
-					})
+				.bindMethod<&IT::sayShortIntro>("sayShortIntro")
+				.bindMethod<&IT::sayFunFact>("sayFunFact")
+				.bindMethod<&IT::fullIntro>("fullIntro")
+				.bindMethod<&IT::doubleCheck>("dbc")
+				.bindMethod<&IT::setFactoids>("setFactoids")
 				.get();
 		}
 
@@ -244,6 +324,6 @@ namespace pitta {
 		}
 	};
 
-	IntegratedClass<IT>* ITClass = new IntegratedClass<IT>("IT", IT::getPittaFunctions(), 3, IT::generatePittaInstance, IT::getPittaBinding);
+	IntegratedClass<IT>* ITClass = Heap::permanent(new IntegratedClass<IT>("IT", IT::getPittaFunctions(), 3, IT::generatePittaInstance, IT::getPittaFields()));
 #endif
 }
\ No newline at end of file
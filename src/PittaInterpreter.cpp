@@ -2,40 +2,113 @@
 #include "PittaRuntime.hpp"
 #include "PittaFunction.hpp"
 #include "PittaClass.hpp"
+#include "PittaArray.hpp"
+#include "PittaMap.hpp"
 
 namespace pitta {
 
-	Value Interpreter::visitAssignExpr(Assign<Value>* expr) {
-		Value value = evaluate(expr->value);
+	//Drops any temporaries pushed while it was alive, even when a runtime error is unwinding the stack
+	class TemporaryScope {
+	public:
+		TemporaryScope(std::vector<Value>& temporaries) :
+			temporaries(temporaries),
+			size(temporaries.size())
+		{}
 
-		auto strval = value.toString();
+		~TemporaryScope() {
+			temporaries.resize(size);
+		}
 
-		if (locals.count(expr) == 0) {
-			globals->assign(expr->name, value);
+		//Only values that can point into the heap need to be kept
+		void keep(const Value& value) {
+			const Type type = value.getType();
+			if (type == ClassInstance || type == Function || type == ClassDef || type == Array || type == Map || type == String)
+				push(value);
 		}
-		else {
-			int distance = locals.at(expr);
-			environment->assignAt(distance, expr->name, value);
+
+		//Arguments are viewed where they sit, so they have to be pushed whatever they are. The temporaries never
+		//grow past the capacity reserved up front, otherwise views of them could be left pointing at freed memory
+		void push(const Value& value) {
+			if (temporaries.size() == temporaries.capacity())
+				throw new PittaRuntimeException("Stack overflow.");
+			temporaries.emplace_back(value);
 		}
+	private:
+		std::vector<Value>& temporaries;
+		const size_t size;
+	};
+
+	Value Interpreter::visitArrayLiteralExpr(ArrayLiteral<Value>* expr) {
+		//Elements go straight into the array, which is kept so a collection while one is evaluated can't free it
+		TemporaryScope scope(temporaries);
+		ArrayObject* array = heap.track(new ArrayObject());
+		scope.keep(array);
+		array->reserve(expr->elements.size());
+		for (Expr<Value>* element : expr->elements)
+			array->push(evaluate(element).unbound(heap));
+		return array;
+	}
+	Value Interpreter::visitAssignExpr(Assign<Value>* expr) {
+		Value value = evaluate(expr->value);
+
+		if (expr->environmentDepth == c_globalVariable)
+			globals->assign(expr->name, value.unbound(heap));
+		else
+			environment->assignAt(expr->environmentDepth, expr->variableId, value.unbound(heap));
 
 		return value;
 	}
 
 	Value Interpreter::visitBinaryExpr(Binary<Value>* expr) {
+		TemporaryScope scope(temporaries);
 		Value left = evaluate(expr->left);
+		scope.keep(left);
 		Value right = evaluate(expr->right);
 
+#define Specialised_Case(Kind, ValueType, As, Symbol)\
+			case BinaryKind::Kind:\
+				if (left.getType() == ValueType && right.getType() == ValueType)\
+					return left.As() Symbol right.As();\
+				expr->kind = BinaryKind::Generic;\
+				break
+
+		switch (expr->kind) {
+			Specialised_Case(IntAdd, Int, intValue, +);
+			Specialised_Case(IntSubtract, Int, intValue, -);
+			Specialised_Case(IntMultiply, Int, intValue, *);
+			Specialised_Case(IntDivide, Int, intValue, / );
+			Specialised_Case(IntLess, Int, intValue, < );
+			Specialised_Case(IntLessEqual, Int, intValue, <= );
+			Specialised_Case(IntGreater, Int, intValue, > );
+			Specialised_Case(IntGreaterEqual, Int, intValue, >= );
+			Specialised_Case(FloatAdd, Float, floatValue, +);
+			Specialised_Case(FloatSubtract, Float, floatValue, -);
+			Specialised_Case(FloatMultiply, Float, floatValue, *);
+			Specialised_Case(FloatDivide, Float, floatValue, / );
+			Specialised_Case(FloatLess, Float, floatValue, < );
+			Specialised_Case(FloatLessEqual, Float, floatValue, <= );
+			Specialised_Case(FloatGreater, Float, floatValue, > );
+			Specialised_Case(FloatGreaterEqual, Float, floatValue, >= );
+		case BinaryKind::Generic:
+			break;
+		}
+#undef Specialised_Case
+
 		const std::string invalidTypeMsg = "Invalid numeric types for operator";
 
-#define Numeric_Maths_Switch(OpType, Symbol)\
+		//Operands of the same numeric type specialise the operator for next time
+#define Numeric_Maths_Switch(OpType, Symbol, IntKind, FloatKind)\
 			case OpType:\
 				switch (left.getType()) {\
 				case Int:\
+					if (right.getType() == Int)\
+						expr->kind = BinaryKind::IntKind;\
 					return left.asInt() Symbol right.asInt();\
 				case Float:\
+					if (right.getType() == Float)\
+						expr->kind = BinaryKind::FloatKind;\
 					return left.asFloat() Symbol right.asFloat();\
 				default:\
-					printf("Values are %s (%s) and %s (%s)\n", left.toString().c_str(), c_typeToString.at(left.getType()).c_str(), right.toString().c_str(), c_typeToString.at(right.getType()).c_str());\
 					runtime->error(expr->op, invalidTypeMsg);\
 					throw new PittaRuntimeException(invalidTypeMsg);\
 				}\
@@ -51,22 +124,21 @@ case OpType:\
 	break
 
 		switch (expr->op.type) {
-			Numeric_Maths_Switch(MINUS, -);
-			Numeric_Maths_Switch(PLUS, +);
-			Numeric_Maths_Switch(SLASH, / );
-			Numeric_Maths_Switch(STAR, *);
+			Numeric_Maths_Switch(MINUS, -, IntSubtract, FloatSubtract);
+			Numeric_Maths_Switch(PLUS, +, IntAdd, FloatAdd);
+			Numeric_Maths_Switch(SLASH, / , IntDivide, FloatDivide);
+			Numeric_Maths_Switch(STAR, *, IntMultiply, FloatMultiply);
 
 		case EQUAL_EQUAL:
 			return left == right;
 		case BANG_EQUAL:
 			return !(left == right);
-			Numeric_Maths_Switch(LESS, < );
-			Numeric_Maths_Switch(GREATER, > );
-			Numeric_Maths_Switch(LESS_EQUAL, <= );
-			Numeric_Maths_Switch(GREATER_EQUAL, >= );
+			Numeric_Maths_Switch(LESS, < , IntLess, FloatLess);
+			Numeric_Maths_Switch(GREATER, > , IntGreater, FloatGreater);
+			Numeric_Maths_Switch(LESS_EQUAL, <= , IntLessEqual, FloatLessEqual);
+			Numeric_Maths_Switch(GREATER_EQUAL, >= , IntGreaterEqual, FloatGreaterEqual);
 
 		case SHIFT_LEFT:
-			printf("%d << %d = %d\n", left.asInt(), right.asInt(), left.asInt() << right.asInt());
 			return left.asInt() << right.asInt();
 		case SHIFT_RIGHT:
 			return left.asInt() >> right.asInt();
@@ -77,7 +149,7 @@ case OpType:\
 				throw new PittaRuntimeException("Non string values cannot undergo string style concatination");
 			}
 			else {
-				return left.asString() + right.asString();
+				return heap.makeString(left.asString() + right.asString());
 			}
 			Integer_Maths_Switch(BIT_AND, &);
 			Integer_Maths_Switch(BIT_OR, | );
@@ -91,19 +163,43 @@ case OpType:\
 	}
 
 	Value Interpreter::visitCallExpr(Call<Value>* expr) {
-		Value callee = evaluate(expr->callee);
+		//The callee and arguments stay in temporaries until the call is over
+		TemporaryScope scope(temporaries);
+		Value callee;
+		//A method called straight off its instance is invoked with it, rather than bound to it first.
+		//The method is kept alive by the instance's class
+		Instance* self = nullptr;
+		Callable* method = nullptr;
+		if (expr->method != nullptr) {
+			Value object = evaluate(expr->method->object);
+			if (object.getType() != ClassInstance)
+				throw new PittaRuntimeException("On '" + expr->method->name.lexeme.str() + "': Only instances have properties.");
+			scope.keep(object);
+
+			self = object.asInstance();
+			method = self->getMethod(expr->method->name.lexeme, expr->method->cache, runtime->inlineCaches, callee, heap);
+			if (method != nullptr)
+				callee = method;
+			else
+				scope.keep(callee);
+		}
+		else {
+			callee = evaluate(expr->callee);
+			scope.keep(callee);
+		}
 
-		std::vector<Value> arguments;
-		arguments.reserve(expr->arguments.size());
+		//Each argument's own temporaries are gone by the time it is pushed, so the arguments end up next to each other
+		const size_t firstArgument = temporaries.size();
 		for (Expr<Value>* arg : expr->arguments)
-			arguments.emplace_back(evaluate(arg));
+			scope.push(evaluate(arg));
+		const Arguments arguments(temporaries.data() + firstArgument, expr->arguments.size());
 
 		if (callee.getType() != Function && callee.getType() != ClassDef) {
 			runtime->error(expr->closingParenthesis, "Can only call functions and classes.");
 			throw new PittaRuntimeException("Can only call functions and classes.");
 		}
 
-		if (callee.asCallable()->getArity() != arguments.size()) {
+		if (!callee.asCallable()->acceptsArgumentCount(int(arguments.size()))) {
 			std::string errMsg = "Incorrect number of arguments in function call. Passed in "
 				+ std::to_string(arguments.size()) + ", expected "
 				+ std::to_string(callee.asCallable()->getArity()) + ".";
@@ -111,18 +207,33 @@ case OpType:\
 			throw new PittaRuntimeException(errMsg);
 		}
 
+		if (method != nullptr)
+			return method->invoke(this, self, arguments);
 		return (*callee.asCallable())(this, arguments);
 	}
 
 	Value Interpreter::visitGetExpr(Get<Value>* expr) {
 		Value object = evaluate(expr->object);
 		if (object.getType() == ClassInstance)
-			return object.asInstance()->get(expr->name);
+			return object.asInstance()->get(expr->name.lexeme, expr->cache, runtime->inlineCaches, heap);
 
-		throw new PittaRuntimeException("On '" + expr->name.lexeme + "': Only instances have properties.");
+		throw new PittaRuntimeException("On '" + expr->name.lexeme.str() + "': Only instances have properties.");
 		return Null;
 	}
 
+	Value Interpreter::visitGetIndexExpr(GetIndex<Value>* expr) {
+		TemporaryScope scope(temporaries);
+		Value object = evaluate(expr->object);
+		scope.keep(object);
+		Value index = evaluate(expr->index);
+
+		if (object.getType() == Array)
+			return object.asArray()->get(index);
+		if (object.getType() == Map)
+			return object.asMap()->get(index);
+		runtime->error(expr->closingBracket, "Only arrays and maps can be indexed.");
+		throw new PittaRuntimeException("Only arrays and maps can be indexed.");
+	}
 	Value Interpreter::visitGroupingExpr(Grouping<Value>* expr) {
 		return evaluate(expr->expression);
 	}
@@ -140,36 +251,69 @@ case OpType:\
 		return expr->value;
 	}
 
+	Value Interpreter::visitMapLiteralExpr(MapLiteral<Value>* expr) {
+		TemporaryScope scope(temporaries);
+		MapObject* map = heap.track(new MapObject());
+		scope.keep(map);
+		for (size_t i = 0; i < expr->keys.size(); i++) {
+			//Each key is kept until its value has been evaluated and the entry added
+			TemporaryScope entryScope(temporaries);
+			Value key = evaluate(expr->keys[i]).unbound(heap);
+			entryScope.keep(key);
+			map->set(key, evaluate(expr->values[i]).unbound(heap));
+		}
+		return map;
+	}
 	Value Interpreter::visitSetExpr(Set<Value>* expr) {
+		TemporaryScope scope(temporaries);
 		Value object = evaluate(expr->object);
+		scope.keep(object);
 
 #ifdef _DEBUG
 		if (object.getType() != ClassInstance)
-			throw(new PittaRuntimeException(expr->name.lexeme + ": Only instances have fields."));
+			throw(new PittaRuntimeException(expr->name.lexeme.str() + ": Only instances have fields."));
 #endif
 		
 		Value value = evaluate(expr->value);
-		object.asInstance()->set(expr->name, value);
+		object.asInstance()->set(expr->name.lexeme, value.unbound(heap), expr->cache, runtime->inlineCaches);
 		return value;
 	}
 
+	Value Interpreter::visitSetIndexExpr(SetIndex<Value>* expr) {
+		TemporaryScope scope(temporaries);
+		Value object = evaluate(expr->object);
+		scope.keep(object);
+		//A map's key can be an object, which has to survive the value being evaluated
+		Value index = evaluate(expr->index);
+		scope.keep(index);
+		Value value = evaluate(expr->value);
+
+		if (object.getType() == Array)
+			object.asArray()->set(index, value.unbound(heap));
+		else if (object.getType() == Map)
+			object.asMap()->set(index.unbound(heap), value.unbound(heap));
+		else {
+			runtime->error(expr->closingBracket, "Only arrays and maps can be indexed.");
+			throw new PittaRuntimeException("Only arrays and maps can be indexed.");
+		}
+		return value;
+	}
 	Value Interpreter::visitSuperExpr(Super<Value>* expr) {
-		const int distance = locals.at(expr);
-		Class const*const superclass = environment->getAt(distance, "super").asClass();
-		Instance* const instance = environment->getAt(distance - 1, "this").asInstance();
+		//"this" always sits in the first slot of the environment just inside the one holding "super"
+		const int distance = expr->environmentDepth;
+		Class const*const superclass = environment->getAt(distance, expr->variableId).asClass();
+		Instance* const instance = environment->getAt(distance - 1, 0).asInstance();
 
 		Callable* const method = superclass->findMethod(expr->method.lexeme);
 #ifdef _DEBUG
 		if (method == nullptr)
-			runtime->runtimeError(new PittaRuntimeException("Undefined propery '" + expr->method.lexeme + "'."));
+			runtime->runtimeError(new PittaRuntimeException("Undefined propery '" + expr->method.lexeme.str() + "'."));
 #endif
-		Callable* boundCallable = method->bind(instance);
-		generatedCallables.emplace_back(boundCallable);
-		return boundCallable;
+		return instance->bindMethod(method);
 	}
 
 	Value Interpreter::visitThisExpr(This<Value>* expr) {
-		return lookUpVariable(expr->keyword, expr);
+		return lookUpVariable(expr->keyword, expr->environmentDepth, expr->variableId);
 	}
 
 	Value Interpreter::visitUnaryExpr(Unary<Value>* expr) {
@@ -205,7 +349,7 @@ case OpType:\
 	}
 
 	Value Interpreter::visitVariableExpr(Variable<Value>* expr) {
-		return lookUpVariable(expr->name, expr);
+		return lookUpVariable(expr->name, expr->environmentDepth, expr->variableId);
 	}
 
 	Value Interpreter::evaluate(Expr<Value>* expression) {
@@ -219,8 +363,39 @@ case OpType:\
 
 
 
+	//Puts the environment back at the end, and leaves the one being left on the stack where the collector can still see it.
+	//Both are handed over by moving, so entering and leaving a scope doesn't touch any reference counts
+	class SetBack {
+	public:
+		SetBack(shared_data<Environment>& toSet, std::vector<const Environment*>& stack, shared_data<Environment>&& value):
+			toSet(toSet),
+			previous(std::move(toSet)),
+			stack(stack)
+		{
+			stack.emplace_back(previous.get());
+			toSet = std::move(value);
+		}
+
+		~SetBack() {
+			toSet = std::move(previous);
+			stack.pop_back();
+		}
+	private:
+		shared_data<Environment>& toSet;
+		shared_data<Environment> previous;
+		std::vector<const Environment*>& stack;
+	};
+
 	void Interpreter::visitBlockStmt(Block<void, Value>* stmt) {
-		executeBlock(stmt->statements, make_shared_data<Environment>(environment));
+		//The resolver keeps the variables of a block nothing can capture in the enclosing environment
+		if (stmt->localCount == 0)
+			executeStatements(stmt->statements);
+		else
+			executeBlock(stmt->statements, make_shared_data<Environment>(environment, stmt->localCount));
+	}
+
+	void Interpreter::visitBreakStmt(Break<void, Value>* stmt) {
+		signal = ExecutionSignal::Break;
 	}
 
 	void Interpreter::visitClassStmt(ClassStmt<void, Value>* stmt) {
@@ -233,37 +408,52 @@ case OpType:\
 #endif
 		}
 
-		environment->define(stmt->name, Null);
+		defineVariable(stmt->name, stmt->variableId, Null);
 		//Have to do some tomfoolery to prevent a "super" environment from going out of scope
-		shared_data<Environment> superEnvironment = make_shared_data<Environment>(environment);
+		shared_data<Environment> superEnvironment;
 		shared_data<Environment>* workingEnvironment = &environment;
 
 		if (stmt->superclass != nullptr) {
+			superEnvironment = make_shared_data<Environment>(environment, 1);
 			workingEnvironment = &superEnvironment;
-			superEnvironment->define("super", superclass);
+			superEnvironment->defineAt(0, superclass);
 		}
 
-		std::unordered_map<std::string, Callable*> methods;
+		std::unordered_map<Symbol, Callable*> methods;
 		for (auto& method : stmt->methods) {
-			Callable* function = new ScriptCallable(method, *workingEnvironment);
+			Callable* function = heap.track(new ScriptCallable(method, *workingEnvironment, true));
 			methods.emplace(method->name.lexeme, function);
-			generatedCallables.emplace_back(function);
 		}
 
-		Class* classDefinition = new Class(stmt->name.lexeme, superclass.asClass(), std::move(methods));
-		generatedClasses.emplace_back(classDefinition);
+		Class* classDefinition = heap.track(new Class(stmt->name.lexeme, superclass.asClass(), std::move(methods)));
+
+		if (stmt->variableId == c_globalVariable)
+			environment->assign(stmt->name, classDefinition);
+		else
+			environment->assignAt(0, stmt->variableId, classDefinition);
+	}
 
-		environment->assign(stmt->name, classDefinition);
+	void Interpreter::visitContinueStmt(Continue<void, Value>* stmt) {
+		signal = ExecutionSignal::Continue;
 	}
 
 	void Interpreter::visitExpressionStmt(Expression<void, Value>* stmt) {
 		evaluate(stmt->expression);
 	}
 
+	void Interpreter::visitForStmt(For<void, Value>* stmt) {
+		//The loop variable has one environment for the whole loop, not one per iteration
+		if (stmt->localCount > 0) {
+			SetBack raiiTrySafe(environment, environmentStack, make_shared_data<Environment>(environment, stmt->localCount));
+			executeFor(stmt);
+		}
+		else
+			executeFor(stmt);
+	}
+
 	void Interpreter::visitFunctionStmt(FunctionStmt<void, Value>* stmt){
-		ScriptCallable* function = new ScriptCallable(stmt, environment);
-		generatedCallables.emplace_back(function);
-		environment->define(stmt->name, function);
+		ScriptCallable* function = heap.track(new ScriptCallable(stmt, environment));
+		defineVariable(stmt->name, stmt->variableId, function);
 	}
 
 	void Interpreter::visitIfStmt(If<void, Value>* stmt) {
@@ -279,11 +469,9 @@ case OpType:\
 	}
 	
 	void Interpreter::visitReturnStmt(Return<void, Value>* stmt) {
-		Value val;
-		if (stmt->value != nullptr)
-			val = evaluate(stmt->value);
+		returnValue = stmt->value != nullptr ? evaluate(stmt->value) : Value(Undefined);
 
-		throw new PittaReturn(val);
+		signal = ExecutionSignal::Return;
 	}
 
 	void Interpreter::visitVarStmt(Var<void, Value>* stmt) {
@@ -292,47 +480,88 @@ case OpType:\
 			value = evaluate(stmt->initializer);
 		}
 
-		environment->define(stmt->name, value);
+		defineVariable(stmt->name, stmt->variableId, value);
 	}
 
 	void Interpreter::visitWhileStmt(While<void, Value>* stmt) {
 		while (evaluate(stmt->condition).isTruthy()) {
-			execute(stmt->body);
+			if (!executeLoopBody(stmt->body))
+				break;
 		}
+
+		//A break stops here, a return carries on out to the function call
+		if (signal == ExecutionSignal::Break)
+			signal = ExecutionSignal::Normal;
 	}
 
-	void Interpreter::execute(Stmt<void, Value>* stmt) {
+	ExecutionSignal Interpreter::execute(Stmt<void, Value>* stmt) {
+		//Nothing is half evaluated between statements, so everything in use is reachable from the roots
+		heap.safePoint();
 		stmt->accept(this);
+		return signal;
 	}
 
 
-	class SetBack {
-	public:
-		SetBack(shared_data<Environment>& toSet, const shared_data<Environment>& value):
-			toSet(toSet),
-			value(value)
-		{}
-
-		~SetBack() {
-			toSet = value;
+	ExecutionSignal Interpreter::executeStatements(const std::vector<Stmt<void, Value>*>& statements) {
+		for (Stmt<void, Value>* statement : statements) {
+			if (execute(statement) != ExecutionSignal::Normal)
+				break;
 		}
-	private:
-		shared_data<Environment>& toSet;
-		shared_data<Environment> value;
-	};
+		return signal;
+	}
 
-	void Interpreter::executeBlock(const std::vector<Stmt<void, Value>*>& statements, const shared_data<Environment>& newEnv) {
-		shared_data<Environment> previous = environment;
-		environment = newEnv;
-		SetBack raiiTrySafe(environment, previous);
+	bool Interpreter::executeLoopBody(Stmt<void, Value>* body) {
+		if (execute(body) == ExecutionSignal::Normal)
+			return true;
+		if (signal != ExecutionSignal::Continue)
+			return false;
+		signal = ExecutionSignal::Normal;
+		return true;
+	}
 
-		try {
-			for (Stmt<void, Value>* statement : statements)
-				execute(statement);
+	void Interpreter::executeFor(For<void, Value>* stmt) {
+		if (stmt->initializer != nullptr)
+			execute(stmt->initializer);
+
+		while (stmt->condition == nullptr || evaluate(stmt->condition).isTruthy()) {
+			if (!executeLoopBody(stmt->body))
+				break;
+			if (stmt->increment != nullptr)
+				evaluate(stmt->increment);
 		}
-		catch (PittaRuntimeException* error) {
-			throw(error);
+
+		if (signal == ExecutionSignal::Break)
+			signal = ExecutionSignal::Normal;
+	}
+
+	ExecutionSignal Interpreter::executeBlock(const std::vector<Stmt<void, Value>*>& statements, shared_data<Environment>&& newEnv) {
+		SetBack raiiTrySafe(environment, environmentStack, std::move(newEnv));
+		return executeStatements(statements);
+	}
+
+	Value Interpreter::takeReturnValue() {
+		signal = ExecutionSignal::Normal;
+		return returnValue;
+	}
+
+	ScriptFunction Interpreter::getFunction(const std::string& name) {
+		const Value function = globals->get(Symbol(name));
+		if (function.getType() != Function && function.getType() != ClassDef)
+			throw new PittaRuntimeException("'" + name + "' is not a function or class.");
+		return ScriptFunction(this, function.asCallable());
+	}
+
+	Value Interpreter::call(const Callable* callable, Arguments arguments) {
+		if (!callable->acceptsArgumentCount(int(arguments.size()))) {
+			throw new PittaRuntimeException("Incorrect number of arguments in call to '" + callable->getName() + "'. Passed in "
+				+ std::to_string(arguments.size()) + ", expected " + std::to_string(callable->getArity()) + ".");
 		}
+
+		TemporaryScope scope(temporaries);
+		const size_t firstArgument = temporaries.size();
+		for (const Value& argument : arguments)
+			scope.push(argument);
+		return (*callable)(this, Arguments(temporaries.data() + firstArgument, arguments.size()));
 	}
 
 
@@ -347,8 +576,13 @@ case OpType:\
 
 	void Interpreter::interpret(const std::vector<Stmt<void, Value>*>& statements) {
 		try {
-			for (Stmt<void, Value>* statement : statements)
-				execute(statement);
+			for (Stmt<void, Value>* statement : statements) {
+				//Only a stray top level return can get here, which ends the script
+				if (execute(statement) != ExecutionSignal::Normal) {
+					signal = ExecutionSignal::Normal;
+					break;
+				}
+			}
 		}
 		catch (PittaRuntimeException* exception) {
 			runtime->runtimeError(exception);
@@ -357,26 +591,23 @@ case OpType:\
 
 	Interpreter::Interpreter(Runtime* runtime):
 		runtime(runtime),
+		heap(&runtime->gcStats),
 		globals(make_shared_data<Environment>())
 	{
 		environment = globals;
+		temporaries.reserve(PITTA_MAX_TEMPORARIES);
+		heap.addRootSource(this);
 	}
 
 
 	Interpreter::Interpreter(Runtime* runtime, const shared_data<Environment>& globals):
 		runtime(runtime),
+		heap(&runtime->gcStats),
 		globals(globals)
 	{
 		environment = globals;
-	}
-
-	Interpreter::~Interpreter() {
-		for (auto genFunc : generatedCallables)
-			delete genFunc;
-		for (auto genClass : generatedClasses)
-			delete genClass;
-		for (auto genInstance : generatedInstances)
-			delete genInstance;
+		temporaries.reserve(PITTA_MAX_TEMPORARIES);
+		heap.addRootSource(this);
 	}
 
 
@@ -388,22 +619,47 @@ case OpType:\
 		return environment.get();
 	}
 
-	void Interpreter::resolve(Expr<Value>* expression, int depth) {
-		locals.emplace(expression, depth);
+	Environment* Interpreter::getGlobals() {
+		return globals.get();
+	}
+
+	Heap& Interpreter::getHeap() {
+		return heap;
 	}
 
-	Value Interpreter::lookUpVariable(const Token& name, Expr<Value>* expr) {
-		if (locals.count(expr) == 0) {
+	JobSystem* Interpreter::getJobSystem() {
+		return jobSystem;
+	}
+
+	void Interpreter::setJobSystem(JobSystem* jobSystem) {
+		this->jobSystem = jobSystem;
+	}
+
+	void Interpreter::defineVariable(const Token& name, uint16_t variableId, const Value& value) {
+		if (variableId == c_globalVariable)
+			environment->define(name, value);
+		else
+			environment->defineAt(variableId, value);
+	}
+
+	Value Interpreter::lookUpVariable(const Token& name, uint16_t environmentDepth, uint16_t variableId) {
+		if (environmentDepth == c_globalVariable)
 			return globals->get(name);
-		}
-		else {
-			int distance = locals.at(expr);
-			return environment->getAt(distance, name.lexeme);
-		}
+		return environment->getAt(environmentDepth, variableId);
 	}
 
 	void Interpreter::registerNewInstance(Instance* newInstance) {
-		generatedInstances.emplace_back(newInstance);
+		heap.track(newInstance);
+	}
+
+	void Interpreter::markRoots(Heap& heap) {
+		heap.mark(globals.get());
+		heap.mark(environment.get());
+		for (const Environment* saved : environmentStack)
+			heap.mark(saved);
+		for (const Value& value : temporaries)
+			heap.mark(value);
+		heap.mark(returnValue);
 	}
 
 }
\ No newline at end of file
@@ -2,16 +2,37 @@
 #include "PittaStatements.hpp"
 #include "PittaEnvironment.hpp"
 #include "PittaRuntime.hpp"
+#include "PittaHeap.hpp"
+
+//How many values the tree walker can hold on to at once while evaluating, including the arguments of every call
+//in progress. Running out is reported as a stack overflow
+#ifndef PITTA_MAX_TEMPORARIES
+#define PITTA_MAX_TEMPORARIES (64 * 1024)
+#endif
 
 namespace pitta {
 	class Resolver;
 	class Class;
 	class Instance;
+	class Callable;
+	class ScriptFunction;
+	class JobSystem;
+
+	//How a statement finished. Anything other than Normal unwinds through the enclosing blocks until
+	//something that handles it: a loop for Break and Continue, a function call for Return
+	enum class ExecutionSignal : char {
+		Normal,
+		Return,
+		Break,
+		Continue
+	};
 
-	class Interpreter final : public ExpressionVisitor<Value>, public StatementVisitor<void, Value> {
+	class Interpreter final : public ExpressionVisitor<Value>, public StatementVisitor<void, Value>, private GCRoots {
 		friend class Resolver;
 	public:
 
+		Value visitArrayLiteralExpr(ArrayLiteral<Value>* expr);
+
 		Value visitAssignExpr(Assign<Value>* expr);
 
 		Value visitBinaryExpr(Binary<Value>* expr);
@@ -20,14 +41,20 @@ namespace pitta {
 
 		Value visitGetExpr(Get<Value>* expr);
 
+		Value visitGetIndexExpr(GetIndex<Value>* expr);
+
 		Value visitGroupingExpr(Grouping<Value>* expr);
 
 		Value visitLiteralExpr(Literal<Value>* expr);
 
 		Value visitLogicalExpr(Logical<Value>* expr);
 
+		Value visitMapLiteralExpr(MapLiteral<Value>* expr);
+
 		Value visitSetExpr(Set<Value>* expr);
 
+		Value visitSetIndexExpr(SetIndex<Value>* expr);
+
 		Value visitSuperExpr(Super<Value>* expr);
 
 		Value visitThisExpr(This<Value>* expr);
@@ -40,10 +67,16 @@ namespace pitta {
 		
 		void visitBlockStmt(Block<void, Value>* stmt);
 
+		void visitBreakStmt(Break<void, Value>* stmt);
+
 		void visitClassStmt(ClassStmt<void, Value>* stmt);
 
+		void visitContinueStmt(Continue<void, Value>* stmt);
+
 		void visitExpressionStmt(Expression<void, Value>* stmt);
 
+		void visitForStmt(For<void, Value>* stmt);
+
 		void visitFunctionStmt(FunctionStmt<void, Value>* stmt);
 
 		void visitIfStmt(If<void, Value>* stmt);
@@ -59,34 +92,68 @@ namespace pitta {
 		void interpret(Expr<Value>* expression);
 		void interpret(const std::vector<Stmt<void, Value>*>& statements);
 
-		void executeBlock(const std::vector<Stmt<void, Value>*>& statements, const shared_data<Environment>& newEnv);
+		ExecutionSignal executeBlock(const std::vector<Stmt<void, Value>*>& statements, shared_data<Environment>&& newEnv);
+
+		//Hands back the value of the last return statement, and clears the signal so execution can carry on
+		Value takeReturnValue();
+
+		//Looks up a global function or class once, so C++ can keep calling it without finding it again
+		ScriptFunction getFunction(const std::string& name);
+
+		//Calls a global function with C++ values, converting what it returns to R. Looks the function up every time,
+		//so keep the handle from getFunction for anything called often
+		template<class R = Value, class... Args>
+		R call(const std::string& functionName, Args&&... arguments);
+
+		//Calls from C++ into anything callable, on whichever engine it was made by. The arguments are copied onto
+		//the interpreter's own stack first, where the collector can see them
+		Value call(const Callable* callable, Arguments arguments);
 
 		Runtime* getRuntime();
 		Environment* getEnvironment();
+		Environment* getGlobals();
+		Heap& getHeap();
+
+		//Where tasks spawned by scripts this interpreter runs go, or nullptr if they can't spawn any
+		JobSystem* getJobSystem();
+		void setJobSystem(JobSystem* jobSystem);
 
 		void registerNewInstance(Instance* newInstance);
 
 		Interpreter(Runtime* runtime);
 		Interpreter(Runtime* runtime, const shared_data<Environment>& globals);
-		~Interpreter();
 	private:
 		Runtime* runtime;
 
-		//While running, thiiings could be made. We want to collect them all so we can delete them in the end
-		std::vector<Callable*> generatedCallables;
-		std::vector<Class*> generatedClasses;
-		std::vector<Instance*> generatedInstances;
+		//Everything made while running lives here until nothing can reach it
+		Heap heap;
 
 		shared_data<Environment> globals;
 		shared_data<Environment> environment;
-		std::unordered_map<Expr<Value>*, int> locals;
+		//The environments of every block being run outside of the current one, kept alive by the blocks themselves
+		std::vector<const Environment*> environmentStack;
+		//Values an expression is holding on to while it evaluates others, such as the arguments of a call.
+		//Its capacity is reserved once and never grows, so calls can be handed a view of their arguments in it
+		std::vector<Value> temporaries;
+
+		ExecutionSignal signal = ExecutionSignal::Normal;
+		Value returnValue;
+
+		JobSystem* jobSystem = nullptr;
 
 		Value evaluate(Expr<Value>* expression);
 
-		void execute(Stmt<void, Value>* stmt);
+		ExecutionSignal execute(Stmt<void, Value>* stmt);
+		//Runs statements in the current environment, stopping at the first one that doesn't finish normally
+		ExecutionSignal executeStatements(const std::vector<Stmt<void, Value>*>& statements);
+		//Runs the body of a loop, and says whether to carry on with the next iteration
+		bool executeLoopBody(Stmt<void, Value>* body);
+		void executeFor(For<void, Value>* stmt);
+
+		void defineVariable(const Token& name, uint16_t variableId, const Value& value);
 
-		void resolve(Expr<Value>* expression, int depth);
+		Value lookUpVariable(const Token& name, uint16_t environmentDepth, uint16_t variableId);
 
-		Value lookUpVariable(const Token& name, Expr<Value>* expr);
+		void markRoots(Heap& heap) override;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "PittaIsolate.hpp"
+#include "PittaOptimiser.hpp"
+#include "PittaStl.hpp"
+#include "PittaJobs.hpp"
+
+namespace pitta {
+
+	//The top level function and class declarations, which are all a script defines without running
+	static std::vector<Stmt<void, Value>*> declarationsOf(const std::vector<Stmt<void, Value>*>& statements) {
+		std::vector<Stmt<void, Value>*> declarations;
+		for (Stmt<void, Value>* stmt : statements) {
+			if (dynamic_cast<FunctionStmt<void, Value>*>(stmt) != nullptr || dynamic_cast<ClassStmt<void, Value>*>(stmt) != nullptr)
+				declarations.emplace_back(stmt);
+		}
+		return declarations;
+	}
+
+	bool Isolate::run(std::string_view source, bool useVM) {
+		//Each script reports its own errors
+		runtime.hadError = false;
+		AbstractSyntaxTree<void, Value>& tree = trees.emplace_back(compile(source));
+		if (runtime.hadError)
+			return false;
+
+		//Tasks can call anything the script declares, so the workers load it before it can spawn any. The tree is
+		//handed over before running it specialises anything
+		if (jobs != nullptr)
+			jobs->addScript(source, declarationsOf(tree.statements));
+
+		if (useVM) {
+			if (vm == nullptr)
+				vm = std::make_unique<VM>(&interpreter);
+			vm->interpret(tree.statements);
+		}
+		else
+			interpreter.interpret(tree.statements);
+		return !runtime.hadError;
+	}
+
+	bool Isolate::load(std::string_view source) {
+		runtime.hadError = false;
+		AbstractSyntaxTree<void, Value>& tree = trees.emplace_back(compile(source));
+		if (runtime.hadError)
+			return false;
+
+		interpreter.interpret(declarationsOf(tree.statements));
+		return !runtime.hadError;
+	}
+
+	bool Isolate::loadCompiled(std::string_view image, uint64_t hash, uint64_t sourceLength) {
+		std::vector<Stmt<void, Value>*> statements;
+		Arena arena;
+		if (!ScriptCache::deserialise(image.data(), image.size(), hash, sourceLength, statements, arena))
+			return false;
+
+		runtime.hadError = false;
+		AbstractSyntaxTree<void, Value>& tree = trees.emplace_back(statements, std::move(arena));
+		interpreter.interpret(declarationsOf(tree.statements));
+		return !runtime.hadError;
+	}
+
+	void Isolate::enableJobs(unsigned threadCount) {
+		jobs = std::make_unique<JobSystem>(threadCount);
+		jobs->addBindings(&interpreter);
+	}
+
+	Isolate::Isolate(const std::string& cacheDirectory) :
+		interpreter(&runtime, stl::getEnvironment())
+	{
+		if (!cacheDirectory.empty())
+			cache = std::make_unique<ScriptCache>(cacheDirectory, &interpreter);
+	}
+
+	Isolate::~Isolate() = default;
+
+	AbstractSyntaxTree<void, Value> Isolate::compile(std::string_view source) {
+		if (cache != nullptr)
+			return cache->load(source);
+
+		Scanner scanner(source, &runtime);
+		Parser<void, Value> parser(scanner.scanTokens(), &runtime);
+		AbstractSyntaxTree<void, Value> tree = parser.parse();
+		//The parser leaves null statements where it hit a syntax error, which the resolver can't walk
+		if (runtime.hadError)
+			return tree;
+
+		Resolver resolver(&interpreter);
+		resolver.sweepStatements(tree.statements);
+		if (!runtime.hadError) {
+			Optimiser optimiser(&interpreter);
+			optimiser.optimise(tree);
+		}
+		return tree;
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "PittaRuntime.hpp"
+#include "PittaInterpreter.hpp"
+#include "PittaScriptCache.hpp"
+#include "PittaVM.hpp"
+#include <memory>
+#include <string_view>
+#include <deque>
+
+//How many threads a job system runs tasks on when it isn't told. 0 uses one for each core
+#ifndef PITTA_JOB_THREADS
+#define PITTA_JOB_THREADS 0
+#endif
+
+namespace pitta {
+
+	class JobSystem;
+
+	//A script context that shares nothing that changes with any other, so isolates can run on separate threads at the
+	//same time. Each owns its runtime, heap, globals and the trees it runs. Running a tree writes into it, filling its
+	//access sites' caches and specialising its operators, so trees are never shared between isolates; a script cache
+	//directory is how they share the work of compiling.
+	//What every isolate does share never changes once made: the standard natives and the classes bound from C++, which
+	//no heap marks, and the table of identifiers and literals, which is only written to while compiling. Strings made
+	//at runtime live in the isolate's own heap, so running a script takes no lock. One isolate must only be used by
+	//one thread at a time
+	class Isolate {
+	public:
+		Runtime runtime;
+		Interpreter interpreter;
+
+		//Compiles the source and runs it on the chosen engine. Returns false if there was an error, which has been
+		//reported to the runtime as usual. Either engine runs any script the other does: the tree walker recurses on
+		//the native stack, and the vm allows PITTA_VM_MAX_FRAMES calls, which is deeper than that goes on a default
+		//sized thread
+		bool run(std::string_view source, bool useVM = false);
+		//Compiles the source and defines its functions and classes, without running anything else in it
+		bool load(std::string_view source);
+		//Defines the functions and classes in a tree serialised by ScriptCache::serialise, for a source with this hash
+		//and length. Returns false if the image can't be read, in which case nothing was defined
+		bool loadCompiled(std::string_view image, uint64_t hash, uint64_t sourceLength);
+
+		//Lets scripts this isolate runs from now on spawn tasks, on a job system of its own
+		void enableJobs(unsigned threadCount = PITTA_JOB_THREADS);
+
+		//Scripts are compiled through the cache if a directory is given, which several isolates can share
+		Isolate(const std::string& cacheDirectory = "");
+		Isolate(const Isolate&) = delete;
+		~Isolate();
+
+	private:
+		//Functions point into the tree and code they were made from, so both live as long as the isolate
+		std::deque<AbstractSyntaxTree<void, Value>> trees;
+		std::unique_ptr<ScriptCache> cache;
+		std::unique_ptr<VM> vm;
+		//Stopped first, so no task is still running when the rest goes
+		std::unique_ptr<JobSystem> jobs;
+
+		AbstractSyntaxTree<void, Value> compile(std::string_view source);
+	};
+}
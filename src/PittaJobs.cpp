@@ -0,0 +1,497 @@
+#include "PittaJobs.hpp"
+#include "PittaIntegration.hpp"
+#include "PittaArray.hpp"
+#include "PittaMap.hpp"
+#include <algorithm>
+
+namespace pitta {
+
+	//What a script holds on to for a task it spawned
+	struct TaskHandle {
+		std::shared_ptr<Task> task;
+	};
+
+	static TaskHandle* newTaskHandle(Interpreter*, Arguments) {
+		throw new PittaRuntimeException("Tasks can only be made by spawn.");
+	}
+
+	static IntegratedClass<TaskHandle>* taskClass = Heap::permanent(new IntegratedClass<TaskHandle>(
+		"Task", std::unordered_map<std::string, Callable*>(), 0, newTaskHandle, std::vector<NativeField>()
+		));
+
+	static JobSystem& jobSystemOf(Interpreter* interpreter) {
+		JobSystem* jobSystem = interpreter->getJobSystem();
+		if (jobSystem == nullptr)
+			throw new PittaRuntimeException("This script has no job system to run tasks on.");
+		return *jobSystem;
+	}
+
+	//Workers only have the functions declared at the top level of a script, so a task can't run a closure or a method
+	static Symbol taskFunction(Interpreter* interpreter, const Value& function, size_t argumentCount) {
+		if (function.getType() != Function)
+			throw new PittaRuntimeException("A task has to be given a function to run.");
+		const Callable* callable = function.asCallable();
+		const Symbol name(callable->getName());
+
+		bool isDeclared = false;
+		try {
+			const Value declared = interpreter->getGlobals()->get(name);
+			isDeclared = declared.getType() == Function && declared.asCallable() == callable;
+		}
+		catch (PittaRuntimeException* exception) {
+			delete exception;
+		}
+		if (!isDeclared)
+			throw new PittaRuntimeException("'" + name.str() + "' can't be run as a task, only functions declared at the top level of a script can.");
+
+		if (!callable->acceptsArgumentCount(int(argumentCount))) {
+			throw new PittaRuntimeException("Incorrect number of arguments in call to '" + name.str() + "'. Passed in "
+				+ std::to_string(argumentCount) + ", expected " + std::to_string(callable->getArity()) + ".");
+		}
+		return name;
+	}
+
+	//Copies the arguments from the first onwards out of the calling isolate
+	static std::vector<SentValue> sendArguments(Arguments arguments, size_t first) {
+		std::vector<SentValue> sent;
+		sent.reserve(arguments.size() - first);
+		for (size_t i = first; i < arguments.size(); i++)
+			sent.emplace_back(arguments[i]);
+		return sent;
+	}
+
+	static Value spawnTask(Interpreter* interpreter, Arguments arguments) {
+		if (arguments.empty())
+			throw new PittaRuntimeException("A task has to be given a function to run.");
+		const Symbol function = taskFunction(interpreter, arguments[0], arguments.size() - 1);
+
+		std::shared_ptr<Task> task = jobSystemOf(interpreter).spawn(function, sendArguments(arguments, 1));
+		return taskClass->createPittaInstance(new TaskHandle{ std::move(task) }, interpreter);
+	}
+
+	static Value joinTask(Interpreter* interpreter, Arguments arguments) {
+		const Value& handle = arguments[0];
+		if (handle.getType() != ClassInstance || handle.asInstance()->getDefinition() != taskClass)
+			throw new PittaRuntimeException("Only tasks made by spawn can be joined.");
+		return jobSystemOf(interpreter).join(*IntegratedClass<TaskHandle>::unpack(handle)->task, interpreter->getHeap());
+	}
+
+	//parallel_for(start, end, function, arguments...) calls function(i, arguments...) for each i in [start, end) and
+	//returns an array of the results. The arguments are copied once for each worker that runs part of the range
+	static Value parallelFor(Interpreter* interpreter, Arguments arguments) {
+		if (arguments.size() < 3)
+			throw new PittaRuntimeException("A parallel_for has to be given a range and a function to run.");
+		if (arguments[0].getType() != Int || arguments[1].getType() != Int)
+			throw new PittaRuntimeException("The range of a parallel_for has to be given as ints.");
+		const Symbol function = taskFunction(interpreter, arguments[2], arguments.size() - 2);
+		return jobSystemOf(interpreter).parallelFor(function, arguments[0].asInt(), arguments[1].asInt(),
+			sendArguments(arguments, 3), interpreter->getHeap());
+	}
+
+	static const NativeCallable* const spawnCallable = Heap::permanent(new NativeCallable(Callable::c_variadic, "spawn", spawnTask));
+	static const NativeCallable* const joinCallable = Heap::permanent(new NativeCallable(1, "join", joinTask));
+	static const NativeCallable* const parallelForCallable = Heap::permanent(new NativeCallable(Callable::c_variadic, "parallel_for", parallelFor));
+
+
+
+	SentValue::SentValue(const Value& value) {
+		std::vector<const void*> containing;
+		*this = SentValue(value, containing);
+	}
+
+	SentValue::SentValue(const Value& value, std::vector<const void*>& containing) :
+		type(value.getType())
+	{
+		switch (type) {
+		case Int:
+			primitive = value.intValue();
+			break;
+		case Float:
+			primitive = value.floatValue();
+			break;
+		case Bool:
+			primitive = value.asBool();
+			break;
+		case Null:
+		case Undefined:
+			primitive = value.getType();
+			break;
+		case String:
+			text = value.asString();
+			break;
+		case Array: {
+			const ArrayObject* array = value.asArray();
+			const size_t size = array->size();
+			switch (array->getStorage()) {
+			case ArrayObject::Storage::Ints:
+				ints.reserve(size);
+				for (size_t i = 0; i < size; i++)
+					ints.emplace_back(array->get(i).intValue());
+				break;
+			case ArrayObject::Storage::Floats:
+				floats.reserve(size);
+				for (size_t i = 0; i < size; i++)
+					floats.emplace_back(array->get(i).floatValue());
+				break;
+			default:
+				if (std::find(containing.begin(), containing.end(), array) != containing.end())
+					throw new PittaRuntimeException("An array that contains itself can't be passed to or returned from a task.");
+				containing.emplace_back(array);
+				values.reserve(size);
+				for (size_t i = 0; i < size; i++)
+					values.emplace_back(SentValue(array->get(i), containing));
+				containing.pop_back();
+			}
+			break;
+		}
+		case Map: {
+			const MapObject* map = value.asMap();
+			if (std::find(containing.begin(), containing.end(), map) != containing.end())
+				throw new PittaRuntimeException("A map that contains itself can't be passed to or returned from a task.");
+			containing.emplace_back(map);
+			values.reserve(map->size() * 2);
+			map->forEach([this, &containing](const MapObject::Entry& entry) {
+				values.emplace_back(SentValue(entry.key, containing));
+				values.emplace_back(SentValue(entry.value, containing));
+			});
+			containing.pop_back();
+			break;
+		}
+		default:
+			throw new PittaRuntimeException("Only numbers, booleans, strings, null, and arrays and maps of them can be passed to or returned from a task, not "
+				+ c_typeToString.at(type) + ".");
+		}
+	}
+
+	Value SentValue::receive(Heap& heap)const {
+		switch (type) {
+		case String:
+			return heap.makeString(text);
+		case Array: {
+			//Nothing here reaches a safe point, so the array needs no rooting while it is filled
+			ArrayObject* array = heap.track(new ArrayObject());
+			array->reserve(ints.size() + floats.size() + values.size());
+			for (int element : ints)
+				array->push(element);
+			for (float element : floats)
+				array->push(element);
+			for (const SentValue& element : values)
+				array->push(element.receive(heap));
+			return array;
+		}
+		case Map: {
+			MapObject* map = heap.track(new MapObject());
+			for (size_t i = 0; i < values.size(); i += 2)
+				map->set(values[i].receive(heap), values[i + 1].receive(heap));
+			return map;
+		}
+		default:
+			return primitive;
+		}
+	}
+
+
+
+	bool Task::isDone()const {
+		return done.load(std::memory_order_acquire);
+	}
+
+	Task::Task(Symbol function, std::shared_ptr<const std::vector<SentValue>> arguments) :
+		function(function),
+		arguments(std::move(arguments)),
+		isRange(false),
+		start(0),
+		end(0)
+	{}
+
+	Task::Task(Symbol function, int start, int end, std::shared_ptr<const std::vector<SentValue>> arguments) :
+		function(function),
+		arguments(std::move(arguments)),
+		isRange(true),
+		start(start),
+		end(end)
+	{}
+
+
+
+	struct JobSystem::Worker {
+		JobSystem* jobSystem;
+		size_t index;
+		Isolate isolate;
+		//How many of the job system's scripts the isolate has loaded so far
+		size_t scriptsLoaded = 0;
+
+		std::mutex mutex;
+		std::deque<std::shared_ptr<Task>> tasks;
+		std::thread thread;
+
+		Worker(JobSystem* jobSystem, size_t index) :
+			jobSystem(jobSystem),
+			index(index)
+		{}
+	};
+
+	thread_local JobSystem::Worker* JobSystem::t_currentWorker = nullptr;
+
+	void JobSystem::addScript(std::string_view source, const std::vector<Stmt<void, Value>*>& declarations) {
+		const uint64_t hash = ScriptCache::hashSource(source);
+		std::shared_ptr<const Script> script = std::make_shared<const Script>(Script{
+			std::string(source), ScriptCache::serialise(declarations, hash, source.size()), hash });
+
+		std::lock_guard<std::mutex> lock(scriptMutex);
+		scripts.emplace_back(std::move(script));
+	}
+
+	std::shared_ptr<Task> JobSystem::spawn(Symbol function, std::vector<SentValue>&& arguments) {
+		std::shared_ptr<Task> task = std::make_shared<Task>(function, std::make_shared<const std::vector<SentValue>>(std::move(arguments)));
+		push(task);
+		return task;
+	}
+
+	Value JobSystem::join(Task& task, Heap& heap) {
+		Worker* worker = currentWorker();
+		if (worker != nullptr) {
+			while (!task.isDone()) {
+				std::shared_ptr<Task> other = take(*worker);
+				if (other != nullptr) {
+					run(*worker, *other);
+					continue;
+				}
+				//The task is running on another worker. Sleep until it finishes, or until there is something else to run
+				std::unique_lock<std::mutex> lock(sleepMutex);
+				wake.wait(lock, [this, &task]() { return task.isDone() || queued.load() > 0; });
+			}
+		}
+		else {
+			std::unique_lock<std::mutex> lock(task.mutex);
+			task.finished.wait(lock, [&task]() { return task.isDone(); });
+		}
+
+		if (!task.error.empty())
+			throw new PittaRuntimeException("Task '" + task.function.str() + "' failed: " + task.error);
+		return task.result.receive(heap);
+	}
+
+	Value JobSystem::parallelFor(Symbol function, int start, int end, std::vector<SentValue>&& arguments, Heap& heap) {
+		if (end <= start)
+			return heap.track(new ArrayObject());
+
+		//A few slices for each worker, so one that finishes early has something to steal
+		const int64_t count = int64_t(end) - start;
+		const int64_t sliceCount = std::min<int64_t>(count, int64_t(workers.size()) * 4);
+		const std::shared_ptr<const std::vector<SentValue>> sharedArguments = std::make_shared<const std::vector<SentValue>>(std::move(arguments));
+		std::vector<std::shared_ptr<Task>> slices;
+		slices.reserve(size_t(sliceCount));
+		for (int64_t i = 0; i < sliceCount; i++) {
+			const int sliceStart = int(start + count * i / sliceCount);
+			const int sliceEnd = int(start + count * (i + 1) / sliceCount);
+			slices.emplace_back(std::make_shared<Task>(function, sliceStart, sliceEnd, sharedArguments));
+			push(slices.back());
+		}
+
+		//Every slice has finished before any failure is reported, so none is still running once this returns
+		PittaRuntimeException* failure = nullptr;
+		for (const std::shared_ptr<Task>& slice : slices) {
+			try {
+				join(*slice, heap);
+			}
+			catch (PittaRuntimeException* exception) {
+				if (failure == nullptr)
+					failure = exception;
+				else
+					delete exception;
+			}
+		}
+		if (failure != nullptr)
+			throw failure;
+
+		//Joining runs other tasks in this heap, which can collect, so the results array is only made once they are all done
+		ArrayObject* results = heap.track(new ArrayObject());
+		results->reserve(size_t(count));
+		for (const std::shared_ptr<Task>& slice : slices) {
+			for (const SentValue& result : slice->results)
+				results->push(result.receive(heap));
+		}
+		return results;
+	}
+
+	unsigned JobSystem::getThreadCount()const {
+		return unsigned(workers.size());
+	}
+
+	void JobSystem::addBindings(Interpreter* interpreter) {
+		interpreter->setJobSystem(this);
+		Environment* globals = interpreter->getGlobals();
+		globals->define("spawn", spawnCallable);
+		globals->define("join", joinCallable);
+		globals->define("parallel_for", parallelForCallable);
+	}
+
+	JobSystem::JobSystem(unsigned threadCount) {
+		if (threadCount == 0)
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+		//Every worker exists before any starts, since each can steal from all the others
+		for (size_t i = 0; i < threadCount; i++) {
+			workers.emplace_back(std::make_unique<Worker>(this, i));
+			addBindings(&workers.back()->isolate.interpreter);
+		}
+		for (std::unique_ptr<Worker>& worker : workers)
+			worker->thread = std::thread(&JobSystem::work, this, std::ref(*worker));
+	}
+
+	JobSystem::~JobSystem() {
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::unique_ptr<Worker>& worker : workers)
+			worker->thread.join();
+	}
+
+	JobSystem::Worker* JobSystem::currentWorker()const {
+		if (t_currentWorker != nullptr && t_currentWorker->jobSystem == this)
+			return t_currentWorker;
+		return nullptr;
+	}
+
+	void JobSystem::push(std::shared_ptr<Task> task) {
+		//A worker keeps what it spawns, where it will run it next unless someone steals it first
+		Worker* worker = currentWorker();
+		if (worker == nullptr)
+			worker = workers[nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size()].get();
+
+		//Counted before it can be taken, so the count never drops below zero
+		queued.fetch_add(1);
+		{
+			std::lock_guard<std::mutex> lock(worker->mutex);
+			worker->tasks.emplace_back(std::move(task));
+		}
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		wake.notify_one();
+	}
+
+	std::shared_ptr<Task> JobSystem::take(Worker& worker) {
+		{
+			std::lock_guard<std::mutex> lock(worker.mutex);
+			if (!worker.tasks.empty()) {
+				std::shared_ptr<Task> task = std::move(worker.tasks.back());
+				worker.tasks.pop_back();
+				queued.fetch_sub(1);
+				return task;
+			}
+		}
+
+		//The oldest task in another queue is the one its owner is furthest from needing
+		for (size_t i = 1; i < workers.size(); i++) {
+			Worker& victim = *workers[(worker.index + i) % workers.size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.tasks.empty()) {
+				std::shared_ptr<Task> task = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				queued.fetch_sub(1);
+				return task;
+			}
+		}
+		return nullptr;
+	}
+
+	//The arguments a worker passes to a task's function. A task joining another can run more tasks inside its own call,
+	//so each one roots its arguments itself
+	class TaskArguments : public std::vector<Value>, public GCRoots {
+	public:
+		explicit TaskArguments(Heap& heap) :
+			heap(heap)
+		{
+			heap.addRootSource(this);
+		}
+		TaskArguments(const TaskArguments&) = delete;
+		~TaskArguments() {
+			heap.removeRootSource(this);
+		}
+
+		void markRoots(Heap& heap) override {
+			for (const Value& value : *this)
+				heap.mark(value);
+		}
+
+	private:
+		Heap& heap;
+	};
+
+	void JobSystem::run(Worker& worker, Task& task) {
+		loadScripts(worker);
+		Interpreter& interpreter = worker.isolate.interpreter;
+		try {
+			const Value function = interpreter.getGlobals()->get(task.function);
+			if (function.getType() != Function)
+				throw new PittaRuntimeException("'" + task.function.str() + "' is not a function.");
+
+			//Made again in this isolate's heap, and rooted for as long as the task runs, since a range calls the function
+			//with them again after each call is done with them
+			TaskArguments arguments(interpreter.getHeap());
+			arguments.reserve(task.arguments->size() + 1);
+			if (task.isRange)
+				arguments.emplace_back(task.start);
+			for (const SentValue& argument : *task.arguments)
+				arguments.emplace_back(argument.receive(interpreter.getHeap()));
+
+			if (task.isRange) {
+				task.results.reserve(size_t(task.end - task.start));
+				for (int i = task.start; i < task.end; i++) {
+					arguments[0] = i;
+					task.results.emplace_back(interpreter.call(function.asCallable(), Arguments(arguments)));
+				}
+			}
+			else
+				task.result = SentValue(interpreter.call(function.asCallable(), Arguments(arguments)));
+		}
+		catch (PittaRuntimeException* exception) {
+			task.error = exception->details;
+			delete exception;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(task.mutex);
+			task.done.store(true, std::memory_order_release);
+		}
+		task.finished.notify_all();
+		//Workers joining it sleep with the others
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		wake.notify_all();
+	}
+
+	void JobSystem::loadScripts(Worker& worker) {
+		std::vector<std::shared_ptr<const Script>> newScripts;
+		{
+			std::lock_guard<std::mutex> lock(scriptMutex);
+			newScripts.assign(scripts.begin() + worker.scriptsLoaded, scripts.end());
+		}
+		for (const std::shared_ptr<const Script>& script : newScripts) {
+			if (script->image.empty() || !worker.isolate.loadCompiled(script->image, script->hash, script->source.size()))
+				worker.isolate.load(script->source);
+			worker.scriptsLoaded += 1;
+		}
+	}
+
+	void JobSystem::work(Worker& worker) {
+		t_currentWorker = &worker;
+		while (true) {
+			std::shared_ptr<Task> task = take(worker);
+			if (task != nullptr) {
+				run(worker, *task);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			wake.wait(lock, [this]() { return stopping || queued.load() > 0; });
+			if (stopping && queued.load() == 0)
+				return;
+		}
+	}
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include "PittaIsolate.hpp"
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <memory>
+#include <vector>
+#include <string>
+
+namespace pitta {
+
+	//A value copied out of one isolate, so it can be made again in another. Arrays and maps are copied along with
+	//everything in them, and arrays of unboxed numbers stay unboxed. Instances, functions and classes only mean
+	//something in the isolate that made them, so they can't be sent
+	class SentValue {
+	public:
+		//Throws for anything that can't be sent, including an array or map that contains itself
+		explicit SentValue(const Value& value);
+		SentValue() = default;
+
+		//A copy in the heap, owned by whichever isolate the heap belongs to
+		Value receive(Heap& heap)const;
+
+	private:
+		Type type = Undefined;
+		//The number, bool or null itself
+		Value primitive;
+		std::string text;
+		std::vector<int> ints;
+		std::vector<float> floats;
+		//The elements of a boxed array, or a map's keys and values in turn
+		std::vector<SentValue> values;
+
+		SentValue(const Value& value, std::vector<const void*>& containing);
+	};
+
+	//A call to one of the scripts' top level functions, run by one of a job system's workers
+	class Task {
+	public:
+		const Symbol function;
+		//Shared by every slice of a parallel_for, and made again in the isolate of each worker that runs one
+		const std::shared_ptr<const std::vector<SentValue>> arguments;
+		//A slice of a parallel_for calls the function once with each number in [start, end), followed by the arguments
+		const bool isRange;
+		const int start;
+		const int end;
+
+		bool isDone()const;
+
+		Task(Symbol function, std::shared_ptr<const std::vector<SentValue>> arguments);
+		Task(Symbol function, int start, int end, std::shared_ptr<const std::vector<SentValue>> arguments);
+		Task(const Task&) = delete;
+
+	private:
+		friend class JobSystem;
+
+		std::atomic<bool> done{ false };
+		SentValue result;
+		//What a slice returned for each of its numbers, in order
+		std::vector<SentValue> results;
+		//What went wrong, if the task failed
+		std::string error;
+		//Only for threads that wait without running tasks of their own
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+
+	//Runs tasks spawned by scripts on a pool of worker threads. Each worker has an isolate of its own, which loads the
+	//functions and classes of every script the job system is given, but none of their variables. A task calls one of
+	//those functions in the worker's isolate, in a new environment under its globals, so tasks share nothing with the
+	//script that spawned them except the values passed in and returned, which are copied each way.
+	//Each worker takes the newest task from its own queue and, when that is empty, steals the oldest from another's.
+	//A worker waiting on a task runs others until it is done, and sleeps when there are none to run, so tasks can
+	//spawn and join tasks of their own
+	class JobSystem {
+	public:
+		//Makes the functions and classes among the statements available to tasks. They are serialised once, before the
+		//script runs, so workers rebuild them without compiling the source again
+		void addScript(std::string_view source, const std::vector<Stmt<void, Value>*>& declarations);
+
+		std::shared_ptr<Task> spawn(Symbol function, std::vector<SentValue>&& arguments);
+		//Waits for the task and returns what it returned, made in the heap. If it failed, the error is thrown here instead
+		Value join(Task& task, Heap& heap);
+		//Calls the function with every number in [start, end) and the arguments, spread over the workers, and waits
+		//for all of them. Returns an array, made in the heap, of what each call returned in order
+		Value parallelFor(Symbol function, int start, int end, std::vector<SentValue>&& arguments, Heap& heap);
+
+		unsigned getThreadCount()const;
+
+		//Defines spawn, join and parallel_for for scripts the interpreter runs, running their tasks here
+		void addBindings(Interpreter* interpreter);
+
+		JobSystem(unsigned threadCount = PITTA_JOB_THREADS);
+		JobSystem(const JobSystem&) = delete;
+		~JobSystem();
+
+	private:
+		struct Worker;
+
+		//Set on each worker's own thread
+		static thread_local Worker* t_currentWorker;
+
+		std::vector<std::unique_ptr<Worker>> workers;
+		//Where tasks spawned from outside the workers go next
+		std::atomic<size_t> nextWorker{ 0 };
+		//Tasks sitting in a queue that no worker has taken yet
+		std::atomic<size_t> queued{ 0 };
+		std::mutex sleepMutex;
+		std::condition_variable wake;
+		bool stopping = false;
+
+		struct Script {
+			std::string source;
+			//The serialised declarations, or empty if they couldn't be serialised and have to be compiled from the source
+			std::string image;
+			uint64_t hash;
+		};
+		std::mutex scriptMutex;
+		std::vector<std::shared_ptr<const Script>> scripts;
+
+		Worker* currentWorker()const;
+		void push(std::shared_ptr<Task> task);
+		std::shared_ptr<Task> take(Worker& worker);
+		void run(Worker& worker, Task& task);
+		void loadScripts(Worker& worker);
+		void work(Worker& worker);
+	};
+}
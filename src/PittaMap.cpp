@@ -0,0 +1,201 @@
+#include "PittaMap.hpp"
+#include <string.h>
+#include <string_view>
+
+namespace pitta {
+
+	//Spreads the bits of a key about, so keys that differ only in their low bits don't all probe the same slots
+	static uint64_t mixBits(uint64_t bits) {
+		bits ^= bits >> 33;
+		bits *= 0xff51afd7ed558ccdULL;
+		bits ^= bits >> 33;
+		return bits;
+	}
+
+	//0 and -0 are the same key
+	static uint32_t floatBits(float value) {
+		if (value == 0.0f)
+			value = 0.0f;
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	//The address a key is identified by, for anything that lives in a heap other than a string
+	static const void* keyAddress(const Value& key) {
+		switch (key.getType()) {
+		case ClassInstance:
+			return key.asInstance();
+		case Array:
+			return key.asArray();
+		case Map:
+			return key.asMap();
+		default:
+			return key.asCallable();
+		}
+	}
+
+	size_t MapObject::size()const {
+		return count;
+	}
+	bool MapObject::empty()const {
+		return count == 0;
+	}
+
+	Value MapObject::get(const Value& key)const {
+		checkKey(key);
+		if (count == 0)
+			return Undefined;
+		const uint32_t entry = slots[findSlot(key, hash(key))];
+		return entry < c_removedSlot ? entries[entry].value : Value(Undefined);
+	}
+
+	void MapObject::set(const Value& key, const Value& value) {
+		checkKey(key);
+		const uint64_t keyHash = hash(key);
+		if (!slots.empty()) {
+			const uint32_t entry = slots[findSlot(key, keyHash)];
+			if (entry < c_removedSlot) {
+				entries[entry].value = value;
+				return;
+			}
+		}
+
+		//Every entry, even a removed one, may be holding a slot, so that is what the load is measured by
+		if ((entries.size() + 1) * 4 > slots.size() * 3) {
+			size_t slotCount = PITTA_MAP_MIN_SLOTS;
+			while (slotCount < (count + 1) * 2)
+				slotCount *= 2;
+			rebuild(slotCount);
+		}
+
+		slots[findSlot(key, keyHash)] = uint32_t(entries.size());
+		entries.push_back(Entry{ key, value });
+		count += 1;
+	}
+
+	bool MapObject::contains(const Value& key)const {
+		checkKey(key);
+		return count > 0 && slots[findSlot(key, hash(key))] < c_removedSlot;
+	}
+
+	bool MapObject::remove(const Value& key) {
+		checkKey(key);
+		if (count == 0)
+			return false;
+		const size_t slot = findSlot(key, hash(key));
+		const uint32_t entry = slots[slot];
+		if (entry >= c_removedSlot)
+			return false;
+
+		slots[slot] = c_removedSlot;
+		entries[entry] = Entry{ Undefined, Undefined };
+		count -= 1;
+		return true;
+	}
+
+	std::string MapObject::asString()const {
+		if (printing)
+			return "{...}";
+		printing = true;
+
+		std::string result = "{";
+		try {
+			forEach([&result](const Entry& entry) {
+				if (result.size() > 1)
+					result += ", ";
+				result += entry.key.toString() + ": " + entry.value.toString();
+			});
+		}
+		catch (...) {
+			printing = false;
+			throw;
+		}
+		printing = false;
+		return result + "}";
+	}
+
+	void MapObject::trace(Heap& heap)const {
+		forEach([&heap](const Entry& entry) {
+			heap.mark(entry.key);
+			heap.mark(entry.value);
+		});
+	}
+
+	uint64_t MapObject::hash(const Value& key) {
+		uint64_t bits;
+		switch (key.getType()) {
+		case Int:
+			bits = uint32_t(key.intValue());
+			break;
+		case Float:
+			bits = floatBits(key.floatValue());
+			break;
+		case Bool:
+			bits = key.asBool();
+			break;
+		case String:
+			bits = std::hash<std::string_view>()(key.asString());
+			break;
+		default:
+			bits = uint64_t(uintptr_t(keyAddress(key)));
+		}
+		return mixBits(bits ^ (uint64_t(key.getType()) << 56));
+	}
+
+	bool MapObject::sameKey(const Value& left, const Value& right) {
+		if (left.getType() != right.getType())
+			return false;
+		switch (left.getType()) {
+		case Int:
+			return left.intValue() == right.intValue();
+		case Float:
+			return floatBits(left.floatValue()) == floatBits(right.floatValue());
+		case Bool:
+			return left.asBool() == right.asBool();
+		case String:
+			return left == right;
+		default:
+			return keyAddress(left) == keyAddress(right);
+		}
+	}
+
+	const Value& MapObject::checkKey(const Value& key) {
+		if (key.getType() == Null || key.getType() == Undefined)
+			throw new PittaRuntimeException("Maps can't use " + c_typeToString.at(key.getType()) + " as a key.");
+		return key;
+	}
+
+	size_t MapObject::findSlot(const Value& key, uint64_t keyHash)const {
+		const size_t mask = slots.size() - 1;
+		size_t slot = size_t(keyHash) & mask;
+		size_t firstRemoved = SIZE_MAX;
+		//The load is kept below three quarters, so there is always an empty slot to stop at
+		while (true) {
+			const uint32_t entry = slots[slot];
+			if (entry == c_emptySlot)
+				return firstRemoved != SIZE_MAX ? firstRemoved : slot;
+			if (entry == c_removedSlot) {
+				if (firstRemoved == SIZE_MAX)
+					firstRemoved = slot;
+			}
+			else if (sameKey(entries[entry].key, key))
+				return slot;
+			slot = (slot + 1) & mask;
+		}
+	}
+
+	void MapObject::rebuild(size_t slotCount) {
+		size_t live = 0;
+		for (Entry& entry : entries) {
+			if (entry.key.getType() != Undefined)
+				entries[live++] = entry;
+		}
+		entries.resize(live);
+
+		slots.assign(slotCount, c_emptySlot);
+		for (size_t i = 0; i < entries.size(); i++)
+			slots[findSlot(entries[i].key, hash(entries[i].key))] = uint32_t(i);
+	}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "PittaValue.hpp"
+#include "PittaHeap.hpp"
+
+//How many slots the index of a new map starts with, which has to be a power of two
+#ifndef PITTA_MAP_MIN_SLOTS
+#define PITTA_MAP_MIN_SLOTS 8
+#endif
+
+namespace pitta {
+
+	//A hash map from values to values that remembers the order its keys were added in. The entries sit in one dense
+	//array, in that order, and are found through an open addressing index of entry numbers, probed linearly, so a
+	//lookup touches one small table and then a single entry.
+	//Keys are compared by what they hold rather than converted, so 1 and 1.0 are different keys. Strings are keys by
+	//their text, whether they were interned or made at runtime; arrays, maps and instances are keys by identity. Null and
+	//undefined can't be keys, and looking up a missing key gives undefined
+	class MapObject : public GCObject {
+	public:
+		struct Entry {
+			Value key;
+			Value value;
+		};
+
+		size_t size()const;
+		bool empty()const;
+
+		Value get(const Value& key)const;
+		//Neither the key nor the value can be bound, since the map could outlive what they are bound to
+		void set(const Value& key, const Value& value);
+		bool contains(const Value& key)const;
+		//Returns false if there was nothing to remove
+		bool remove(const Value& key);
+
+		//Every entry still in the map, in the order they were added
+		template<class Function>
+		void forEach(Function function)const {
+			for (const Entry& entry : entries) {
+				if (entry.key.getType() != Undefined)
+					function(entry);
+			}
+		}
+
+		std::string asString()const;
+
+		void trace(Heap& heap)const override;
+
+		MapObject() = default;
+		MapObject(const MapObject&) = delete;
+
+	private:
+		static constexpr uint32_t c_emptySlot = UINT32_MAX;
+		//Left where a removed key was, so probes for the keys after it keep going
+		static constexpr uint32_t c_removedSlot = UINT32_MAX - 1;
+
+		//Removed entries stay, with an undefined key, until the index is next rebuilt
+		std::vector<Entry> entries;
+		std::vector<uint32_t> slots;
+		size_t count = 0;
+		mutable bool printing = false;
+
+		static uint64_t hash(const Value& key);
+		static bool sameKey(const Value& left, const Value& right);
+		static const Value& checkKey(const Value& key);
+
+		//The slot holding the key, or the free slot it would go in
+		size_t findSlot(const Value& key, uint64_t keyHash)const;
+		//Resizes the index for the live entries, dropping removed ones
+		void rebuild(size_t slotCount);
+	};
+
+}
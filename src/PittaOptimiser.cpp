@@ -0,0 +1,309 @@
+#include "PittaOptimiser.hpp"
+#include <limits.h>
+#include <algorithm>
+
+namespace pitta {
+
+	void Optimiser::optimise(AbstractSyntaxTree<void, Value>& tree) {
+#if PITTA_OPTIMISE
+		arena = &tree.getArena();
+		optimise(tree.statements);
+		arena = nullptr;
+#endif
+	}
+
+	Optimiser::Optimiser(Interpreter* interpreter) :
+		interpreter(interpreter)
+	{}
+
+
+
+	Expr<Value>* Optimiser::fold(Expr<Value>* expr) {
+		folded = expr;
+		expr->accept(this);
+		return folded;
+	}
+
+	Stmt<void, Value>* Optimiser::optimise(Stmt<void, Value>* stmt) {
+		if (stmt == nullptr)
+			return nullptr;
+		replacement = stmt;
+		stmt->accept(this);
+		return replacement;
+	}
+
+	Stmt<void, Value>* Optimiser::optimiseRequired(Stmt<void, Value>* stmt) {
+		Stmt<void, Value>* optimised = optimise(stmt);
+		if (optimised != nullptr)
+			return optimised;
+		//Declares nothing, so it has no scope to make an environment for
+		return arena->make<Block<void, Value>>(std::vector<Stmt<void, Value>*>());
+	}
+
+	void Optimiser::optimise(std::vector<Stmt<void, Value>*>& statements) {
+		for (Stmt<void, Value>*& stmt : statements)
+			stmt = optimise(stmt);
+		statements.erase(std::remove(statements.begin(), statements.end(), nullptr), statements.end());
+	}
+
+	bool Optimiser::isLiteral(const Expr<Value>* expr) {
+		return expr->getType() == typeid(Literal<Value>);
+	}
+
+	const Value& Optimiser::literalValue(const Expr<Value>* expr) {
+		return static_cast<const Literal<Value>*>(expr)->value;
+	}
+
+	bool Optimiser::canFold(TokenType op, const Value& left, const Value& right) {
+		const bool numeric = (left.getType() == Int || left.getType() == Float) && (right.getType() == Int || right.getType() == Float);
+		const bool integers = left.getType() == Int && right.getType() == Int;
+
+		switch (op) {
+		case PLUS:
+		case MINUS:
+		case STAR:
+		case LESS:
+		case GREATER:
+		case LESS_EQUAL:
+		case GREATER_EQUAL:
+			return numeric;
+		case SLASH:
+			//Integer division by zero, or overflow, would bring the program down here instead of where it is run
+			if (numeric && left.getType() == Int)
+				return right.asInt() != 0 && !(left.asInt() == INT_MIN && right.asInt() == -1);
+			return numeric;
+		case PERCENT:
+			return integers && right.asInt() != 0 && !(left.asInt() == INT_MIN && right.asInt() == -1);
+		case BIT_AND:
+		case BIT_OR:
+		case BIT_XOR:
+			return integers;
+		case SHIFT_LEFT:
+		case SHIFT_RIGHT:
+			//Shifting by a negative count, or by the width of an int or more, is undefined
+			return integers && right.asInt() >= 0 && right.asInt() < 32;
+		case EQUAL_EQUAL:
+		case BANG_EQUAL:
+			return true;
+		case STRING_CONCAT:
+			return left.getType() == String && right.getType() == String;
+		default:
+			return false;
+		}
+	}
+
+	bool Optimiser::canFold(TokenType op, const Value& right) {
+		switch (op) {
+		case MINUS:
+			return right.getType() == Int || right.getType() == Float;
+		case BANG:
+			return true;
+		case BIT_NOT:
+			return right.getType() == Int;
+		default:
+			return false;
+		}
+	}
+
+
+
+	Value Optimiser::visitArrayLiteralExpr(ArrayLiteral<Value>* expr) {
+		//Never folded into a literal, since every evaluation has to make a new array
+		for (Expr<Value>*& element : expr->elements)
+			element = fold(element);
+		folded = expr;
+		return Value();
+	}
+
+	Value Optimiser::visitAssignExpr(Assign<Value>* expr) {
+		expr->value = fold(expr->value);
+		folded = expr;
+		return Value();
+	}
+
+	Value Optimiser::visitBinaryExpr(Binary<Value>* expr) {
+		expr->left = fold(expr->left);
+		expr->right = fold(expr->right);
+		folded = expr;
+		if (isLiteral(expr->left) && isLiteral(expr->right) && canFold(expr->op.type, literalValue(expr->left), literalValue(expr->right))) {
+			const Value result = interpreter->visitBinaryExpr(expr);
+			//A concatenation makes its string in the heap, but a literal has to outlive any collection, so it is interned
+			folded = arena->make<Literal<Value>>(result.getType() == String ? Value(result.asSymbol()) : result);
+		}
+		return Value();
+	}
+
+	Value Optimiser::visitCallExpr(Call<Value>* expr) {
+		//A method's object is folded through the callee, which is the same Get node
+		expr->callee = fold(expr->callee);
+		for (Expr<Value>*& argument : expr->arguments)
+			argument = fold(argument);
+		folded = expr;
+		return Value();
+	}
+
+	Value Optimiser::visitGetExpr(Get<Value>* expr) {
+		expr->object = fold(expr->object);
+		folded = expr;
+		return Value();
+	}
+
+	Value Optimiser::visitGetIndexExpr(GetIndex<Value>* expr) {
+		expr->object = fold(expr->object);
+		expr->index = fold(expr->index);
+		folded = expr;
+		return Value();
+	}
+
+	Value Optimiser::visitGroupingExpr(Grouping<Value>* expr) {
+		//Parentheses have already done their job by the time the tree is built
+		folded = fold(expr->expression);
+		return Value();
+	}
+
+	Value Optimiser::visitLiteralExpr(Literal<Value>* expr) {
+		folded = expr;
+		return Value();
+	}
+
+	Value Optimiser::visitLogicalExpr(Logical<Value>* expr) {
+		expr->left = fold(expr->left);
+		expr->right = fold(expr->right);
+		folded = expr;
+		if (isLiteral(expr->left)) {
+			//The result is the left operand if it decides the answer, otherwise whatever the right one gives
+			const bool leftDecides = expr->op.type == OR ? literalValue(expr->left).isTruthy() : !literalValue(expr->left).isTruthy();
+			folded = leftDecides ? expr->left : expr->right;
+		}
+		return Value();
+	}
+
+	Value Optimiser::visitMapLiteralExpr(MapLiteral<Value>* expr) {
+		for (size_t i = 0; i < expr->keys.size(); i++) {
+			expr->keys[i] = fold(expr->keys[i]);
+			expr->values[i] = fold(expr->values[i]);
+		}
+		folded = expr;
+		return Value();
+	}
+
+	Value Optimiser::visitSetExpr(Set<Value>* expr) {
+		expr->object = fold(expr->object);
+		expr->value = fold(expr->value);
+		folded = expr;
+		return Value();
+	}
+
+	Value Optimiser::visitSetIndexExpr(SetIndex<Value>* expr) {
+		expr->object = fold(expr->object);
+		expr->index = fold(expr->index);
+		expr->value = fold(expr->value);
+		folded = expr;
+		return Value();
+	}
+
+	Value Optimiser::visitSuperExpr(Super<Value>* expr) {
+		folded = expr;
+		return Value();
+	}
+
+	Value Optimiser::visitThisExpr(This<Value>* expr) {
+		folded = expr;
+		return Value();
+	}
+
+	Value Optimiser::visitUnaryExpr(Unary<Value>* expr) {
+		expr->right = fold(expr->right);
+		folded = expr;
+		if (isLiteral(expr->right) && canFold(expr->op.type, literalValue(expr->right)))
+			folded = arena->make<Literal<Value>>(interpreter->visitUnaryExpr(expr));
+		return Value();
+	}
+
+	Value Optimiser::visitVariableExpr(Variable<Value>* expr) {
+		folded = expr;
+		return Value();
+	}
+
+
+
+	void Optimiser::visitBlockStmt(Block<void, Value>* stmt) {
+		optimise(stmt->statements);
+		replacement = stmt;
+	}
+
+	void Optimiser::visitBreakStmt(Break<void, Value>* stmt) {
+		replacement = stmt;
+	}
+
+	void Optimiser::visitClassStmt(ClassStmt<void, Value>* stmt) {
+		for (FunctionStmt<void, Value>* method : stmt->methods)
+			optimise(method->body);
+		replacement = stmt;
+	}
+
+	void Optimiser::visitContinueStmt(Continue<void, Value>* stmt) {
+		replacement = stmt;
+	}
+
+	void Optimiser::visitExpressionStmt(Expression<void, Value>* stmt) {
+		stmt->expression = fold(stmt->expression);
+		replacement = stmt;
+	}
+
+	void Optimiser::visitForStmt(For<void, Value>* stmt) {
+		stmt->initializer = optimise(stmt->initializer);
+		if (stmt->condition != nullptr) {
+			stmt->condition = fold(stmt->condition);
+			//A condition that is always true doesn't need checking
+			if (isLiteral(stmt->condition) && literalValue(stmt->condition).isTruthy())
+				stmt->condition = nullptr;
+		}
+		if (stmt->increment != nullptr)
+			stmt->increment = fold(stmt->increment);
+		stmt->body = optimiseRequired(stmt->body);
+		replacement = stmt;
+	}
+
+	void Optimiser::visitFunctionStmt(FunctionStmt<void, Value>* stmt) {
+		optimise(stmt->body);
+		replacement = stmt;
+	}
+
+	void Optimiser::visitIfStmt(If<void, Value>* stmt) {
+		stmt->condition = fold(stmt->condition);
+		if (isLiteral(stmt->condition)) {
+			//Only the branch that would be taken is kept, in place of the whole if
+			Stmt<void, Value>* taken = literalValue(stmt->condition).isTruthy() ? stmt->thenBranch : stmt->elseBranch;
+			replacement = optimise(taken);
+			return;
+		}
+
+		stmt->thenBranch = optimiseRequired(stmt->thenBranch);
+		stmt->elseBranch = optimise(stmt->elseBranch);
+		replacement = stmt;
+	}
+
+	void Optimiser::visitPrintStmt(Print<void, Value>* stmt) {
+		stmt->expression = fold(stmt->expression);
+		replacement = stmt;
+	}
+
+	void Optimiser::visitReturnStmt(Return<void, Value>* stmt) {
+		if (stmt->value != nullptr)
+			stmt->value = fold(stmt->value);
+		replacement = stmt;
+	}
+
+	void Optimiser::visitVarStmt(Var<void, Value>* stmt) {
+		if (stmt->initializer != nullptr)
+			stmt->initializer = fold(stmt->initializer);
+		replacement = stmt;
+	}
+
+	void Optimiser::visitWhileStmt(While<void, Value>* stmt) {
+		stmt->condition = fold(stmt->condition);
+		stmt->body = optimiseRequired(stmt->body);
+		replacement = stmt;
+	}
+}
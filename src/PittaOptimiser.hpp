@@ -0,0 +1,73 @@
+#pragma once
+#include "PittaParser.hpp"
+#include "PittaInterpreter.hpp"
+
+//Set to 0 to run trees exactly as they were parsed, which is easier to follow when debugging the interpreter
+#ifndef PITTA_OPTIMISE
+#define PITTA_OPTIMISE 1
+#endif
+
+namespace pitta {
+
+	//Simplifies a tree the resolver has swept, before it runs on either engine. Operators whose operands are
+	//all literals are worked out once, groupings are removed, and branches of ifs that can never run are dropped.
+	//Nothing that could fail is folded, so every runtime error is still reported when and where it happens
+	class Optimiser : private StatementVisitor<void, Value>, private ExpressionVisitor<Value> {
+	public:
+
+		void optimise(AbstractSyntaxTree<void, Value>& tree);
+
+		Optimiser(Interpreter* interpreter);
+
+	private:
+		//Folding runs the interpreter's own operators, so a folded value is exactly what running it would give
+		Interpreter* interpreter;
+		Arena* arena = nullptr;
+
+		//What the expression or statement just visited became. A statement becomes nullptr when it is removed
+		Expr<Value>* folded = nullptr;
+		Stmt<void, Value>* replacement = nullptr;
+
+		Expr<Value>* fold(Expr<Value>* expr);
+		Stmt<void, Value>* optimise(Stmt<void, Value>* stmt);
+		//For places that have to hold a statement, such as the body of a loop
+		Stmt<void, Value>* optimiseRequired(Stmt<void, Value>* stmt);
+		void optimise(std::vector<Stmt<void, Value>*>& statements);
+
+		static bool isLiteral(const Expr<Value>* expr);
+		static const Value& literalValue(const Expr<Value>* expr);
+		//Whether the operator can be worked out for these operands without an error, or anything else happening
+		static bool canFold(TokenType op, const Value& left, const Value& right);
+		static bool canFold(TokenType op, const Value& right);
+
+		Value visitArrayLiteralExpr(ArrayLiteral<Value>* expr) override;
+		Value visitAssignExpr(Assign<Value>* expr) override;
+		Value visitBinaryExpr(Binary<Value>* expr) override;
+		Value visitCallExpr(Call<Value>* expr) override;
+		Value visitGetExpr(Get<Value>* expr) override;
+		Value visitGetIndexExpr(GetIndex<Value>* expr) override;
+		Value visitGroupingExpr(Grouping<Value>* expr) override;
+		Value visitLiteralExpr(Literal<Value>* expr) override;
+		Value visitLogicalExpr(Logical<Value>* expr) override;
+		Value visitMapLiteralExpr(MapLiteral<Value>* expr) override;
+		Value visitSetExpr(Set<Value>* expr) override;
+		Value visitSetIndexExpr(SetIndex<Value>* expr) override;
+		Value visitSuperExpr(Super<Value>* expr) override;
+		Value visitThisExpr(This<Value>* expr) override;
+		Value visitUnaryExpr(Unary<Value>* expr) override;
+		Value visitVariableExpr(Variable<Value>* expr) override;
+
+		void visitBlockStmt(Block<void, Value>* stmt) override;
+		void visitBreakStmt(Break<void, Value>* stmt) override;
+		void visitClassStmt(ClassStmt<void, Value>* stmt) override;
+		void visitContinueStmt(Continue<void, Value>* stmt) override;
+		void visitExpressionStmt(Expression<void, Value>* stmt) override;
+		void visitForStmt(For<void, Value>* stmt) override;
+		void visitFunctionStmt(FunctionStmt<void, Value>* stmt) override;
+		void visitIfStmt(If<void, Value>* stmt) override;
+		void visitPrintStmt(Print<void, Value>* stmt) override;
+		void visitReturnStmt(Return<void, Value>* stmt) override;
+		void visitVarStmt(Var<void, Value>* stmt) override;
+		void visitWhileStmt(While<void, Value>* stmt) override;
+	};
+}
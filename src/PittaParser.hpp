@@ -2,6 +2,7 @@
 #include <initializer_list>
 #include "PittaStatements.hpp"
 #include "PittaRuntime.hpp"
+#include "PittaArena.hpp"
 
 #ifndef PITTA_MAX_FUNC_PARAMS
 #define PITTA_MAX_FUNC_PARAMS 255
@@ -9,29 +10,27 @@
 
 namespace pitta {
 
+	//Every node of the tree lives in its arena, so the whole tree is freed in one go along with it
 	template<class T, class R>
 	class AbstractSyntaxTree {
 	public:
-		const std::vector<Stmt<T, R>*> statements;
+		//Passes that run after parsing, such as the optimiser, may replace statements
+		std::vector<Stmt<T, R>*> statements;
 
-		AbstractSyntaxTree(const std::vector<Stmt<T, R>*>& statements,
-				const std::vector<Stmt<T, R>*>& allStatementPointers, 
-				const std::vector<Expr<R>*>& allExpressionPointers):
+		const Arena& getArena()const {
+			return arena;
+		}
+		Arena& getArena() {
+			return arena;
+		}
+
+		AbstractSyntaxTree(const std::vector<Stmt<T, R>*>& statements, Arena&& arena):
 			statements(statements),
-			allStatementPointers(allStatementPointers),
-			allExpressionPointers(allExpressionPointers)
+			arena(std::move(arena))
 		{}
-		
-		~AbstractSyntaxTree() {
-			for (Stmt<T, R>* stmt : allStatementPointers)
-				delete stmt;
-			for (Expr<R>* expr : allExpressionPointers)
-				delete expr;
-		}
 
 	private:
-		std::vector<Stmt<T, R>*> allStatementPointers;
-		std::vector<Expr<R>*> allExpressionPointers;
+		Arena arena;
 	};
 
 	template<class T, class R>
@@ -39,13 +38,11 @@ namespace pitta {
 	public:
 
 		AbstractSyntaxTree<T, R> parse() {
-			allExpressions.clear();
-			allStatements.clear();
 			std::vector<Stmt<T, R>*> statements;
 			while (!isAtEnd())
 				statements.emplace_back(declaration());
 
-			return AbstractSyntaxTree<T, R>(statements, allStatements, allExpressions);
+			return AbstractSyntaxTree<T, R>(statements, std::move(arena));
 		}
 
 		Parser(const std::vector<Token>& tokens, Runtime* runtime) :
@@ -61,16 +58,12 @@ namespace pitta {
 		int current = 0;
 
 		Runtime* runtime;
-		std::vector<Expr<R>*> allExpressions;
-		std::vector<Stmt<T, R>*> allStatements;
+		//Where the nodes of the tree being parsed are made, handed over to the tree once parsing is done
+		Arena arena;
 
-		Expr<R>* track(Expr<R>* expr) {
-			allExpressions.emplace_back(expr);
-			return expr;
-		}
-		Stmt<T, R>* track(Stmt<T, R>* stmt) {
-			allStatements.emplace_back(stmt);
-			return stmt;
+		template<class Node, class... Args>
+		Node* make(Args&&... args) {
+			return arena.make<Node>(std::forward<Args>(args)...);
 		}
 
 
@@ -163,7 +156,7 @@ namespace pitta {
 			Token paren = consume(RIGHT_PAREN,
 				"Expect ')' after arguments.");
 
-			return new Call<R>(callee, paren, arguments);
+			return make<Call<R>>(callee, paren, arguments);
 		}
 
 
@@ -180,11 +173,15 @@ namespace pitta {
 
 				if (expr->getType() == typeid(Variable<R>)) {
 					Token name = ((Variable<R>*)expr)->name;
-					return track(new Assign<R>(name, value));
+					return make<Assign<R>>(name, value);
 				}
 				else if (expr->getType() == typeid(Get<R>)) {
 					Get<R>* get = (Get<R>*)expr;
-					return track(new Set<R>(get->object, get->name, value));
+					return make<Set<R>>(get->object, get->name, value);
+				}
+				else if (expr->getType() == typeid(GetIndex<R>)) {
+					GetIndex<R>* get = (GetIndex<R>*)expr;
+					return make<SetIndex<R>>(get->object, get->closingBracket, get->index, value);
 				}
 
 				error(equals, "Invalid assignment target.");
@@ -199,7 +196,7 @@ namespace pitta {
 			while (match(OR)) {
 				Token op = previous();
 				Expr<R>* right = andExpr();
-				expr = track(new Logical<R>(expr, op, right));
+				expr = make<Logical<R>>(expr, op, right);
 			}
 
 			return expr;
@@ -211,7 +208,7 @@ namespace pitta {
 			while (match(AND)) {
 				Token op = previous();
 				Expr<R>* right = equality();
-				expr = track(new Logical<R>(expr, op, right));
+				expr = make<Logical<R>>(expr, op, right);
 			}
 
 			return expr;
@@ -223,7 +220,7 @@ namespace pitta {
 			while (match({ BANG_EQUAL, EQUAL_EQUAL })) {
 				Token op = previous();
 				Expr<R>* right = comparison();
-				expr = track(new Binary<R>(expr, op, right));
+				expr = make<Binary<R>>(expr, op, right);
 			}
 
 			return expr;
@@ -235,7 +232,7 @@ namespace pitta {
 			while (match({ GREATER, GREATER_EQUAL, LESS, LESS_EQUAL })) {
 				Token op = previous();
 				Expr<R>* right = term();
-				expr = track(new Binary<R>(expr, op, right));
+				expr = make<Binary<R>>(expr, op, right);
 			}
 
 			return expr;
@@ -247,7 +244,7 @@ namespace pitta {
 			while (match({ MINUS, PLUS, PERCENT, BIT_AND, BIT_OR, STRING_CONCAT, SHIFT_LEFT, SHIFT_RIGHT })) {
 				Token op = previous();
 				Expr<R>* right = factor();
-				expr = track(new Binary<R>(expr, op, right));
+				expr = make<Binary<R>>(expr, op, right);
 			}
 
 			return expr;
@@ -259,7 +256,7 @@ namespace pitta {
 			while (match({ SLASH, STAR })) {
 				Token op = previous();
 				Expr<R>* right = unary();
-				expr = track(new Binary<R>(expr, op, right));
+				expr = make<Binary<R>>(expr, op, right);
 			}
 
 			return expr;
@@ -269,7 +266,7 @@ namespace pitta {
 			if (match({ BANG, MINUS })) {
 				Token op = previous();
 				Expr<R>* right = unary();
-				return track(new Unary<R>(op, right));
+				return make<Unary<R>>(op, right);
 			}
 
 			return call();
@@ -284,7 +281,12 @@ namespace pitta {
 				}
 				else if (match(DOT)) {
 					Token name = consume(IDENTIFIER, "Expect property name after '.'.");
-					expr = track(new Get<R>(expr, name));
+					expr = make<Get<R>>(expr, name);
+				}
+				else if (match(LEFT_BRACKET)) {
+					Expr<R>* index = expression();
+					Token bracket = consume(RIGHT_BRACKET, "Expect ']' after index.");
+					expr = make<GetIndex<R>>(expr, bracket, index);
 				}
 				else
 					break;
@@ -294,15 +296,15 @@ namespace pitta {
 		}
 
 		Expr<R>* primary() {
-			if (match(FALSE)) return track(new Literal<R>(false));
-			if (match(TRUE)) return track(new Literal<R>(true));
-			if (match(NIL)) return track(new Literal<R>(Null));
-			if (match(UNDEFINED)) return track(new Literal<R>(Undefined));
-			if (match(THIS))return track(new This<R>(previous()));
-			if (match(IDENTIFIER)) return track(new Variable<R>(previous()));
+			if (match(FALSE)) return make<Literal<R>>(false);
+			if (match(TRUE)) return make<Literal<R>>(true);
+			if (match(NIL)) return make<Literal<R>>(Null);
+			if (match(UNDEFINED)) return make<Literal<R>>(Undefined);
+			if (match(THIS))return make<This<R>>(previous());
+			if (match(IDENTIFIER)) return make<Variable<R>>(previous());
 
 			if (match({ INT, FLOAT, STRING })) {
-				return track(new Literal<R>(previous().getLiteralValue()));
+				return make<Literal<R>>(previous().getLiteralValue());
 			}
 
 			if (match(SUPER)) {
@@ -310,13 +312,39 @@ namespace pitta {
 				consume(DOT, "Expect '.' after 'super'.");
 				Token method = consume(IDENTIFIER,
 					"Expect superclass method name.");
-				return track(new Super<R>(keyword, method));
+				return make<Super<R>>(keyword, method);
 			}
 
 			if (match(LEFT_PAREN)) {
 				Expr<R>* expr = expression();
 				consume(RIGHT_PAREN, "Expect ')' after expression.");
-				return track(new Grouping<R>(expr));
+				return make<Grouping<R>>(expr);
+			}
+
+			if (match(LEFT_BRACKET)) {
+				std::vector<Expr<R>*> elements;
+				if (!check(RIGHT_BRACKET)) {
+					do {
+						elements.emplace_back(expression());
+					} while (match(COMMA));
+				}
+				Token bracket = consume(RIGHT_BRACKET, "Expect ']' after array elements.");
+				return make<ArrayLiteral<R>>(bracket, elements);
+			}
+
+			//Statements starting with a brace are blocks, so this is only reached from inside an expression
+			if (match(LEFT_BRACE)) {
+				std::vector<Expr<R>*> keys;
+				std::vector<Expr<R>*> values;
+				if (!check(RIGHT_BRACE)) {
+					do {
+						keys.emplace_back(expression());
+						consume(COLON, "Expect ':' after map key.");
+						values.emplace_back(expression());
+					} while (match(COMMA));
+				}
+				Token brace = consume(RIGHT_BRACE, "Expect '}' after map entries.");
+				return make<MapLiteral<R>>(brace, keys, values);
 			}
 
 			throw error(peek(), "Expect expression.");
@@ -343,11 +371,13 @@ namespace pitta {
 
 		Stmt<T, R>* statement() {
 			if (match(IF)) return ifStatement();
-			if (match(LEFT_BRACE))return track(new Block<T, R>(block()));
+			if (match(LEFT_BRACE))return make<Block<T, R>>(block());
 			if (match(WHILE))return whileStatement();
 			if (match(FOR))return forStatement();
 			if (match(PRINT))return printStatement();
 			if (match(RETURN))return returnStatement();
+			if (match(BREAK))return breakStatement();
+			if (match(CONTINUE))return continueStatement();
 
 			return expressionStatement();
 		}
@@ -362,14 +392,19 @@ namespace pitta {
 			return statements;
 		}
 
+		Stmt<T, R>* breakStatement() {
+			Token keyword = previous();
+			consume(SEMICOLON, "Expect ';' after 'break'.");
+			return make<Break<T, R>>(keyword);
+		}
+
 		Stmt<T, R>* classDeclaration() {
 			Token name = consume(IDENTIFIER, "Expected a class name");
 
 			Variable<R>* superclass = nullptr;
 			if (match(LESS)) {
 				consume(IDENTIFIER, "Expect superclass name");
-				superclass = new Variable<R>(previous());
-				track(superclass);
+				superclass = make<Variable<R>>(previous());
 			}
 
 			consume(LEFT_BRACE, "Expect '{' before class body");
@@ -381,13 +416,19 @@ namespace pitta {
 
 			consume(RIGHT_BRACE, "Expect '}' after class body.");
 
-			return track(new ClassStmt<T, R>(name, superclass, methods));
+			return make<ClassStmt<T, R>>(name, superclass, methods);
+		}
+
+		Stmt<T, R>* continueStatement() {
+			Token keyword = previous();
+			consume(SEMICOLON, "Expect ';' after 'continue'.");
+			return make<Continue<T, R>>(keyword);
 		}
 
 		Stmt<T, R>* expressionStatement() {
 			Expr<R>* expr = expression();
 			consume(SEMICOLON, "Expect ';' after expression");
-			return track(new Expression<T, R>(expr));
+			return make<Expression<T, R>>(expr);
 		}
 
 		Stmt<T, R>* forStatement() {
@@ -398,29 +439,17 @@ namespace pitta {
 			else if (!match(SEMICOLON))
 				initializer = expressionStatement();
 
-			Expr<R>* condition;
+			Expr<R>* condition = nullptr;
 			if (!check(SEMICOLON))
 				condition = expression();
-			else
-				condition = track(new Literal<R>(true));
 			consume(SEMICOLON, "Expect ';' after loop condition.");
 
-			Expr<R>* increment;
+			Expr<R>* increment = nullptr;
 			if (!check(RIGHT_PAREN))
 				increment = expression();
-			else
-				increment = track(new Literal<R>(true));
 			consume(RIGHT_PAREN, "Expect ')' after for clauses.");
 
-			Stmt<T, R>* loopBody = statement();
-
-
-			loopBody = track(new Block<T, R>({ loopBody, track(new Expression<T, R>(increment)) }));
-			loopBody = track(new While<T, R>(condition, loopBody));
-			if (initializer != nullptr)
-				loopBody = track(new Block<T, R>({ initializer, loopBody }));
-
-			return loopBody;
+			return make<For<T, R>>(initializer, condition, increment, statement());
 		}
 
 		Stmt<T, R>* function(const std::string& functionKind) {
@@ -440,7 +469,7 @@ namespace pitta {
 			consume(RIGHT_PAREN, "Expect ')' after parameters.");
 			consume(LEFT_BRACE, "Expect '{' before " + functionKind + " body.");
 			std::vector<Stmt<T, R>*> body = block();
-			return track(new FunctionStmt<T, R>(name, parameters, body));
+			return make<FunctionStmt<T, R>>(name, parameters, body);
 		}
 
 		Stmt<T, R>* ifStatement() {
@@ -454,13 +483,13 @@ namespace pitta {
 				elseBranch = statement();
 			}
 
-			return track(new If<T, R>(condition, thenBranch, elseBranch));
+			return make<If<T, R>>(condition, thenBranch, elseBranch);
 		}
 
 		Stmt<T, R>* printStatement() {
 			Expr<R>* expr = expression();
 			consume(SEMICOLON, "Expect ';' after value");
-			return track(new Print<T, R>(expr));
+			return make<Print<T, R>>(expr);
 		}
 
 		Stmt<T, R>* returnStatement() {
@@ -471,7 +500,7 @@ namespace pitta {
 			}
 
 			consume(SEMICOLON, "Expect ';' after return value.");
-			return track(new Return<T, R>(keyword, value));
+			return make<Return<T, R>>(keyword, value);
 		}
 
 		Stmt<T, R>* varDeclaration() {
@@ -483,7 +512,7 @@ namespace pitta {
 			}
 
 			consume(SEMICOLON, "Expect ';' after variable declaration");
-			return track(new Var<T, R>(name, initializer));
+			return make<Var<T, R>>(name, initializer);
 		}
 
 		Stmt<T, R>* whileStatement() {
@@ -492,7 +521,7 @@ namespace pitta {
 			consume(RIGHT_PAREN, "Expect ')' after condition.");
 			Stmt<T, R>* body = statement();
 
-			return track(new While<T, R>(condition, body));
+			return make<While<T, R>>(condition, body);
 		}
 
 		/*template<class T, class R>
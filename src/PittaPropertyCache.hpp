@@ -0,0 +1,89 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "PittaShape.hpp"
+
+namespace pitta {
+
+	class Callable;
+
+	//How often property accesses were answered by their site's cache, against how often the class had to be searched
+	struct InlineCacheStats {
+		size_t hits = 0;
+		size_t misses = 0;
+	};
+
+	//Sits on each property access site, remembering what the site's name resolved to for the last few shapes
+	//it saw. A hit goes straight to the field's slot or the method, without looking the name up at all.
+	//The cache keeps the shapes it remembers alive, so an entry can't be mistaken for a shape that is later created at
+	//the same address. An entry for a freed class is never hit, since no instance can have its shapes any more
+	class PropertyCache {
+	public:
+		static constexpr int c_size = 4;
+
+		struct Entry {
+			const Shape* shape;
+			//The method the name resolves to when read, or nullptr if it names the field in slot
+			Callable* method;
+			//When a write adds the field, the shape the instance moves to. Otherwise the same as shape
+			const Shape* newShape;
+			uint16_t slot;
+			//The slot is one of the class's native fields, kept in the C++ object rather than the instance
+			bool isNative = false;
+		};
+
+		//Returns nullptr if this site has not seen an instance of the shape yet
+		const Entry* find(const Shape* shape)const {
+			for (int i = 0; i < count; i++) {
+				if (entries[i].shape == shape)
+					return &entries[i];
+			}
+			return nullptr;
+		}
+
+		//Once every entry is in use the oldest is replaced
+		void add(const Entry& entry) {
+			Shape::retain(entry.shape);
+			Shape::retain(entry.newShape);
+			if (count == c_size)
+				forget(entries[next]);
+			entries[next] = entry;
+			next = (next + 1) % c_size;
+			if (count < c_size)
+				count += 1;
+		}
+
+		PropertyCache() = default;
+		PropertyCache(const PropertyCache& other) {
+			*this = other;
+		}
+		PropertyCache& operator=(const PropertyCache& other) {
+			if (this != &other) {
+				clear();
+				for (int i = 0; i < other.count; i++)
+					add(other.entries[i]);
+			}
+			return *this;
+		}
+		~PropertyCache() {
+			clear();
+		}
+
+	private:
+		Entry entries[c_size];
+		uint8_t count = 0;
+		uint8_t next = 0;
+
+		static void forget(const Entry& entry) {
+			Shape::release(entry.shape);
+			Shape::release(entry.newShape);
+		}
+		void clear() {
+			for (int i = 0; i < count; i++)
+				forget(entries[i]);
+			count = 0;
+			next = 0;
+		}
+	};
+
+}
@@ -32,10 +32,26 @@ namespace pitta {
 			CLASS
 		};
 
+		struct ScopedVariable {
+			bool defined;
+			uint16_t slot;
+		};
+
+		struct Scope {
+			std::unordered_map<Symbol, ScopedVariable> variables;
+			//Index of the scope whose environment holds these variables. A scope nothing can capture shares the
+			//environment of the one around it, so it costs nothing to enter
+			size_t environment;
+			//Slots handed out in this scope's environment, including those of every scope sharing it
+			uint16_t slotCount = 0;
+		};
+
 		Interpreter* interpreter;
-		std::vector<std::unordered_map<std::string, bool>> scopes;
+		std::vector<Scope> scopes;
 		FunctionType currentFunction = FunctionType::NONE;
 		ClassType currentClass = ClassType::NONE;
+		//Loops around the statement being resolved, in the current function only
+		int loopDepth = 0;
 
 
 		void resolve(std::vector<Stmt<void, Value>*>& statements) {
@@ -52,10 +68,21 @@ namespace pitta {
 			expression->accept(this);
 		}
 
-		void resolveLocal(Expr<Value>* expression, const Token& name) {
+		//Anything not found in a local scope is left with a depth of c_globalVariable
+		template<class ExprType>
+		void resolveLocal(ExprType* expression, const Token& name) {
 			for (int i = scopes.size() - 1; i >= 0; i--) {
-				if (scopes[i].count(name.lexeme) > 0) {
-					interpreter->resolve(expression, scopes.size() - 1 - i);
+				auto variable = scopes[i].variables.find(name.lexeme);
+				if (variable != scopes[i].variables.end()) {
+					//Only scopes with environments of their own are stepped out of at runtime
+					uint16_t depth = 0;
+					for (size_t j = scopes[i].environment + 1; j < scopes.size(); j++) {
+						if (scopes[j].environment == j)
+							depth++;
+					}
+					expression->environmentDepth = depth;
+					expression->variableId = variable->second.slot;
+					return;
 				}
 			}
 		}
@@ -63,47 +90,135 @@ namespace pitta {
 		void resolveFunction(FunctionStmt<void, Value>* function, FunctionType type) {
 			FunctionType enclosingFunctionType = currentFunction;
 			currentFunction = type;
+			//A break in a function never reaches a loop the function is declared in
+			const int enclosingLoopDepth = loopDepth;
+			loopDepth = 0;
 
 			beginScope();
+			//Methods keep "this" in their first slot, ahead of the parameters
+			if (type == FunctionType::METHOD || type == FunctionType::INITIALISER)
+				declareHidden(c_classSelfReferenceKey);
 			for (const Token& param : function->params) {
 				declare(param);
 				define(param);
 			}
 			resolve(function->body);
+			function->localCount = scopes.back().slotCount;
 			endScope();
 
 			currentFunction = enclosingFunctionType;
+			loopDepth = enclosingLoopDepth;
+		}
+
+		void resolveLoopBody(Stmt<void, Value>* body) {
+			loopDepth++;
+			resolve(body);
+			loopDepth--;
+		}
+
+		//Whether any of the statements would declare something in the scope they are in
+		static bool declaresVariables(const std::vector<Stmt<void, Value>*>& statements) {
+			for (Stmt<void, Value>* stmt : statements) {
+				if (dynamic_cast<Var<void, Value>*>(stmt) != nullptr || dynamic_cast<FunctionStmt<void, Value>*>(stmt) != nullptr
+					|| dynamic_cast<ClassStmt<void, Value>*>(stmt) != nullptr)
+					return true;
+			}
+			return false;
+		}
+
+		//Whether a function or class is declared anywhere in the statement. Only those can capture a scope's
+		//variables and outlive it, so a scope without any never needs an environment of its own
+		static bool declaresClosures(Stmt<void, Value>* stmt) {
+			if (stmt == nullptr)
+				return false;
+			if (dynamic_cast<FunctionStmt<void, Value>*>(stmt) != nullptr || dynamic_cast<ClassStmt<void, Value>*>(stmt) != nullptr)
+				return true;
+			if (Block<void, Value>* block = dynamic_cast<Block<void, Value>*>(stmt))
+				return declaresClosures(block->statements);
+			if (If<void, Value>* ifStmt = dynamic_cast<If<void, Value>*>(stmt))
+				return declaresClosures(ifStmt->thenBranch) || declaresClosures(ifStmt->elseBranch);
+			if (While<void, Value>* whileStmt = dynamic_cast<While<void, Value>*>(stmt))
+				return declaresClosures(whileStmt->body);
+			if (For<void, Value>* forStmt = dynamic_cast<For<void, Value>*>(stmt))
+				return declaresClosures(forStmt->body);
+			return false;
+		}
+
+		static bool declaresClosures(const std::vector<Stmt<void, Value>*>& statements) {
+			for (Stmt<void, Value>* stmt : statements) {
+				if (declaresClosures(stmt))
+					return true;
+			}
+			return false;
 		}
 
 		void beginScope() {
 			scopes.emplace_back();
+			scopes.back().environment = scopes.size() - 1;
+		}
+
+		//A scope that shares the environment around it, when there is a local one to share
+		void beginSharedScope() {
+			if (scopes.empty()) {
+				beginScope();
+				return;
+			}
+			const size_t environment = scopes.back().environment;
+			scopes.emplace_back();
+			scopes.back().environment = environment;
+		}
+
+		//Whether the scope at the top has an environment of its own
+		bool hasOwnEnvironment()const {
+			return scopes.back().environment == scopes.size() - 1;
 		}
 
 		void endScope() {
 			scopes.pop_back();
 		}
 
-		void declare(const Token& name) {
-			if (!scopes.empty()) {
-				auto& currentScope = scopes.back();
-				if (currentScope.count(name.lexeme) > 0) {
-					interpreter->getRuntime()->error(name, 
-						"Variable '" + name.lexeme + "' already declared in this scope"
-					);
-				}
+		uint16_t allocateSlot() {
+			return scopes[scopes.back().environment].slotCount++;
+		}
 
-				currentScope.emplace(name.lexeme, false);
+		//Returns the slot the variable will occupy in its environment, or c_globalVariable at the top level
+		uint16_t declare(const Token& name) {
+			if (scopes.empty())
+				return c_globalVariable;
+
+			auto& currentScope = scopes.back().variables;
+			if (currentScope.count(name.lexeme) > 0) {
+				interpreter->getRuntime()->error(name, 
+					"Variable '" + name.lexeme.str() + "' already declared in this scope"
+				);
+				return currentScope.at(name.lexeme).slot;
 			}
+
+			const uint16_t slot = allocateSlot();
+			currentScope.emplace(name.lexeme, ScopedVariable{ false, slot });
+			return slot;
+		}
+
+		//For the variables the language declares itself, such as "this"
+		void declareHidden(Symbol name) {
+			const uint16_t slot = allocateSlot();
+			scopes.back().variables.emplace(name, ScopedVariable{ true, slot });
 		}
 
 		void define(const Token& name) {
 			if (!scopes.empty()) {
-				auto& currentScope = scopes.back();
+				auto& currentScope = scopes.back().variables;
 
-				currentScope.at(name.lexeme) = true;
+				currentScope.at(name.lexeme).defined = true;
 			}
 		}
 
+		Value visitArrayLiteralExpr(ArrayLiteral<Value>* expr) override {
+			for (Expr<Value>* element : expr->elements)
+				resolve(element);
+			return Null;
+		}
+
 		Value visitAssignExpr(Assign<Value>* expr) override {
 			resolve(expr->value);
 			resolveLocal(expr, expr->name);
@@ -128,6 +243,12 @@ namespace pitta {
 			return Null;
 		}
 
+		Value visitGetIndexExpr(GetIndex<Value>* expr) override {
+			resolve(expr->object);
+			resolve(expr->index);
+			return Null;
+		}
+
 		Value visitGroupingExpr(Grouping<Value>* expr) override {
 			resolve(expr->expression);
 			return Null;
@@ -143,12 +264,27 @@ namespace pitta {
 			return Null;
 		}
 
+		Value visitMapLiteralExpr(MapLiteral<Value>* expr) override {
+			for (size_t i = 0; i < expr->keys.size(); i++) {
+				resolve(expr->keys[i]);
+				resolve(expr->values[i]);
+			}
+			return Null;
+		}
+
 		Value visitSetExpr(Set<Value>* expr) override {
 			resolve(expr->value);
 			resolve(expr->object);
 			return Null;
 		}
 
+		Value visitSetIndexExpr(SetIndex<Value>* expr) override {
+			resolve(expr->value);
+			resolve(expr->object);
+			resolve(expr->index);
+			return Null;
+		}
+
 		Value visitSuperExpr(Super<Value>* expr) override {
 			resolveLocal(expr, expr->keyword);
 			return Null;
@@ -170,11 +306,11 @@ namespace pitta {
 
 		Value visitVariableExpr(Variable<Value>* expr) override {
 			if (!scopes.empty()) {
-				auto& currentScope = scopes.back();
+				auto& currentScope = scopes.back().variables;
 				if (currentScope.count(expr->name.lexeme) > 0) {
-					if (currentScope.at(expr->name.lexeme) == false) {
+					if (currentScope.at(expr->name.lexeme).defined == false) {
 						interpreter->getRuntime()->error(expr->name,
-							"Can't read local variable in its own initiliser. Variable '" + expr->name.lexeme + "' On line " + std::to_string(expr->name.line)
+							"Can't read local variable in its own initiliser. Variable '" + expr->name.lexeme.str() + "' On line " + std::to_string(expr->name.line)
 						);
 					}
 				}
@@ -187,16 +323,32 @@ namespace pitta {
 
 
 		void visitBlockStmt(Block<void, Value>* stmt)override {
-			beginScope();
+			//Without a scope of its own, both engines run the block in the enclosing one
+			if (!declaresVariables(stmt->statements)) {
+				resolve(stmt->statements);
+				stmt->localCount = 0;
+				return;
+			}
+
+			if (declaresClosures(stmt->statements))
+				beginScope();
+			else
+				beginSharedScope();
 			resolve(stmt->statements);
+			stmt->localCount = hasOwnEnvironment() ? scopes.back().slotCount : 0;
 			endScope();
 		}
 
+		void visitBreakStmt(Break<void, Value>* stmt)override {
+			if (loopDepth == 0)
+				interpreter->getRuntime()->error(stmt->keyword, "Can't use 'break' outside of a loop.");
+		}
+
 		void visitClassStmt(ClassStmt<void, Value>* stmt)override {
 			ClassType enclosingClassType = currentClass;
 			currentClass = ClassType::CLASS;
 
-			declare(stmt->name);
+			stmt->variableId = declare(stmt->name);
 			define(stmt->name);
 
 			if (stmt->superclass != nullptr) {
@@ -207,31 +359,53 @@ namespace pitta {
 				resolve(stmt->superclass);
 
 				beginScope();
-				scopes.back().emplace("super", true);
+				declareHidden("super");
 			}
 
 
-			beginScope();
-			scopes.back().emplace(c_classSelfReferenceKey, true);
-
 			for (FunctionStmt<void, Value>* method : stmt->methods) {
 				FunctionType declaration = method->name.lexeme == "init" ? FunctionType::INITIALISER : FunctionType::METHOD;
 				resolveFunction(method, declaration);
 			}
 
-			endScope();
 			if (stmt->superclass != nullptr)
 				endScope();
 
 			currentClass = enclosingClassType;
 		}
 
+		void visitContinueStmt(Continue<void, Value>* stmt)override {
+			if (loopDepth == 0)
+				interpreter->getRuntime()->error(stmt->keyword, "Can't use 'continue' outside of a loop.");
+		}
+
 		void visitExpressionStmt(Expression<void, Value>* stmt) override {
 			resolve(stmt->expression);
 		}
 
+		void visitForStmt(For<void, Value>* stmt) override {
+			//Only a loop variable needs a scope, and it is the same one for every iteration
+			const bool hasScope = stmt->initializer != nullptr && declaresVariables({ stmt->initializer });
+			if (hasScope && declaresClosures(stmt->body))
+				beginScope();
+			else if (hasScope)
+				beginSharedScope();
+
+			if (stmt->initializer != nullptr)
+				resolve(stmt->initializer);
+			if (stmt->condition != nullptr)
+				resolve(stmt->condition);
+			if (stmt->increment != nullptr)
+				resolve(stmt->increment);
+			resolveLoopBody(stmt->body);
+
+			stmt->localCount = hasScope && hasOwnEnvironment() ? scopes.back().slotCount : 0;
+			if (hasScope)
+				endScope();
+		}
+
 		void visitFunctionStmt(FunctionStmt<void, Value>* stmt) override {
-			declare(stmt->name);
+			stmt->variableId = declare(stmt->name);
 			define(stmt->name);
 
 			resolveFunction(stmt, FunctionType::FUNCTION);
@@ -262,7 +436,7 @@ namespace pitta {
 		}
 
 		void visitVarStmt(Var<void, Value>* stmt) override {
-			declare(stmt->name);
+			stmt->variableId = declare(stmt->name);
 			if (stmt->initializer != nullptr) {
 				resolve(stmt->initializer);
 			}
@@ -271,7 +445,7 @@ namespace pitta {
 
 		void visitWhileStmt(While<void, Value>* stmt)override {
 			resolve(stmt->condition);
-			resolve(stmt->body);
+			resolveLoopBody(stmt->body);
 		}
 	};
 
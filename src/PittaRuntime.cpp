@@ -11,7 +11,7 @@ namespace pitta {
 			report(token.line, " at end", message);
 		}
 		else {
-			report(token.line, " at '" + token.lexeme + "'", message);
+			report(token.line, " at '" + token.lexeme.str() + "'", message);
 		}
 	}
 
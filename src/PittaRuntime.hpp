@@ -2,14 +2,21 @@
 
 #include <string>
 #include <stdio.h>
+#include <atomic>
 
 #include "PittaTokenScanner.hpp"
+#include "PittaPropertyCache.hpp"
+#include "PittaHeap.hpp"
 
 namespace pitta {
 
 	class Runtime {
 	public:
-		bool hadError = false;
+		//Atomic so another thread can check on a script as it runs
+		std::atomic<bool> hadError{ false };
+
+		InlineCacheStats inlineCaches;
+		GCStats gcStats;
 
 		void error(int line, const std::string& message);
 
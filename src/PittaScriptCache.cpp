@@ -0,0 +1,823 @@
+#include "PittaScriptCache.hpp"
+#include "PittaOptimiser.hpp"
+#include <string.h>
+#include <stdio.h>
+#include <fstream>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace pitta {
+
+	//"PITC" read as a little endian number, so an entry from a machine with the other byte order never matches
+	static constexpr uint32_t c_cacheMagic = 0x43544950;
+	//Magic, version, build options, source hash, source length and a hash of everything after the header
+	static constexpr size_t c_headerSize = 4 + 4 + 4 + 8 + 8 + 8;
+	//Settings that change the stored tree, so a build with different settings compiles again instead of using it
+	static constexpr uint32_t c_buildOptions = PITTA_OPTIMISE;
+
+	enum NodeTag : uint8_t {
+		NoNode,
+		ArrayLiteralNode, AssignNode, BinaryNode, CallNode, GetNode, GetIndexNode, GroupingNode, LiteralNode, LogicalNode, MapLiteralNode, SetNode, SetIndexNode,
+		SuperNode, ThisNode, UnaryNode, VariableNode,
+		BlockNode, BreakNode, ClassNode, ContinueNode, ExpressionNode, ForNode, FunctionNode, IfNode, PrintNode, ReturnNode, VarNode, WhileNode
+	};
+
+	//Read only view of a whole file, mapped straight into memory so nothing is copied before it is read
+	class MappedFile {
+	public:
+		const char* data()const {
+			return memory;
+		}
+		size_t size()const {
+			return length;
+		}
+		bool isOpen()const {
+			return memory != nullptr;
+		}
+
+		MappedFile(const std::string& path) {
+#ifdef _WIN32
+			file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+				return;
+			LARGE_INTEGER fileSize;
+			//Empty files cannot be mapped, and are never valid entries anyway
+			if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+				return;
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping == nullptr)
+				return;
+			memory = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			length = memory != nullptr ? size_t(fileSize.QuadPart) : 0;
+#else
+			const int file = open(path.c_str(), O_RDONLY);
+			if (file < 0)
+				return;
+			struct stat status;
+			if (fstat(file, &status) == 0 && status.st_size > 0) {
+				void* mapped = mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+				if (mapped != MAP_FAILED) {
+					memory = (const char*)mapped;
+					length = size_t(status.st_size);
+				}
+			}
+			//The mapping stays valid once the file is closed
+			close(file);
+#endif
+		}
+
+		~MappedFile() {
+#ifdef _WIN32
+			if (memory != nullptr)
+				UnmapViewOfFile(memory);
+			if (mapping != nullptr)
+				CloseHandle(mapping);
+			if (file != INVALID_HANDLE_VALUE)
+				CloseHandle(file);
+#else
+			if (memory != nullptr)
+				munmap((void*)memory, length);
+#endif
+		}
+
+		MappedFile(const MappedFile&) = delete;
+
+	private:
+		const char* memory = nullptr;
+		size_t length = 0;
+#ifdef _WIN32
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+#endif
+	};
+
+
+
+	//Writes nodes depth first, each one a tag followed by its fields. Strings are written once into a table
+	//at the front, and referred to by their index everywhere else
+	class ScriptCache::Writer : private StatementVisitor<void, Value>, private ExpressionVisitor<Value> {
+	public:
+		bool ok = true;
+		std::string body;
+		std::vector<const std::string*> strings;
+
+		void write(Stmt<void, Value>* stmt) {
+			if (stmt == nullptr)
+				put<uint8_t>(NoNode);
+			else
+				stmt->accept(this);
+		}
+
+		void write(Expr<Value>* expr) {
+			if (expr == nullptr)
+				put<uint8_t>(NoNode);
+			else
+				expr->accept(this);
+		}
+
+		template<class T>
+		void put(T value) {
+			body.append((const char*)&value, sizeof(T));
+		}
+
+	private:
+		std::unordered_map<const std::string*, uint32_t> stringIndices;
+
+		void putString(const std::string* text) {
+			auto found = stringIndices.find(text);
+			if (found == stringIndices.end()) {
+				found = stringIndices.emplace(text, uint32_t(strings.size())).first;
+				strings.push_back(text);
+			}
+			put<uint32_t>(found->second);
+		}
+
+		void putValue(const Value& value) {
+			put<uint8_t>(value.getType());
+			switch (value.getType()) {
+			case Int:
+				put<int32_t>(value.asInt());
+				break;
+			case Float:
+				put<float>(value.asFloat());
+				break;
+			case Bool:
+				put<uint8_t>(value.asBool());
+				break;
+			case String:
+				putString(&value.asString());
+				break;
+			case Null:
+			case Undefined:
+				break;
+			default:
+				//Literals never hold anything made at runtime
+				ok = false;
+			}
+		}
+
+		void putToken(Token& token) {
+			put<uint8_t>(token.type);
+			putString(&token.lexeme.str());
+			put<int32_t>(token.line);
+			putValue(token.getLiteralValue());
+		}
+
+		void putFunction(FunctionStmt<void, Value>* stmt) {
+			putToken(stmt->name);
+			put<uint32_t>(uint32_t(stmt->params.size()));
+			for (Token& param : stmt->params)
+				putToken(param);
+			put<uint32_t>(uint32_t(stmt->body.size()));
+			for (Stmt<void, Value>* bodyStmt : stmt->body)
+				write(bodyStmt);
+			put<uint16_t>(stmt->variableId);
+			put<uint16_t>(stmt->localCount);
+		}
+
+		Value visitArrayLiteralExpr(ArrayLiteral<Value>* expr) override {
+			put<uint8_t>(ArrayLiteralNode);
+			putToken(expr->closingBracket);
+			put<uint32_t>(uint32_t(expr->elements.size()));
+			for (Expr<Value>* element : expr->elements)
+				write(element);
+			return Value();
+		}
+		Value visitAssignExpr(Assign<Value>* expr) override {
+			put<uint8_t>(AssignNode);
+			putToken(expr->name);
+			write(expr->value);
+			put<uint16_t>(expr->environmentDepth);
+			put<uint16_t>(expr->variableId);
+			return Value();
+		}
+		Value visitBinaryExpr(Binary<Value>* expr) override {
+			put<uint8_t>(BinaryNode);
+			write(expr->left);
+			putToken(expr->op);
+			write(expr->right);
+			return Value();
+		}
+		Value visitCallExpr(Call<Value>* expr) override {
+			put<uint8_t>(CallNode);
+			write(expr->callee);
+			putToken(expr->closingParenthesis);
+			put<uint32_t>(uint32_t(expr->arguments.size()));
+			for (Expr<Value>* argument : expr->arguments)
+				write(argument);
+			return Value();
+		}
+		Value visitGetExpr(Get<Value>* expr) override {
+			put<uint8_t>(GetNode);
+			write(expr->object);
+			putToken(expr->name);
+			return Value();
+		}
+		Value visitGetIndexExpr(GetIndex<Value>* expr) override {
+			put<uint8_t>(GetIndexNode);
+			write(expr->object);
+			putToken(expr->closingBracket);
+			write(expr->index);
+			return Value();
+		}
+		Value visitGroupingExpr(Grouping<Value>* expr) override {
+			put<uint8_t>(GroupingNode);
+			write(expr->expression);
+			return Value();
+		}
+		Value visitLiteralExpr(Literal<Value>* expr) override {
+			put<uint8_t>(LiteralNode);
+			putValue(expr->value);
+			return Value();
+		}
+		Value visitLogicalExpr(Logical<Value>* expr) override {
+			put<uint8_t>(LogicalNode);
+			write(expr->left);
+			putToken(expr->op);
+			write(expr->right);
+			return Value();
+		}
+		Value visitMapLiteralExpr(MapLiteral<Value>* expr) override {
+			put<uint8_t>(MapLiteralNode);
+			putToken(expr->closingBrace);
+			put<uint32_t>(uint32_t(expr->keys.size()));
+			for (size_t i = 0; i < expr->keys.size(); i++) {
+				write(expr->keys[i]);
+				write(expr->values[i]);
+			}
+			return Value();
+		}
+		Value visitSetExpr(Set<Value>* expr) override {
+			put<uint8_t>(SetNode);
+			write(expr->object);
+			putToken(expr->name);
+			write(expr->value);
+			return Value();
+		}
+		Value visitSetIndexExpr(SetIndex<Value>* expr) override {
+			put<uint8_t>(SetIndexNode);
+			write(expr->object);
+			putToken(expr->closingBracket);
+			write(expr->index);
+			write(expr->value);
+			return Value();
+		}
+		Value visitSuperExpr(Super<Value>* expr) override {
+			put<uint8_t>(SuperNode);
+			putToken(expr->keyword);
+			putToken(expr->method);
+			put<uint16_t>(expr->environmentDepth);
+			put<uint16_t>(expr->variableId);
+			return Value();
+		}
+		Value visitThisExpr(This<Value>* expr) override {
+			put<uint8_t>(ThisNode);
+			putToken(expr->keyword);
+			put<uint16_t>(expr->environmentDepth);
+			put<uint16_t>(expr->variableId);
+			return Value();
+		}
+		Value visitUnaryExpr(Unary<Value>* expr) override {
+			put<uint8_t>(UnaryNode);
+			putToken(expr->op);
+			write(expr->right);
+			return Value();
+		}
+		Value visitVariableExpr(Variable<Value>* expr) override {
+			put<uint8_t>(VariableNode);
+			putToken(expr->name);
+			put<uint16_t>(expr->environmentDepth);
+			put<uint16_t>(expr->variableId);
+			return Value();
+		}
+
+		void visitBlockStmt(Block<void, Value>* stmt) override {
+			put<uint8_t>(BlockNode);
+			put<uint32_t>(uint32_t(stmt->statements.size()));
+			for (Stmt<void, Value>* blockStmt : stmt->statements)
+				write(blockStmt);
+			put<uint16_t>(stmt->localCount);
+		}
+		void visitBreakStmt(Break<void, Value>* stmt) override {
+			put<uint8_t>(BreakNode);
+			putToken(stmt->keyword);
+		}
+		void visitClassStmt(ClassStmt<void, Value>* stmt) override {
+			put<uint8_t>(ClassNode);
+			putToken(stmt->name);
+			write(stmt->superclass);
+			put<uint32_t>(uint32_t(stmt->methods.size()));
+			for (FunctionStmt<void, Value>* method : stmt->methods)
+				putFunction(method);
+			put<uint16_t>(stmt->variableId);
+		}
+		void visitContinueStmt(Continue<void, Value>* stmt) override {
+			put<uint8_t>(ContinueNode);
+			putToken(stmt->keyword);
+		}
+		void visitExpressionStmt(Expression<void, Value>* stmt) override {
+			put<uint8_t>(ExpressionNode);
+			write(stmt->expression);
+		}
+		void visitForStmt(For<void, Value>* stmt) override {
+			put<uint8_t>(ForNode);
+			write(stmt->initializer);
+			write(stmt->condition);
+			write(stmt->increment);
+			write(stmt->body);
+			put<uint16_t>(stmt->localCount);
+		}
+		void visitFunctionStmt(FunctionStmt<void, Value>* stmt) override {
+			put<uint8_t>(FunctionNode);
+			putFunction(stmt);
+		}
+		void visitIfStmt(If<void, Value>* stmt) override {
+			put<uint8_t>(IfNode);
+			write(stmt->condition);
+			write(stmt->thenBranch);
+			write(stmt->elseBranch);
+		}
+		void visitPrintStmt(Print<void, Value>* stmt) override {
+			put<uint8_t>(PrintNode);
+			write(stmt->expression);
+		}
+		void visitReturnStmt(Return<void, Value>* stmt) override {
+			put<uint8_t>(ReturnNode);
+			putToken(stmt->keyword);
+			write(stmt->value);
+		}
+		void visitVarStmt(Var<void, Value>* stmt) override {
+			put<uint8_t>(VarNode);
+			putToken(stmt->name);
+			write(stmt->initializer);
+			put<uint16_t>(stmt->variableId);
+		}
+		void visitWhileStmt(While<void, Value>* stmt) override {
+			put<uint8_t>(WhileNode);
+			write(stmt->condition);
+			write(stmt->body);
+		}
+	};
+
+
+
+	//Reads back what the writer wrote, checking every count, index and tag against the data, as the file
+	//could have been truncated or changed by anything. Once anything is wrong, ok is cleared and reading stops
+	class ScriptCache::Reader {
+	public:
+		bool ok = true;
+
+		template<class T>
+		T get() {
+			T value{};
+			if (size_t(end - at) < sizeof(T))
+				ok = false;
+			else {
+				memcpy(&value, at, sizeof(T));
+				at += sizeof(T);
+			}
+			return value;
+		}
+
+		bool readStrings() {
+			const uint32_t count = getCount();
+			strings.reserve(count);
+			for (uint32_t i = 0; i < count && ok; i++) {
+				const uint32_t length = get<uint32_t>();
+				if (!ok || size_t(end - at) < length)
+					return ok = false;
+				strings.push_back(StringTable::current().intern(std::string_view(at, length)));
+				at += length;
+			}
+			return ok;
+		}
+
+		//Number of items that follow, each of which takes at least a byte
+		uint32_t getCount() {
+			const uint32_t count = get<uint32_t>();
+			if (count > size_t(end - at))
+				ok = false;
+			return ok ? count : 0;
+		}
+
+		bool atEnd()const {
+			return at == end;
+		}
+
+		Stmt<void, Value>* readStmt() {
+			const uint8_t tag = get<uint8_t>();
+			if (!ok)
+				return nullptr;
+
+			switch (tag) {
+			case NoNode:
+				return nullptr;
+			case BlockNode: {
+				std::vector<Stmt<void, Value>*> statements = readStatements();
+				Block<void, Value>* stmt = arena.make<Block<void, Value>>(statements);
+				stmt->localCount = get<uint16_t>();
+				return stmt;
+			}
+			case BreakNode:
+				return arena.make<Break<void, Value>>(getToken());
+			case ClassNode: {
+				Token name = getToken();
+				Expr<Value>* superclass = readExpr();
+				if (superclass != nullptr && superclass->getType() != typeid(Variable<Value>))
+					return fail();
+				std::vector<FunctionStmt<void, Value>*> methods;
+				const uint32_t count = getCount();
+				for (uint32_t i = 0; i < count && ok; i++)
+					methods.push_back(readFunction());
+				ClassStmt<void, Value>* stmt = arena.make<ClassStmt<void, Value>>(name, static_cast<Variable<Value>*>(superclass), methods);
+				stmt->variableId = get<uint16_t>();
+				return stmt;
+			}
+			case ContinueNode:
+				return arena.make<Continue<void, Value>>(getToken());
+			case ExpressionNode:
+				return arena.make<Expression<void, Value>>(readOperand());
+			case ForNode: {
+				Stmt<void, Value>* initializer = readStmt();
+				Expr<Value>* condition = readExpr();
+				Expr<Value>* increment = readExpr();
+				Stmt<void, Value>* body = readStmt();
+				if (body == nullptr)
+					return fail();
+				For<void, Value>* stmt = arena.make<For<void, Value>>(initializer, condition, increment, body);
+				stmt->localCount = get<uint16_t>();
+				return stmt;
+			}
+			case FunctionNode:
+				return readFunction();
+			case IfNode: {
+				Expr<Value>* condition = readOperand();
+				Stmt<void, Value>* thenBranch = readStmt();
+				Stmt<void, Value>* elseBranch = readStmt();
+				if (thenBranch == nullptr)
+					return fail();
+				return arena.make<If<void, Value>>(condition, thenBranch, elseBranch);
+			}
+			case PrintNode:
+				return arena.make<Print<void, Value>>(readOperand());
+			case ReturnNode: {
+				Token keyword = getToken();
+				return arena.make<Return<void, Value>>(keyword, readExpr());
+			}
+			case VarNode: {
+				Token name = getToken();
+				Var<void, Value>* stmt = arena.make<Var<void, Value>>(name, readExpr());
+				stmt->variableId = get<uint16_t>();
+				return stmt;
+			}
+			case WhileNode: {
+				Expr<Value>* condition = readOperand();
+				Stmt<void, Value>* body = readStmt();
+				if (body == nullptr)
+					return fail();
+				return arena.make<While<void, Value>>(condition, body);
+			}
+			default:
+				return fail();
+			}
+		}
+
+		std::vector<Stmt<void, Value>*> readStatements() {
+			std::vector<Stmt<void, Value>*> statements;
+			const uint32_t count = getCount();
+			statements.reserve(count);
+			for (uint32_t i = 0; i < count && ok; i++) {
+				Stmt<void, Value>* stmt = readStmt();
+				if (stmt == nullptr)
+					fail();
+				statements.push_back(stmt);
+			}
+			return statements;
+		}
+
+		Reader(const char* at, const char* end, Arena& arena) :
+			at(at),
+			end(end),
+			arena(arena)
+		{}
+
+	private:
+		const char* at;
+		const char* end;
+		Arena& arena;
+		std::vector<const std::string*> strings;
+
+		std::nullptr_t fail() {
+			ok = false;
+			return nullptr;
+		}
+
+		Symbol getSymbol() {
+			const uint32_t index = get<uint32_t>();
+			if (index >= strings.size()) {
+				ok = false;
+				return Symbol("");
+			}
+			return Symbol(strings[index]);
+		}
+
+		Value getValue() {
+			const uint8_t type = get<uint8_t>();
+			switch (type) {
+			case Int:
+				return Value(int(get<int32_t>()));
+			case Float:
+				return Value(get<float>());
+			case Bool:
+				return Value(get<uint8_t>() != 0);
+			case String:
+				return Value(getSymbol());
+			case Null:
+			case Undefined:
+				return Value(Type(type));
+			default:
+				ok = false;
+				return Value();
+			}
+		}
+
+		Token getToken() {
+			const uint8_t type = get<uint8_t>();
+			if (type > END_OF_FILE)
+				ok = false;
+			Symbol lexeme = getSymbol();
+			const int line = get<int32_t>();
+			return Token(TokenType(type), lexeme, line, getValue());
+		}
+
+		FunctionStmt<void, Value>* readFunction() {
+			Token name = getToken();
+			std::vector<Token> params;
+			const uint32_t count = getCount();
+			for (uint32_t i = 0; i < count && ok; i++)
+				params.push_back(getToken());
+			std::vector<Stmt<void, Value>*> body = readStatements();
+			FunctionStmt<void, Value>* stmt = arena.make<FunctionStmt<void, Value>>(name, params, body);
+			stmt->variableId = get<uint16_t>();
+			stmt->localCount = get<uint16_t>();
+			return stmt;
+		}
+
+		//An expression that cannot be left out
+		Expr<Value>* readOperand() {
+			Expr<Value>* expr = readExpr();
+			return expr != nullptr ? expr : fail();
+		}
+
+		Expr<Value>* readExpr() {
+			const uint8_t tag = get<uint8_t>();
+			if (!ok)
+				return nullptr;
+
+			switch (tag) {
+			case NoNode:
+				return nullptr;
+			case ArrayLiteralNode: {
+				Token closingBracket = getToken();
+				std::vector<Expr<Value>*> elements;
+				const uint32_t count = getCount();
+				for (uint32_t i = 0; i < count && ok; i++)
+					elements.push_back(readOperand());
+				return arena.make<ArrayLiteral<Value>>(closingBracket, elements);
+			}
+			case AssignNode: {
+				Token name = getToken();
+				Assign<Value>* expr = arena.make<Assign<Value>>(name, readOperand());
+				expr->environmentDepth = get<uint16_t>();
+				expr->variableId = get<uint16_t>();
+				return expr;
+			}
+			case BinaryNode: {
+				Expr<Value>* left = readOperand();
+				Token op = getToken();
+				return arena.make<Binary<Value>>(left, op, readOperand());
+			}
+			case CallNode: {
+				Expr<Value>* callee = readOperand();
+				if (callee == nullptr)
+					return nullptr;
+				Token closingParenthesis = getToken();
+				std::vector<Expr<Value>*> arguments;
+				const uint32_t count = getCount();
+				for (uint32_t i = 0; i < count && ok; i++)
+					arguments.push_back(readOperand());
+				return arena.make<Call<Value>>(callee, closingParenthesis, arguments);
+			}
+			case GetNode: {
+				Expr<Value>* object = readOperand();
+				return arena.make<Get<Value>>(object, getToken());
+			}
+			case GetIndexNode: {
+				Expr<Value>* object = readOperand();
+				Token closingBracket = getToken();
+				return arena.make<GetIndex<Value>>(object, closingBracket, readOperand());
+			}
+			case GroupingNode:
+				return arena.make<Grouping<Value>>(readOperand());
+			case LiteralNode:
+				return arena.make<Literal<Value>>(getValue());
+			case LogicalNode: {
+				Expr<Value>* left = readOperand();
+				Token op = getToken();
+				return arena.make<Logical<Value>>(left, op, readOperand());
+			}
+			case MapLiteralNode: {
+				Token closingBrace = getToken();
+				std::vector<Expr<Value>*> keys;
+				std::vector<Expr<Value>*> values;
+				const uint32_t count = getCount();
+				for (uint32_t i = 0; i < count && ok; i++) {
+					keys.push_back(readOperand());
+					values.push_back(readOperand());
+				}
+				return arena.make<MapLiteral<Value>>(closingBrace, keys, values);
+			}
+			case SetNode: {
+				Expr<Value>* object = readOperand();
+				Token name = getToken();
+				return arena.make<Set<Value>>(object, name, readOperand());
+			}
+			case SetIndexNode: {
+				Expr<Value>* object = readOperand();
+				Token closingBracket = getToken();
+				Expr<Value>* index = readOperand();
+				return arena.make<SetIndex<Value>>(object, closingBracket, index, readOperand());
+			}
+			case SuperNode: {
+				Token keyword = getToken();
+				Token method = getToken();
+				Super<Value>* expr = arena.make<Super<Value>>(keyword, method);
+				expr->environmentDepth = get<uint16_t>();
+				expr->variableId = get<uint16_t>();
+				return expr;
+			}
+			case ThisNode: {
+				This<Value>* expr = arena.make<This<Value>>(getToken());
+				expr->environmentDepth = get<uint16_t>();
+				expr->variableId = get<uint16_t>();
+				return expr;
+			}
+			case UnaryNode: {
+				Token op = getToken();
+				return arena.make<Unary<Value>>(op, readOperand());
+			}
+			case VariableNode: {
+				Variable<Value>* expr = arena.make<Variable<Value>>(getToken());
+				expr->environmentDepth = get<uint16_t>();
+				expr->variableId = get<uint16_t>();
+				return expr;
+			}
+			default:
+				return fail();
+			}
+		}
+	};
+
+
+
+	AbstractSyntaxTree<void, Value> ScriptCache::load(std::string_view source) {
+		const uint64_t hash = hashSource(source);
+		const std::string path = entryPath(hash);
+
+		{
+			MappedFile file(path);
+			if (file.isOpen()) {
+				std::vector<Stmt<void, Value>*> statements;
+				Arena arena;
+				if (deserialise(file.data(), file.size(), hash, source.size(), statements, arena)) {
+					hits++;
+					return AbstractSyntaxTree<void, Value>(statements, std::move(arena));
+				}
+			}
+		}
+
+		misses++;
+		AbstractSyntaxTree<void, Value> tree = compile(source);
+		if (!interpreter->getRuntime()->hadError) {
+			const std::string data = serialise(tree.statements, hash, source.size());
+			if (!data.empty()) {
+				//Written next to the entry and renamed over it, so another process never maps half an entry. Isolates on
+				//other threads may be writing the same entry, so each thread has its own temporary file
+				const std::string temporaryPath = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+				bool written;
+				{
+					std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+					written = bool(file.write(data.data(), data.size()));
+				}
+				if (!written || std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+					std::remove(temporaryPath.c_str());
+			}
+		}
+		return tree;
+	}
+
+	std::string ScriptCache::entryPath(uint64_t hash)const {
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.pittac", (unsigned long long)hash);
+		if (directory.empty())
+			return name;
+		const char last = directory.back();
+		return last == '/' || last == '\\' ? directory + name : directory + '/' + name;
+	}
+
+	uint64_t ScriptCache::hashSource(std::string_view source) {
+		uint64_t hash = 14695981039346656037ull;
+		for (const char c : source) {
+			hash ^= uint8_t(c);
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	std::string ScriptCache::serialise(const std::vector<Stmt<void, Value>*>& statements, uint64_t hash, uint64_t sourceLength) {
+		Writer writer;
+		writer.put<uint32_t>(uint32_t(statements.size()));
+		for (Stmt<void, Value>* stmt : statements)
+			writer.write(stmt);
+		if (!writer.ok)
+			return std::string();
+
+		std::string payload;
+		auto put = [&payload](auto value) {
+			payload.append((const char*)&value, sizeof(value));
+		};
+		put(uint32_t(writer.strings.size()));
+		for (const std::string* text : writer.strings) {
+			put(uint32_t(text->size()));
+			payload += *text;
+		}
+		payload += writer.body;
+
+		std::string data;
+		data.reserve(c_headerSize + payload.size());
+		auto putHeader = [&data](auto value) {
+			data.append((const char*)&value, sizeof(value));
+		};
+		putHeader(c_cacheMagic);
+		putHeader(c_formatVersion);
+		putHeader(c_buildOptions);
+		putHeader(hash);
+		putHeader(sourceLength);
+		putHeader(hashSource(payload));
+		data += payload;
+		return data;
+	}
+
+	bool ScriptCache::deserialise(const char* data, size_t size, uint64_t hash, uint64_t sourceLength,
+		std::vector<Stmt<void, Value>*>& statements, Arena& arena) {
+		if (size < c_headerSize)
+			return false;
+		Reader header(data, data + c_headerSize, arena);
+		if (header.get<uint32_t>() != c_cacheMagic || header.get<uint32_t>() != c_formatVersion
+			|| header.get<uint32_t>() != c_buildOptions || header.get<uint64_t>() != hash || header.get<uint64_t>() != sourceLength)
+			return false;
+		//A damaged entry could still parse, and run with the wrong slots, so the payload is checked as a whole first
+		if (header.get<uint64_t>() != hashSource(std::string_view(data + c_headerSize, size - c_headerSize)))
+			return false;
+
+		Reader reader(data + c_headerSize, data + size, arena);
+		if (!reader.readStrings())
+			return false;
+
+		statements = reader.readStatements();
+		return reader.ok && reader.atEnd();
+	}
+
+	ScriptCache::ScriptCache(const std::string& directory, Interpreter* interpreter) :
+		directory(directory),
+		interpreter(interpreter)
+	{}
+
+	AbstractSyntaxTree<void, Value> ScriptCache::compile(std::string_view source) {
+		Runtime* runtime = interpreter->getRuntime();
+		Scanner scanner(source, runtime);
+		Parser<void, Value> parser(scanner.scanTokens(), runtime);
+		AbstractSyntaxTree<void, Value> tree = parser.parse();
+		//The parser leaves null statements where it hit a syntax error, which the resolver can't walk
+		if (runtime->hadError)
+			return tree;
+
+		Resolver resolver(interpreter);
+		resolver.sweepStatements(tree.statements);
+		if (!runtime->hadError) {
+			Optimiser optimiser(interpreter);
+			optimiser.optimise(tree);
+		}
+		return tree;
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "PittaParser.hpp"
+#include "PittaResolver.hpp"
+#include <string_view>
+
+namespace pitta {
+
+	//Keeps parsed and resolved scripts on disk, so a script that has not changed since it was last loaded skips
+	//scanning, parsing and resolving. Each script is stored in its own file named after a hash of its source,
+	//so editing a script simply misses the cache and writes a new entry
+	class ScriptCache {
+	public:
+		//Bumped whenever the serialised layout, or what the resolver records in it, changes, so older entries are
+		//compiled again instead of misread
+		static constexpr uint32_t c_formatVersion = 6;
+
+		size_t hits = 0;
+		size_t misses = 0;
+
+		//The tree for the source, resolved and ready to run on either engine. Read from the cache when it holds
+		//this exact source, otherwise compiled as usual and written to the cache for next time.
+		//Errors are reported to the interpreter's runtime just as they are without a cache
+		AbstractSyntaxTree<void, Value> load(std::string_view source);
+
+		//Where the entry for a source with this hash lives
+		std::string entryPath(uint64_t hash)const;
+
+		//64 bit FNV-1a
+		static uint64_t hashSource(std::string_view source);
+
+		//Serialised form of a tree the resolver and optimiser have already swept, including every variable's depth and slot
+		static std::string serialise(const std::vector<Stmt<void, Value>*>& statements, uint64_t hash, uint64_t sourceLength);
+		//Rebuilds a tree in the arena. Returns false if the data is damaged, from another version, or not for this source
+		static bool deserialise(const char* data, size_t size, uint64_t hash, uint64_t sourceLength,
+			std::vector<Stmt<void, Value>*>& statements, Arena& arena);
+
+		//The directory has to exist already. Entries that cannot be written are compiled again on the next load
+		ScriptCache(const std::string& directory, Interpreter* interpreter);
+		ScriptCache(const ScriptCache&) = delete;
+
+	private:
+		class Writer;
+		class Reader;
+
+		std::string directory;
+		Interpreter* interpreter;
+
+		AbstractSyntaxTree<void, Value> compile(std::string_view source);
+	};
+}
@@ -0,0 +1,43 @@
+#include "PittaShape.hpp"
+#include "PittaValue.hpp"
+#include <mutex>
+
+namespace pitta {
+
+	//The classes bound from C++ are shared by every isolate, so their shapes can grow from several threads.
+	//Only a cache miss gets this far, so one lock for every shape is enough
+	static std::mutex s_transitionMutex;
+
+	uint16_t Shape::find(Symbol name)const {
+		auto slot = slots.find(name);
+		if (slot == slots.end())
+			return c_noSlot;
+		return slot->second;
+	}
+
+	uint16_t Shape::getFieldCount()const {
+		return uint16_t(slots.size());
+	}
+
+	const Shape* Shape::withField(Symbol name)const {
+		std::lock_guard<std::mutex> lock(s_transitionMutex);
+		auto transition = transitions.find(name);
+		if (transition != transitions.end())
+			return transition->second;
+
+		if (slots.size() >= c_noSlot)
+			throw new PittaRuntimeException("Too many fields on one instance.");
+
+		Shape* next = new Shape();
+		next->slots = slots;
+		next->slots.emplace(name, getFieldCount());
+		transitions.emplace(name, next);
+		return next;
+	}
+
+	Shape::~Shape() {
+		for (auto& [_, shape] : transitions)
+			release(shape);
+	}
+
+}
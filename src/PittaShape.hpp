@@ -0,0 +1,47 @@
+#pragma once
+#include <unordered_map>
+#include <atomic>
+#include <stdint.h>
+#include "PittaStringTable.hpp"
+
+namespace pitta {
+
+	//Describes which fields an instance has and the slot each is stored in. Instances that had the same fields
+	//added in the same order share a shape; each class owns the tree of shapes its instances move through.
+	//A shape is counted, so a property cache can keep one alive after its class is freed, and a new shape can't
+	//take its address while an entry for it is still around
+	class Shape {
+	public:
+		static constexpr uint16_t c_noSlot = UINT16_MAX;
+
+		//Returns c_noSlot if instances of this shape have no field with the name
+		uint16_t find(Symbol name)const;
+
+		uint16_t getFieldCount()const;
+
+		//The shape an instance moves to when the field is added, created the first time any instance needs it.
+		//The new field always takes the next slot
+		const Shape* withField(Symbol name)const;
+
+		//A new shape starts with one reference, held by whoever created it
+		static void retain(const Shape* shape) {
+			shape->references.fetch_add(1, std::memory_order_relaxed);
+		}
+		static void release(const Shape* shape) {
+			if (shape->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				delete shape;
+		}
+
+		Shape() = default;
+		Shape(const Shape&) = delete;
+
+	private:
+		std::unordered_map<Symbol, uint16_t> slots;
+		//Each shape holds a reference to the shapes it leads to
+		mutable std::unordered_map<Symbol, Shape*> transitions;
+		mutable std::atomic<uint32_t> references{ 1 };
+
+		~Shape();
+	};
+
+}
@@ -4,8 +4,11 @@
 namespace pitta {
 
     template<class T, class R>class Block;
+    template<class T, class R>class Break;
     template<class T, class R>class ClassStmt;
+    template<class T, class R>class Continue;
     template<class T, class R>class Expression;
+    template<class T, class R>class For;
     template<class T, class R>class FunctionStmt;
     template<class T, class R> class If;
     template<class T, class R>class Print;
@@ -17,8 +20,11 @@ namespace pitta {
 	class StatementVisitor {
     public:
         virtual T visitBlockStmt(Block<T, R>* stmt) = 0;
+        virtual T visitBreakStmt(Break<T, R>* stmt) = 0;
         virtual T visitClassStmt(ClassStmt<T, R>* stmt) = 0;
+        virtual T visitContinueStmt(Continue<T, R>* stmt) = 0;
         virtual T visitExpressionStmt(Expression<T, R>* stmt) = 0;
+        virtual T visitForStmt(For<T, R>* stmt) = 0;
         virtual T visitFunctionStmt(FunctionStmt<T, R>* stmt) = 0;
         virtual T visitIfStmt(If<T, R>* stmt) = 0;
         virtual T visitPrintStmt(Print<T, R>* stmt) = 0;
@@ -42,6 +48,10 @@ namespace pitta {
     public:
         std::vector<Stmt<T, R>*> statements;
 
+        //Slots in this block's environment, filled in by the resolver. 0 when the block runs in the enclosing
+        //environment, because it declares nothing or nothing in it can capture its variables
+        uint16_t localCount = 0;
+
         T accept(StatementVisitor<T, R>* visitor) {
             return visitor->visitBlockStmt(this);
         }
@@ -52,6 +62,20 @@ namespace pitta {
 
     };
 
+    template<class T, class R>
+    class Break : public Stmt<T, R> {
+    public:
+        Token keyword;
+
+        T accept(StatementVisitor<T, R>* visitor) {
+            return visitor->visitBreakStmt(this);
+        }
+
+        Break(const Token& keyword) :
+            keyword(keyword)
+        {}
+    };
+
     template<class T, class R>
     class ClassStmt : public Stmt<T, R> {
     public:
@@ -59,6 +83,8 @@ namespace pitta {
         Variable<R>* superclass;
         std::vector<FunctionStmt<T, R>*> methods;
 
+        uint16_t variableId = c_globalVariable;
+
         T accept(StatementVisitor<T, R>* visitor) {
             return visitor->visitClassStmt(this);
         }
@@ -70,6 +96,20 @@ namespace pitta {
         {}
     };
 
+    template<class T, class R>
+    class Continue : public Stmt<T, R> {
+    public:
+        Token keyword;
+
+        T accept(StatementVisitor<T, R>* visitor) {
+            return visitor->visitContinueStmt(this);
+        }
+
+        Continue(const Token& keyword) :
+            keyword(keyword)
+        {}
+    };
+
     template<class T, class R>
     class Expression : public Stmt<T, R> {
     public:
@@ -85,6 +125,30 @@ namespace pitta {
 
     };
 
+    template<class T, class R>
+    class For : public Stmt<T, R> {
+    public:
+        //Any of these but the body can be left out
+        Stmt<T, R>* initializer;
+        Expr<R>* condition;
+        Expr<R>* increment;
+        Stmt<T, R>* body;
+
+        //Slots in the environment the loop variable gets for the whole loop, or 0 when it doesn't need one
+        uint16_t localCount = 0;
+
+        T accept(StatementVisitor<T, R>* visitor) {
+            return visitor->visitForStmt(this);
+        }
+
+        For(Stmt<T, R>* initializer, Expr<R>* condition, Expr<R>* increment, Stmt<T, R>* body) :
+            initializer(initializer),
+            condition(condition),
+            increment(increment),
+            body(body)
+        {}
+    };
+
     template<class T, class R>
     class FunctionStmt : public Stmt<T, R> {
     public:
@@ -92,7 +156,9 @@ namespace pitta {
         std::vector<Token> params;
         std::vector<Stmt<T, R>*> body;
 
-        uint16_t variableId;
+        uint16_t variableId = c_globalVariable;
+        //Parameters and variables declared at the top level of the body
+        uint16_t localCount = 0;
 
         T accept(StatementVisitor<T, R>* visitor) {
             return visitor->visitFunctionStmt(this);
@@ -161,6 +227,8 @@ namespace pitta {
         Token name;
         Expr<R>* initializer;
 
+        uint16_t variableId = c_globalVariable;
+
         T accept(StatementVisitor<T, R>* visitor) {
             return visitor->visitVarStmt(this);
         }
@@ -202,12 +270,26 @@ namespace pitta {
             ret += "\n" + getTabbedOut() = ">";
             return ret;
         }
+        std::string visitBreakStmt(Break<std::string, std::string>* stmt) {
+            return getTabbedOut() + "<break>";
+        }
         std::string visitClassStmt(ClassStmt<std::string, std::string>* stmt) {
-            return "Class: " + stmt->name.lexeme;
+            return "Class: " + stmt->name.lexeme.str();
+        }
+        std::string visitContinueStmt(Continue<std::string, std::string>* stmt) {
+            return getTabbedOut() + "<continue>";
         }
         std::string visitExpressionStmt(Expression<std::string, std::string>* stmt) {
             return getTabbedOut() + "<expr : " + stmt->expression->accept(&exprPrinter) + " >";
         }
+        std::string visitForStmt(For<std::string, std::string>* stmt) {
+            std::string ret = getTabbedOut() + "<for : " + (stmt->condition != nullptr ? stmt->condition->accept(&exprPrinter) : "");
+            numOfTabsIn += 1;
+            ret += "\n" + stmt->body->accept(this);
+            numOfTabsIn -= 1;
+            ret += "\n" + getTabbedOut() + ">";
+            return ret;
+        }
         std::string visitFunctionStmt(FunctionStmt<std::string, std::string>* stmt) {
             return "";
         }
@@ -222,7 +304,7 @@ namespace pitta {
             return "<return: " + stmt->value->accept(&exprPrinter) + ">";
         }
         std::string visitVarStmt(Var<std::string, std::string>* stmt) {
-            return getTabbedOut() + "<var : " + stmt->name.lexeme + (stmt->initializer == nullptr ? "" : (" : " + stmt->initializer->accept(&exprPrinter))) + " >";
+            return getTabbedOut() + "<var : " + stmt->name.lexeme.str() + (stmt->initializer == nullptr ? "" : (" : " + stmt->initializer->accept(&exprPrinter))) + " >";
         }
         std::string visitWhileStmt(While<std::string, std::string>* stmt) {
             std::string ret = getTabbedOut() + "<while : " + stmt->condition->accept(&exprPrinter);
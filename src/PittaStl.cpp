@@ -1,66 +1,138 @@
 #include "PittaStl.hpp"
+#include "PittaArray.hpp"
+#include "PittaMap.hpp"
 
 
 namespace pitta {
     namespace stl {
 
-        //typedef Value(*FunctionSigniture)(Interpreter*, const std::vector<Value>&);
+        //typedef Value(*FunctionSigniture)(Interpreter*, Arguments);
 
-        Value toInt(Interpreter*, const std::vector<Value>& values) {
+        Value toInt(Interpreter*, Arguments values) {
             const Value& val = values[0];
             if (val.getType() == String) {
                 return std::stoi(val.asString());
             }
             return val.asInt();
         }
-        Value toFloat(Interpreter*, const std::vector<Value>& values) {
+        Value toFloat(Interpreter*, Arguments values) {
             const Value& val = values[0];
             if (val.getType() == String) {
                 return std::stof(val.asString());
             }
             return val.asInt();
         }
-        Value toString(Interpreter*, const std::vector<Value>& values) {
+        Value toString(Interpreter* interpreter, Arguments values) {
             const Value& val = values[0];
             if (val.getType() == String) {
-                return val.asString();
+                return val.unbound(interpreter->getHeap());
             }
-            return val.toString();
+            return interpreter->getHeap().makeString(val.toString());
         }
-        Value toBool(Interpreter*, const std::vector<Value>& values) {
+        Value toBool(Interpreter*, Arguments values) {
             const Value& val = values[0];
             return val.isTruthy();
         }
 
-        Value inputLine(Interpreter*, const std::vector<Value>& values) {
+        Value inputLine(Interpreter* interpreter, Arguments values) {
             std::string line;
             std::getline(std::cin, line);
-            return line;
+            return interpreter->getHeap().makeString(std::move(line));
         }
 
-        void addGlobalVariables(std::shared_ptr<Environment>& environment) {
+        Value length(Interpreter*, Arguments values) {
+            const Value& val = values[0];
+            if (val.getType() == Array)
+                return int(val.asArray()->size());
+            if (val.getType() == Map)
+                return int(val.asMap()->size());
+            if (val.getType() == String)
+                return int(val.asString().size());
+            throw new PittaRuntimeException("Only arrays, maps and strings have a length, not " + c_typeToString.at(val.getType()) + ".");
+        }
+        Value arrayPush(Interpreter* interpreter, Arguments values) {
+            if (values[0].getType() != Array)
+                throw new PittaRuntimeException("Can only push onto an array.");
+            values[0].asArray()->push(values[1].unbound(interpreter->getHeap()));
+            return Null;
+        }
+        Value arrayPop(Interpreter*, Arguments values) {
+            if (values[0].getType() != Array)
+                throw new PittaRuntimeException("Can only pop from an array.");
+            return values[0].asArray()->pop();
+        }
+
+        //Iterating a map goes through an array of its keys or values, in the order they were added
+        Value mapKeys(Interpreter* interpreter, Arguments values) {
+            if (values[0].getType() != Map)
+                throw new PittaRuntimeException("Can only get the keys of a map.");
+            const MapObject* map = values[0].asMap();
+            ArrayObject* keys = interpreter->getHeap().track(new ArrayObject());
+            keys->reserve(map->size());
+            map->forEach([keys](const MapObject::Entry& entry) { keys->push(entry.key); });
+            return keys;
+        }
+        Value mapValues(Interpreter* interpreter, Arguments values) {
+            if (values[0].getType() != Map)
+                throw new PittaRuntimeException("Can only get the values of a map.");
+            const MapObject* map = values[0].asMap();
+            ArrayObject* mapValues = interpreter->getHeap().track(new ArrayObject());
+            mapValues->reserve(map->size());
+            map->forEach([mapValues](const MapObject::Entry& entry) { mapValues->push(entry.value); });
+            return mapValues;
+        }
+        Value mapHas(Interpreter*, Arguments values) {
+            if (values[0].getType() != Map)
+                throw new PittaRuntimeException("Can only look for keys in a map.");
+            return values[0].asMap()->contains(values[1]);
+        }
+        Value mapRemove(Interpreter*, Arguments values) {
+            if (values[0].getType() != Map)
+                throw new PittaRuntimeException("Can only remove keys from a map.");
+            return values[0].asMap()->remove(values[1]);
+        }
+
+        void addGlobalVariables(shared_data<Environment>& environment) {
             environment->assign("Null", Null);
             environment->assign("Undefined", Undefined);
         }
 
-        /*const NativeCallable toIntCallable(1, toInt);
-        const NativeCallable toFloatCallable(1, toFloat);
-        const NativeCallable toStringCallable(1, toString);
-        const NativeCallable toBoolCallable(1, toBool);
+        const NativeCallable* const toIntCallable = Heap::permanent(new NativeCallable(1, toInt));
+        const NativeCallable* const toFloatCallable = Heap::permanent(new NativeCallable(1, toFloat));
+        const NativeCallable* const toStringCallable = Heap::permanent(new NativeCallable(1, toString));
+        const NativeCallable* const toBoolCallable = Heap::permanent(new NativeCallable(1, toBool));
+
+        const NativeCallable* const inputLineCallable = Heap::permanent(new NativeCallable(0, inputLine));
 
-        const NativeCallable inputLineCallable(0, inputLine);*/
+        const NativeCallable* const lengthCallable = Heap::permanent(new NativeCallable(1, length));
+        const NativeCallable* const arrayPushCallable = Heap::permanent(new NativeCallable(2, arrayPush));
+        const NativeCallable* const arrayPopCallable = Heap::permanent(new NativeCallable(1, arrayPop));
+
+        const NativeCallable* const mapKeysCallable = Heap::permanent(new NativeCallable(1, mapKeys));
+        const NativeCallable* const mapValuesCallable = Heap::permanent(new NativeCallable(1, mapValues));
+        const NativeCallable* const mapHasCallable = Heap::permanent(new NativeCallable(2, mapHas));
+        const NativeCallable* const mapRemoveCallable = Heap::permanent(new NativeCallable(2, mapRemove));
 
         shared_data<Environment> getEnvironment() {
             shared_data<Environment> environment = make_shared_data<Environment>();
             addGlobalVariables(environment);
 
-            environment->define("int", &toIntCallable);
-            environment->define("float", &toFloatCallable);
-            environment->define("string", &toStringCallable);
-            environment->define("str", &toStringCallable);
-            environment->define("bool", &toBoolCallable);
+            environment->define("int", toIntCallable);
+            environment->define("float", toFloatCallable);
+            environment->define("string", toStringCallable);
+            environment->define("str", toStringCallable);
+            environment->define("bool", toBoolCallable);
+
+            environment->define("input", inputLineCallable);
+
+            environment->define("len", lengthCallable);
+            environment->define("push", arrayPushCallable);
+            environment->define("pop", arrayPopCallable);
 
-            environment->define("input", &inputLineCallable);
+            environment->define("keys", mapKeysCallable);
+            environment->define("values", mapValuesCallable);
+            environment->define("has", mapHasCallable);
+            environment->define("remove", mapRemoveCallable);
 
             return environment;
         }
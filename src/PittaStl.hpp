@@ -4,24 +4,44 @@
 namespace pitta{
     namespace stl{
 
-        //typedef Value(*FunctionSigniture)(Interpreter*, const std::vector<Value>&);
+        //typedef Value(*FunctionSigniture)(Interpreter*, Arguments);
 
-        Value toInt(Interpreter*, const std::vector<Value>& values);
-        Value toFloat(Interpreter*, const std::vector<Value>& values);
-        Value toString(Interpreter*, const std::vector<Value>& values);
-        Value toBool(Interpreter*, const std::vector<Value>& values);
+        Value toInt(Interpreter*, Arguments values);
+        Value toFloat(Interpreter*, Arguments values);
+        Value toString(Interpreter*, Arguments values);
+        Value toBool(Interpreter*, Arguments values);
 
-        Value inputLine(Interpreter*, const std::vector<Value>& values);
+        Value inputLine(Interpreter*, Arguments values);
+
+        Value length(Interpreter*, Arguments values);
+        Value arrayPush(Interpreter*, Arguments values);
+        Value arrayPop(Interpreter*, Arguments values);
+
+        Value mapKeys(Interpreter* interpreter, Arguments values);
+        Value mapValues(Interpreter* interpreter, Arguments values);
+        Value mapHas(Interpreter*, Arguments values);
+        Value mapRemove(Interpreter*, Arguments values);
 
         void addGlobalVariables(shared_data<Environment>& environment);
 
-        const NativeCallable toIntCallable(1, toInt);
-        const NativeCallable toFloatCallable(1, toFloat);
-        const NativeCallable toStringCallable(1, toString);
-        const NativeCallable toBoolCallable(1, toBool);
+        //Made once and shared by every isolate, so no heap ever marks them
+        extern const NativeCallable* const toIntCallable;
+        extern const NativeCallable* const toFloatCallable;
+        extern const NativeCallable* const toStringCallable;
+        extern const NativeCallable* const toBoolCallable;
+
+        extern const NativeCallable* const inputLineCallable;
+
+        extern const NativeCallable* const lengthCallable;
+        extern const NativeCallable* const arrayPushCallable;
+        extern const NativeCallable* const arrayPopCallable;
 
-        const NativeCallable inputLineCallable(0, inputLine);
+        extern const NativeCallable* const mapKeysCallable;
+        extern const NativeCallable* const mapValuesCallable;
+        extern const NativeCallable* const mapHasCallable;
+        extern const NativeCallable* const mapRemoveCallable;
 
+        //A new global environment, for one isolate
         shared_data<Environment> getEnvironment();
     }
 }
\ No newline at end of file
@@ -0,0 +1,37 @@
+#include "PittaStringTable.hpp"
+
+namespace pitta {
+
+	const std::string* StringTable::intern(const std::string& text) {
+		return intern(std::string_view(text));
+	}
+	const std::string* StringTable::intern(std::string_view text) {
+		{
+			std::shared_lock<std::shared_mutex> lock(mutex);
+			auto found = index.find(text);
+			if (found != index.end())
+				return found->second;
+		}
+
+		std::unique_lock<std::shared_mutex> lock(mutex);
+		//Another thread may have added it since the shared lock was let go
+		auto found = index.find(text);
+		if (found != index.end())
+			return found->second;
+
+		const std::string& added = strings.emplace_back(text);
+		index.emplace(added, &added);
+		return &added;
+	}
+
+	size_t StringTable::size()const {
+		std::shared_lock<std::shared_mutex> lock(mutex);
+		return strings.size();
+	}
+
+	StringTable& StringTable::current() {
+		static StringTable table;
+		return table;
+	}
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <deque>
+#include <functional>
+#include <shared_mutex>
+#include <mutex>
+
+namespace pitta {
+
+	//Holds a single immutable copy of every distinct identifier and literal in the scripts, and of the names C++ binds.
+	//Symbols and literal values refer to them by a pointer into the table, so two interned strings are equal only if
+	//their pointers are. Strings made while a script runs never come here; they belong to the heap that made them.
+	//Safe to use from several threads at once. The table only grows while scripts are compiled, and strings already
+	//in it are found under a shared lock
+	class StringTable {
+	public:
+		//Returns the table's copy of the text, adding it if this is the first time it has been seen
+		const std::string* intern(const std::string& text);
+		//Looks the text up without making a string for it, so source can be interned straight out of its buffer
+		const std::string* intern(std::string_view text);
+
+		size_t size()const;
+
+		//The table identifiers, names and literals are interned into. Integrated classes intern their
+		//method and field names when they are created, which can be before any script runs, so it is shared
+		//by every isolate
+		static StringTable& current();
+
+		StringTable() = default;
+		StringTable(const StringTable&) = delete;
+
+	private:
+		//A deque never moves what it holds, so pointers to the strings, and views of them, stay valid as it grows
+		std::deque<std::string> strings;
+		std::unordered_map<std::string_view, const std::string*> index;
+		mutable std::shared_mutex mutex;
+	};
+
+	//An interned name. Comparing and hashing one only looks at the pointer, never the characters
+	class Symbol {
+	public:
+		const std::string& str()const {
+			return *text;
+		}
+		operator const std::string& ()const {
+			return *text;
+		}
+
+		bool operator==(const Symbol& other)const {
+			return text == other.text;
+		}
+		bool operator!=(const Symbol& other)const {
+			return text != other.text;
+		}
+
+		Symbol(const std::string& name) :
+			text(StringTable::current().intern(name))
+		{}
+		Symbol(const char* name) :
+			text(StringTable::current().intern(std::string_view(name)))
+		{}
+		explicit Symbol(std::string_view name) :
+			text(StringTable::current().intern(name))
+		{}
+		//For strings that already came out of the table
+		explicit Symbol(const std::string* interned) :
+			text(interned)
+		{}
+
+	private:
+		const std::string* text;
+
+		friend struct std::hash<Symbol>;
+	};
+
+}
+
+namespace std {
+	template<>
+	struct hash<pitta::Symbol> {
+		size_t operator()(const pitta::Symbol& symbol)const {
+			return hash<const std::string*>()(symbol.text);
+		}
+	};
+}
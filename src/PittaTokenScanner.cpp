@@ -1,52 +1,192 @@
 #include "PittaTokenScanner.hpp"
 #include "PittaRuntime.hpp"
+#include <charconv>
+#include <array>
+#include <string.h>
+
+//Whitespace and string literals are scanned sixteen characters at a time where SSE2 is available
+#if !defined(PITTA_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define PITTA_SCANNER_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 namespace pitta {
 
-	//These characters always result in tokens on their own. Chars like '=' could be a "==", so
-	//will be handled inside of the scanner
-	const std::unordered_map<char, TokenType> c_oneCharTokens = {
-		{ '(', LEFT_PAREN },
-		{ ')', RIGHT_PAREN },
-		{ '{', LEFT_BRACE },
-		{ '}', RIGHT_BRACE },
-		{ ',', COMMA },
-		{ '.', DOT },
-		{ '-', MINUS },
-		{ '%', PERCENT },
-		{ '^', BIT_XOR },
-		{ '~', BIT_NOT },
-		{ ';', SEMICOLON },
-		{ '*', STAR },
-		{ '/', SLASH}
+	//What each byte can be part of, so classifying a character is a single table load
+	enum CharClass : uint8_t {
+		c_charDigit = 1 << 0,
+		c_charHexDigit = 1 << 1,
+		c_charIdentifierStart = 1 << 2,
+		c_charIdentifierPart = 1 << 3,
+		c_charWhitespace = 1 << 4
 	};
 
+	static constexpr std::array<uint8_t, 256> makeCharClasses() {
+		std::array<uint8_t, 256> classes{};
+		for (int c = '0'; c <= '9'; c++)
+			classes[c] = c_charDigit | c_charHexDigit | c_charIdentifierPart;
+		for (int c = 'A'; c <= 'F'; c++)
+			classes[c] |= c_charHexDigit;
+		for (int c = 'a'; c <= 'z'; c++)
+			classes[c] = c_charIdentifierStart | c_charIdentifierPart;
+		for (int c = 'A'; c <= 'Z'; c++)
+			classes[c] |= c_charIdentifierStart | c_charIdentifierPart;
+		classes['_'] = c_charIdentifierStart | c_charIdentifierPart;
+		classes[' '] = classes['\t'] = classes['\r'] = classes['\n'] = c_charWhitespace;
+		return classes;
+	}
+	static constexpr std::array<uint8_t, 256> c_charClasses = makeCharClasses();
+
+	//These characters always result in tokens on their own. Chars like '=' could be a "==", so
+	//will be handled inside of the scanner. END_OF_FILE marks every other character
+	static constexpr std::array<TokenType, 256> makeOneCharTokens() {
+		std::array<TokenType, 256> tokens{};
+		for (TokenType& token : tokens)
+			token = END_OF_FILE;
+		tokens['('] = LEFT_PAREN;
+		tokens[')'] = RIGHT_PAREN;
+		tokens['{'] = LEFT_BRACE;
+		tokens['}'] = RIGHT_BRACE;
+		tokens['['] = LEFT_BRACKET;
+		tokens[']'] = RIGHT_BRACKET;
+		tokens[','] = COMMA;
+		tokens['.'] = DOT;
+		tokens['-'] = MINUS;
+		tokens['%'] = PERCENT;
+		tokens['^'] = BIT_XOR;
+		tokens['~'] = BIT_NOT;
+		tokens[';'] = SEMICOLON;
+		tokens[':'] = COLON;
+		tokens['*'] = STAR;
+		tokens['/'] = SLASH;
+		return tokens;
+	}
+	static constexpr std::array<TokenType, 256> c_oneCharTokens = makeOneCharTokens();
+
 	const std::string c_classSelfReferenceKey = "this";
-	const std::unordered_map<std::string, TokenType> keywords = {
-		{ "and", AND },
-		{ "class", CLASS },
-		{ "do", DO },
-		{ "else", ELSE },
-		{ "false", FALSE },
-		{ "func", FUNC },
-		{ "for", FOR },
-		{ "if", IF },
-		{ "null", NIL },
-		{ "or", OR },
-		{ "print", PRINT },
-		{ "return", RETURN },
-		{ "super", SUPER },
-		{ c_classSelfReferenceKey, THIS },
-		{ "true", TRUE },
-		{ "undefined", UNDEFINED },
-		{ "var", VAR },
-		{ "while", WHILE },
-	};
+
+	//A switch on the first letters picks the only keyword the text could be, so it takes at most one comparison
+	static TokenType keywordType(std::string_view text) {
+		const auto check = [&text](size_t start, std::string_view rest, TokenType type) {
+			return text.size() == start + rest.size() && text.compare(start, rest.size(), rest) == 0 ? type : IDENTIFIER;
+		};
+
+		switch (text[0]) {
+		case 'a': return check(1, "nd", AND);
+		case 'b': return check(1, "reak", BREAK);
+		case 'c':
+			if (text.size() > 1) {
+				switch (text[1]) {
+				case 'l': return check(2, "ass", CLASS);
+				case 'o': return check(2, "ntinue", CONTINUE);
+				}
+			}
+			break;
+		case 'd': return check(1, "o", DO);
+		case 'e': return check(1, "lse", ELSE);
+		case 'f':
+			if (text.size() > 1) {
+				switch (text[1]) {
+				case 'a': return check(2, "lse", FALSE);
+				case 'o': return check(2, "r", FOR);
+				case 'u': return check(2, "nc", FUNC);
+				}
+			}
+			break;
+		case 'i': return check(1, "f", IF);
+		case 'n': return check(1, "ull", NIL);
+		case 'o': return check(1, "r", OR);
+		case 'p': return check(1, "rint", PRINT);
+		case 'r': return check(1, "eturn", RETURN);
+		case 's': return check(1, "uper", SUPER);
+		case 't':
+			if (text.size() > 1) {
+				switch (text[1]) {
+				case 'h': return check(2, "is", THIS);
+				case 'r': return check(2, "ue", TRUE);
+				}
+			}
+			break;
+		case 'u': return check(1, "ndefined", UNDEFINED);
+		case 'v': return check(1, "ar", VAR);
+		case 'w': return check(1, "hile", WHILE);
+		}
+		return IDENTIFIER;
+	}
+
+	static int countTrailingZeros(unsigned int mask) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return int(index);
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+	static int countBits(unsigned int mask) {
+#ifdef _MSC_VER
+		return int(__popcnt(mask));
+#else
+		return __builtin_popcount(mask);
+#endif
+	}
+
+	//How many characters at the start of text are whitespace, adding the newlines among them to newlines.
+	//Looks at sixteen characters at a time where SSE2 is available
+	static size_t whitespaceRun(const char* text, size_t length, int& newlines) {
+		size_t i = 0;
+#ifdef PITTA_SCANNER_SSE2
+		const __m128i space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'), carriage = _mm_set1_epi8('\r'), newline = _mm_set1_epi8('\n');
+		for (; i + 16 <= length; i += 16) {
+			const __m128i chunk = _mm_loadu_si128((const __m128i*)(text + i));
+			const __m128i isNewline = _mm_cmpeq_epi8(chunk, newline);
+			const __m128i isWhitespace = _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)),
+				_mm_or_si128(_mm_cmpeq_epi8(chunk, carriage), isNewline));
+
+			const unsigned int newlineMask = _mm_movemask_epi8(isNewline);
+			const unsigned int otherMask = ~_mm_movemask_epi8(isWhitespace) & 0xFFFF;
+			if (otherMask != 0) {
+				const int run = countTrailingZeros(otherMask);
+				newlines += countBits(newlineMask & ((1u << run) - 1));
+				return i + run;
+			}
+			newlines += countBits(newlineMask);
+		}
+#endif
+		for (; i < length && (c_charClasses[uint8_t(text[i])] & c_charWhitespace); i++) {
+			if (text[i] == '\n')
+				newlines += 1;
+		}
+		return i;
+	}
+
+	//Where the first of either character is in text, or length if neither are
+	static size_t findEither(const char* text, size_t length, char first, char second) {
+		size_t i = 0;
+#ifdef PITTA_SCANNER_SSE2
+		const __m128i firstChunk = _mm_set1_epi8(first), secondChunk = _mm_set1_epi8(second);
+		for (; i + 16 <= length; i += 16) {
+			const __m128i chunk = _mm_loadu_si128((const __m128i*)(text + i));
+			const unsigned int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, firstChunk), _mm_cmpeq_epi8(chunk, secondChunk)));
+			if (mask != 0)
+				return i + countTrailingZeros(mask);
+		}
+#endif
+		for (; i < length; i++) {
+			if (text[i] == first || text[i] == second)
+				return i;
+		}
+		return length;
+	}
 
 	/*
-		LEFT_PAREN, RIGHT_PAREN, LEFT_BRACE, RIGHT_BRACE, COMMA, DOT, SEMICOLON, MINUS, SLASH, STAR, PERCENT,
+		LEFT_PAREN, RIGHT_PAREN, LEFT_BRACE, RIGHT_BRACE, LEFT_BRACKET, RIGHT_BRACKET, COMMA, DOT, SEMICOLON, COLON, MINUS, SLASH, STAR, PERCENT,
 		BIT_OR, BIT_AND, BIT_XOR, BIT_NOT, BANG, BANG_EQUAL, EQUAL, EQUAL_EQUAL, GREATER, GREATER_EQUAL,
-		LESS, LESS_EQUAL, PLUS, STRING_CONCAT, IDENTIFIER, STRING, INT, FLOAT, AND, CLASS, DO, ELSE, FALSE, 
+		LESS, LESS_EQUAL, PLUS, STRING_CONCAT, IDENTIFIER, STRING, INT, FLOAT, AND, BREAK, CLASS, CONTINUE, DO, ELSE, FALSE, 
 		FUNC, FOR, IF, NIL, OR, PRINT, RETURN, SUPER, THIS, TRUE, UNDEFINED, VAR, WHILE, END_OF_FILE
 	*/
 
@@ -54,13 +194,13 @@ namespace pitta {
 
 	const std::unordered_map<TokenType, std::string> tokenNames = {
 		TOKEN_TO_STRING(LEFT_PAREN), TOKEN_TO_STRING(RIGHT_PAREN), TOKEN_TO_STRING(LEFT_BRACE), TOKEN_TO_STRING(RIGHT_BRACE),
-		TOKEN_TO_STRING(COMMA), TOKEN_TO_STRING(DOT), TOKEN_TO_STRING(SEMICOLON), TOKEN_TO_STRING(MINUS), TOKEN_TO_STRING(SLASH),
+		TOKEN_TO_STRING(LEFT_BRACKET), TOKEN_TO_STRING(RIGHT_BRACKET), TOKEN_TO_STRING(COMMA), TOKEN_TO_STRING(DOT), TOKEN_TO_STRING(SEMICOLON), TOKEN_TO_STRING(COLON), TOKEN_TO_STRING(MINUS), TOKEN_TO_STRING(SLASH),
 		TOKEN_TO_STRING(STAR), TOKEN_TO_STRING(PERCENT), TOKEN_TO_STRING(BIT_OR), TOKEN_TO_STRING(BIT_AND), TOKEN_TO_STRING(BIT_XOR),
 		TOKEN_TO_STRING(BIT_NOT), TOKEN_TO_STRING(BANG), TOKEN_TO_STRING(BANG_EQUAL), TOKEN_TO_STRING(EQUAL), TOKEN_TO_STRING(EQUAL_EQUAL),
 		TOKEN_TO_STRING(GREATER), TOKEN_TO_STRING(GREATER_EQUAL), TOKEN_TO_STRING(SHIFT_RIGHT), 
 		TOKEN_TO_STRING(LESS), TOKEN_TO_STRING(LESS_EQUAL), TOKEN_TO_STRING(SHIFT_LEFT), TOKEN_TO_STRING(PLUS),
 		TOKEN_TO_STRING(STRING_CONCAT), TOKEN_TO_STRING(IDENTIFIER), TOKEN_TO_STRING(STRING), TOKEN_TO_STRING(INT), TOKEN_TO_STRING(FLOAT),
-		TOKEN_TO_STRING(AND), TOKEN_TO_STRING(CLASS), TOKEN_TO_STRING(DO), TOKEN_TO_STRING(ELSE), TOKEN_TO_STRING(FALSE),
+		TOKEN_TO_STRING(AND), TOKEN_TO_STRING(BREAK), TOKEN_TO_STRING(CLASS), TOKEN_TO_STRING(CONTINUE), TOKEN_TO_STRING(DO), TOKEN_TO_STRING(ELSE), TOKEN_TO_STRING(FALSE),
 		TOKEN_TO_STRING(FUNC), TOKEN_TO_STRING(FOR), TOKEN_TO_STRING(IF), TOKEN_TO_STRING(NIL), TOKEN_TO_STRING(OR), TOKEN_TO_STRING(PRINT),
 		TOKEN_TO_STRING(RETURN), TOKEN_TO_STRING(SUPER), TOKEN_TO_STRING(THIS), TOKEN_TO_STRING(TRUE), TOKEN_TO_STRING(UNDEFINED),
 		TOKEN_TO_STRING(VAR), TOKEN_TO_STRING(WHILE), TOKEN_TO_STRING(END_OF_FILE)
@@ -76,7 +216,7 @@ namespace pitta {
 		return std::to_string(line) +": "+
 			tokenNames.at(type) + 
 			" '" + 
-			lexeme + 
+			lexeme.str() + 
 			"' [" +
 			value.toString() + 
 			"]";
@@ -86,45 +226,78 @@ namespace pitta {
 
 
 		TokenList Scanner::scanTokens() {
+			scanSpans();
+
+			TokenList tokens;
+			tokens.reserve(spans.size());
+			for (const TokenSpan& span : spans)
+				tokens.emplace_back(makeToken(span));
+			return tokens;
+		}
+
+		const std::vector<TokenSpan>& Scanner::scanSpans() {
+			if (!spans.empty())
+				return spans;
+
+			//Roughly one token for every five characters of source
+			spans.reserve(source.size() / 5 + 1);
 			while (!isAtEnd()) {
 				start = current;
 				scanToken();
 			}
 
-			tokens.emplace_back(END_OF_FILE, "", line, NIL);
+			start = current;
+			addToken(END_OF_FILE, NIL);
+			return spans;
+		}
 
-			return tokens;
+		std::string_view Scanner::getLexeme(const TokenSpan& span)const {
+			if (span.type == END_OF_FILE)
+				return std::string_view();
+			return source.substr(span.offset, span.length);
+		}
+
+		const Value& Scanner::getLiteral(const TokenSpan& span)const {
+			static const Value undefined = Undefined;
+			if (span.literal == TokenSpan::c_noLiteral)
+				return undefined;
+			return literals[span.literal];
+		}
+
+		Token Scanner::makeToken(const TokenSpan& span)const {
+			return Token(span.type, Symbol(getLexeme(span)), span.line, getLiteral(span));
 		}
 
-		Scanner::Scanner(const std::string& source, Runtime* runtime) :
+		Scanner::Scanner(std::string_view source, Runtime* runtime) :
 			runtime(runtime),
 			source(source)
 		{}
 		Scanner::Scanner(std::string&& source, Runtime* runtime) :
 			runtime(runtime),
-			source(std::move(source))
+			ownedSource(std::move(source)),
+			source(ownedSource)
 		{}
 
 
 
 		bool Scanner::isAtEnd()const {
-			return current >= source.size();
+			return size_t(current) >= source.size();
 		}
 
 		bool Scanner::isDigit(char c) {
-			return c >= '0' && c <= '9';
+			return c_charClasses[uint8_t(c)] & c_charDigit;
 		}
 
 		bool Scanner::isHexDigit(char c) {
-			return isDigit(c) || (c >= 'A' && c <= 'F');
+			return c_charClasses[uint8_t(c)] & c_charHexDigit;
 		}
 
 		bool Scanner::isAlphabeticalOrUnderscore(char c) {
-			return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'z') || (c == '_');
+			return c_charClasses[uint8_t(c)] & c_charIdentifierStart;
 		}
 
 		bool Scanner::isAlphaNumeric(char c) {
-			return isAlphabeticalOrUnderscore(c) || isDigit(c);
+			return c_charClasses[uint8_t(c)] & c_charIdentifierPart;
 		}
 
 
@@ -141,12 +314,17 @@ namespace pitta {
 		}
 
 		char Scanner::peekNext() {
-			if (current + 1 >= source.length()) return '\0';
+			if (size_t(current) + 1 >= source.length()) return '\0';
 			return source[current + 1];
 		}
 
 		void Scanner::addToken(TokenType type) {
-			addToken(type, Undefined);
+			spans.emplace_back(TokenSpan{ type, uint32_t(start), uint32_t(current - start), line, TokenSpan::c_noLiteral });
+		}
+
+		void Scanner::addToken(TokenType type, const Value& literal) {
+			spans.emplace_back(TokenSpan{ type, uint32_t(start), uint32_t(current - start), line, uint32_t(literals.size()) });
+			literals.emplace_back(literal);
 		}
 
 
@@ -159,9 +337,12 @@ namespace pitta {
 		}
 
 		void Scanner::scanStringLiteral() {
-			while (peek() != '"' && !isAtEnd()) {
-				if (peek() == '\n') line++;
-				advance();
+			while (!isAtEnd()) {
+				current += int(findEither(source.data() + current, source.size() - current, '"', '\n'));
+				if (isAtEnd() || source[current] == '"')
+					break;
+				line += 1;
+				current += 1;
 			}
 
 			if (isAtEnd()) {
@@ -173,8 +354,7 @@ namespace pitta {
 			advance();
 
 			// Trim the surrounding quotes.
-			std::string value = getSubstring(source, start + 1, current - 1);
-			addToken(STRING, value);
+			addToken(STRING, Symbol(source.substr(start + 1, current - 2 - start)));
 		}
 
 		void Scanner::scanNumericLiteral(char c) {
@@ -221,33 +401,50 @@ namespace pitta {
 				}
 			}
 
-			std::string stringRepresentation = getSubstring(source, start, current);
-
-			if (isFloat)
-				addToken<float>(FLOAT, std::atof(stringRepresentation.c_str()));
+			//Read straight out of the source, which isn't null terminated
+			const char* first = source.data() + start;
+			const char* last = source.data() + current;
+			if (isFloat) {
+				float value = 0.0f;
+				std::from_chars(first, last, value);
+				addToken(FLOAT, value);
+			}
 			else {
+				int value = 0;
 				if (isHex || isBin)
-					addToken<int>(INT, std::strtol(stringRepresentation.substr(2).c_str(), NULL, isHex ? 16 : 2));
+					std::from_chars(first + 2, last, value, isHex ? 16 : 2);
 				else
-					addToken<int>(INT, std::atoi(stringRepresentation.c_str()));
+					std::from_chars(first, last, value);
+				addToken(INT, value);
 			}
 		}
 
+		void Scanner::skipWhitespace() {
+			current += int(whitespaceRun(source.data() + current, source.size() - current, line));
+		}
+
+		void Scanner::skipComment() {
+			//memchr is vectorised by the standard library
+			const void* newline = memchr(source.data() + current, '\n', source.size() - current);
+			current = newline != nullptr ? int((const char*)newline - source.data()) : int(source.size());
+		}
+
 		void Scanner::scanIdentifier() {
 			while (isAlphaNumeric(peek())) advance();
 
-			std::string text = getSubstring(source, start, current);
-			TokenType type = IDENTIFIER;
-			if (keywords.count(text) > 0)
-				type = keywords.at(text);
-			addToken(type);
+			addToken(keywordType(source.substr(start, current - start)));
 		}
 
 		void Scanner::scanToken() {
 			char c = advance();
 
-			if (c_oneCharTokens.count(c) > 0)
-				addToken(c_oneCharTokens.at(c));
+			const TokenType oneCharToken = c_oneCharTokens[uint8_t(c)];
+			if (oneCharToken != END_OF_FILE) {
+				if (c == '/' && peek() == '/')
+					skipComment();
+				else
+					addToken(oneCharToken);
+			}
 			else {
 				switch (c) {
 				case '!':
@@ -266,15 +463,16 @@ namespace pitta {
 					addToken(match('=') ? GREATER_EQUAL : (match('>') ? SHIFT_RIGHT : GREATER));
 					break;
 				case '#':
-					while (peek() != '\n' && !isAtEnd())
-						advance();
+					skipComment();
+					break;
 
 				case ' ':
 				case '\r':
 				case '\t':
-					break;	//Whitespace, ignore it
 				case '\n':
-					line += 1;
+					//Whitespace tends to come in runs, such as indentation, so it is skipped all at once
+					current -= 1;
+					skipWhitespace();
 					break;
 
 				case '"':
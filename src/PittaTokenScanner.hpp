@@ -1,9 +1,11 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
 #include <fstream>
 #include <unordered_map>
 #include <stdlib.h>
+#include <stdint.h>
 #include "PittaValue.hpp"
 
 namespace pitta {
@@ -15,8 +17,8 @@ namespace pitta {
 
 	enum TokenType {
 		// Single-character tokens.
-		LEFT_PAREN, RIGHT_PAREN, LEFT_BRACE, RIGHT_BRACE,
-		COMMA, DOT, SEMICOLON,
+		LEFT_PAREN, RIGHT_PAREN, LEFT_BRACE, RIGHT_BRACE, LEFT_BRACKET, RIGHT_BRACKET,
+		COMMA, DOT, SEMICOLON, COLON,
 		MINUS, SLASH, STAR, PERCENT,
 		BIT_OR, BIT_AND, BIT_XOR, BIT_NOT,
 
@@ -31,22 +33,16 @@ namespace pitta {
 		IDENTIFIER, STRING, INT, FLOAT,
 
 		// Keywords.
-		AND, BREAK, CLASS, DO, ELSE, FALSE, FUNC, FOR, IF, NIL, OR,
+		AND, BREAK, CLASS, CONTINUE, DO, ELSE, FALSE, FUNC, FOR, IF, NIL, OR,
 		PRINT, RETURN, SUPER, THIS, TRUE, UNDEFINED, VAR, WHILE,
 
 		END_OF_FILE
 	};
 
-	//These characters always result in tokens on their own. Chars like '=' could be a "==", so
-	//will be handled inside of the scanner
-	extern const std::unordered_map<char, TokenType> c_oneCharTokens;
-
-	extern const std::unordered_map<std::string, TokenType> keywords;
-
 	class Token {
 	public:
 		const TokenType type;
-		const std::string lexeme;
+		const Symbol lexeme;
 		const int line;
 
 		const Value& getLiteralValue();
@@ -54,7 +50,7 @@ namespace pitta {
 		std::string toString();
 
 		template<class T>
-		Token(TokenType type, const std::string& lexeme, int lineNum, const T& literalValue) :
+		Token(TokenType type, Symbol lexeme, int lineNum, const T& literalValue) :
 			type(type),
 			lexeme(lexeme),
 			line(lineNum)
@@ -68,19 +64,45 @@ namespace pitta {
 
 	typedef std::vector<Token> TokenList;
 
+	//A token as a span of the source it came from. Nothing is owned, so scanning into these never allocates
+	//per token. Literal values are kept by the scanner, and found with the literal index
+	struct TokenSpan {
+		static constexpr uint32_t c_noLiteral = UINT32_MAX;
+
+		TokenType type;
+		uint32_t offset;
+		uint32_t length;
+		int line;
+		uint32_t literal;
+	};
+
 	class Scanner {
 	public:
 
 		TokenList scanTokens();
 
-		Scanner(const std::string& source, Runtime* runtime);
+		//Scans the whole source as spans, without making any Tokens
+		const std::vector<TokenSpan>& scanSpans();
+
+		std::string_view getLexeme(const TokenSpan& span)const;
+		//Undefined for tokens without a literal
+		const Value& getLiteral(const TokenSpan& span)const;
+		Token makeToken(const TokenSpan& span)const;
+
+		//Only views the source, which has to outlive the scanner and any spans it gives out.
+		//Works just as well over a memory mapped file
+		Scanner(std::string_view source, Runtime* runtime);
+		//Keeps the source itself
 		Scanner(std::string&& source, Runtime* runtime);
+		Scanner(const Scanner&) = delete;
 
 	private:
 		Runtime*const runtime;
 
-		const std::string source;
-		TokenList tokens;
+		const std::string ownedSource;
+		const std::string_view source;
+		std::vector<TokenSpan> spans;
+		std::vector<Value> literals;
 
 		int start = 0;
 		int current = 0;
@@ -104,10 +126,7 @@ namespace pitta {
 
 		void addToken(TokenType type);
 
-		template<class T>
-		void addToken(TokenType type, const T& value) {
-			tokens.emplace_back(type, getSubstring(source, start, current), line, value);
-		}
+		void addToken(TokenType type, const Value& literal);
 
 		bool match(char expected);
 
@@ -117,6 +136,11 @@ namespace pitta {
 
 		void scanIdentifier();
 
+		void skipWhitespace();
+
+		//Comments start with '#' or "//" and run to the end of the line
+		void skipComment();
+
 		void scanToken();
 	};
 }
\ No newline at end of file
@@ -0,0 +1,735 @@
+#include "PittaVM.hpp"
+#include "PittaCompiler.hpp"
+#include "PittaArray.hpp"
+#include "PittaMap.hpp"
+#include <typeinfo>
+#include <algorithm>
+
+//Threaded dispatch where the compiler supports labels as values, a plain switch everywhere else
+#if defined(__GNUC__) || defined(__clang__)
+#define PITTA_COMPUTED_GOTO
+#endif
+
+namespace pitta {
+
+	Value CompiledCallable::operator()(Interpreter* interpreter, Arguments arguments)const {
+		return vm->call(this, arguments);
+	}
+
+	Callable* CompiledCallable::bind(Instance* instance) {
+		CompiledCallable* boundCallable = new CompiledCallable(function, vm);
+		boundCallable->upvalues = upvalues;
+		boundCallable->boundInstance = instance;
+		return boundCallable;
+	}
+
+	void CompiledCallable::trace(Heap& heap)const {
+		for (const Upvalue* upvalue : upvalues)
+			heap.mark(upvalue);
+		heap.mark(boundInstance);
+	}
+
+	CompiledCallable::CompiledCallable(const CompiledFunction* function, VM* vm) :
+		Callable(function->arity, function->name),
+		function(function),
+		boundInstance(nullptr),
+		vm(vm)
+	{}
+
+
+
+	void VM::interpret(const std::vector<Stmt<void, Value>*>& statements) {
+		Compiler compiler(runtime);
+		CompiledFunction* script = compiler.compile(statements);
+		if (script == nullptr)
+			return;
+		scripts.emplace_back(script);
+
+		CompiledCallable* callable = heap.track(new CompiledCallable(script, this));
+
+		try {
+			call(callable, {});
+		}
+		catch (PittaRuntimeException* exception) {
+			resetStack();
+			runtime->runtimeError(exception);
+		}
+	}
+
+	Value VM::call(const CompiledCallable* callable, Arguments arguments) {
+		Value* const base = stackTop;
+		const int baseFrameCount = frameCount;
+		push(callable);
+		for (const Value& argument : arguments)
+			push(argument);
+
+		try {
+			callCompiled(callable, int(arguments.size()));
+			return run(frameCount - 1);
+		}
+		catch (PittaRuntimeException*) {
+			//Unwinds only this call, so whatever called in from C++ can carry on using the vm
+			closeUpvalues(base);
+			stackTop = base;
+			frameCount = baseFrameCount;
+			throw;
+		}
+	}
+
+	VM::VM(Interpreter* interpreter) :
+		interpreter(interpreter),
+		runtime(interpreter->getRuntime()),
+		globals(interpreter->getGlobals()),
+		heap(interpreter->getHeap())
+	{
+		stack.reserve(PITTA_VM_MAX_STACK);
+		stack.resize(c_frameStackSize * 4);
+		stackTop = stack.data();
+		frames.reserve(PITTA_VM_MAX_FRAMES);
+		frames.resize(64);
+		heap.addRootSource(this);
+	}
+
+	VM::~VM() {
+		heap.removeRootSource(this);
+		for (auto script : scripts)
+			delete script;
+	}
+
+
+
+	void VM::push(const Value& value) {
+		*stackTop = value;
+		stackTop += 1;
+	}
+
+	void VM::pop(size_t count) {
+		stackTop -= count;
+	}
+
+	Value& VM::peek(size_t distance) {
+		return stackTop[-1 - ptrdiff_t(distance)];
+	}
+
+	void VM::resetStack() {
+		stackTop = stack.data();
+		frameCount = 0;
+		openUpvalues = nullptr;
+	}
+
+	void VM::callValue(int argCount) {
+		const Value& callee = peek(argCount);
+		if (callee.getType() != Function && callee.getType() != ClassDef)
+			runtimeError("Can only call functions and classes.");
+
+		const Callable* callable = callee.asCallable();
+		checkArity(callable, argCount);
+
+		if (callee.getType() == Function) {
+			if (typeid(*callable) == typeid(CompiledCallable))
+				callCompiled(static_cast<const CompiledCallable*>(callable), argCount);
+			else
+				callNative(callable, argCount);
+			return;
+		}
+
+		//Script classes are constructed here so their initialiser runs on this stack; integrated classes
+		//know how to build themselves
+		const Class* classDef = callee.asClass();
+		if (typeid(*classDef) != typeid(Class)) {
+			callNative(classDef, argCount);
+			return;
+		}
+
+		Instance* newInstance = new Instance(classDef);
+		interpreter->registerNewInstance(newInstance);
+		peek(argCount) = Value(newInstance);
+
+		static const Symbol initName("init");
+		Callable* initialiser = classDef->findMethod(initName);
+		if (initialiser == nullptr)
+			pop(argCount);
+		else if (typeid(*initialiser) == typeid(CompiledCallable))
+			callCompiled(static_cast<const CompiledCallable*>(initialiser), argCount);
+		else {
+			Arguments arguments(stackTop - argCount, argCount);
+			initialiser->invoke(interpreter, newInstance, arguments);
+			pop(argCount);
+		}
+	}
+
+	void VM::invoke(Symbol name, PropertyCache& cache, int argCount) {
+		Value& receiver = peek(argCount);
+		if (receiver.getType() != ClassInstance)
+			runtimeError("On '" + name.str() + "': Only instances have properties.");
+
+		Instance* const instance = receiver.asInstance();
+		Value fieldValue;
+		Callable* method;
+		try {
+			method = instance->getMethod(name, cache, runtime->inlineCaches, fieldValue, heap);
+		}
+		catch (PittaRuntimeException* exception) {
+			const std::string details = exception->details;
+			delete exception;
+			runtimeError(details);
+		}
+		if (method == nullptr) {
+			receiver = fieldValue;
+			callValue(argCount);
+			return;
+		}
+
+		checkArity(method, argCount);
+		//The instance is already in the slot a method keeps "this" in
+		if (typeid(*method) == typeid(CompiledCallable)) {
+			callCompiled(static_cast<const CompiledCallable*>(method), argCount);
+			return;
+		}
+
+		Arguments arguments(stackTop - argCount, argCount);
+		Value result = method->invoke(interpreter, instance, arguments);
+		pop(argCount + 1);
+		push(result);
+	}
+
+	void VM::checkArity(const Callable* callable, int argCount) {
+		if (!callable->acceptsArgumentCount(argCount)) {
+			runtimeError("Incorrect number of arguments in function call. Passed in "
+				+ std::to_string(argCount) + ", expected "
+				+ std::to_string(callable->getArity()) + ".");
+		}
+	}
+
+	void VM::callCompiled(const CompiledCallable* callable, int argCount) {
+		if (frameCount == int(frames.size())) {
+			if (frames.size() == PITTA_VM_MAX_FRAMES)
+				runtimeError("Stack overflow.");
+			frames.resize(std::min<size_t>(frames.size() * 2, PITTA_VM_MAX_FRAMES));
+		}
+
+		//Inherited initialisers can be called with fewer arguments than they take
+		for (; argCount < callable->function->arity; argCount++)
+			push(Undefined);
+
+		Value* slots = stackTop - argCount - 1;
+		const size_t stackNeeded = size_t(slots - stack.data()) + c_frameStackSize;
+		if (stackNeeded > stack.size()) {
+			if (stackNeeded > PITTA_VM_MAX_STACK)
+				runtimeError("Stack overflow.");
+			stack.resize(std::min<size_t>(std::max(stackNeeded, stack.size() * 2), PITTA_VM_MAX_STACK));
+		}
+		if (callable->boundInstance != nullptr)
+			*slots = Value(callable->boundInstance);
+
+		CallFrame& frame = frames[frameCount];
+		frame.callable = callable;
+		frame.ip = callable->function->chunk.code.data();
+		frame.slots = slots;
+		frameCount += 1;
+	}
+
+	void VM::callNative(const Callable* callable, int argCount) {
+		Arguments arguments(stackTop - argCount, argCount);
+		Value result = (*callable)(interpreter, arguments);
+		pop(argCount + 1);
+		push(result);
+	}
+
+	Upvalue* VM::captureUpvalue(Value* local) {
+		Upvalue* previous = nullptr;
+		Upvalue* upvalue = openUpvalues;
+		while (upvalue != nullptr && upvalue->location > local) {
+			previous = upvalue;
+			upvalue = upvalue->next;
+		}
+
+		if (upvalue != nullptr && upvalue->location == local)
+			return upvalue;
+
+		Upvalue* created = heap.track(new Upvalue(local, upvalue));
+		if (previous == nullptr)
+			openUpvalues = created;
+		else
+			previous->next = created;
+		return created;
+	}
+
+	void VM::closeUpvalues(Value* last) {
+		while (openUpvalues != nullptr && openUpvalues->location >= last) {
+			Upvalue* upvalue = openUpvalues;
+			upvalue->closed = *upvalue->location;
+			upvalue->location = &upvalue->closed;
+			openUpvalues = upvalue->next;
+		}
+	}
+
+	void VM::markRoots(Heap& heap) {
+		for (const Value* slot = stack.data(); slot < stackTop; slot++)
+			heap.mark(*slot);
+		for (int i = 0; i < frameCount; i++)
+			heap.mark(frames[i].callable);
+		for (const Upvalue* upvalue = openUpvalues; upvalue != nullptr; upvalue = upvalue->next)
+			heap.mark(upvalue);
+	}
+
+	void VM::runtimeError(const std::string& message) {
+		const CallFrame& frame = frames[frameCount - 1];
+		const Chunk& chunk = frame.callable->function->chunk;
+		const size_t instruction = frame.ip - chunk.code.data() - 1;
+		runtime->error(chunk.lines[instruction], message);
+		throw new PittaRuntimeException(message);
+	}
+
+
+
+	Value VM::run(int exitFrameCount) {
+		CallFrame* frame;
+		const uint8_t* ip;
+		const Chunk* chunk;
+
+#define LOAD_FRAME()\
+		frame = &frames[frameCount - 1];\
+		ip = frame->ip;\
+		chunk = &frame->callable->function->chunk
+#define STORE_FRAME() frame->ip = ip
+#define READ_BYTE() (*ip++)
+#define READ_SHORT() (ip += 2, uint16_t((ip[-2] << 8) | ip[-1]))
+#define READ_CONSTANT() (chunk->constants[READ_SHORT()])
+#define READ_NAME() (READ_CONSTANT().asSymbol())
+#define VM_ERROR(message) do { STORE_FRAME(); runtimeError(message); } while (false)
+//Reports an error thrown by whatever an instruction called as one from the instruction itself, with its line
+#define VM_REPORT(exception) do { const std::string details = exception->details; delete exception; VM_ERROR(details); } while (false)
+
+#define BINARY_RESULT(result)\
+		do {\
+			peek(1) = Value(result);\
+			pop();\
+		} while (false)
+
+//Replaces the instruction being run, which has no operands, with another
+#define REWRITE_INSTRUCTION(op) (chunk->code[ip - 1 - chunk->code.data()] = uint8_t(OpCode::op))
+
+#define NUMERIC_OP(Symbol, IntOp, FloatOp)\
+		{\
+			const Value& left = peek(1);\
+			const Value& right = peek(0);\
+			switch (left.getType()) {\
+			case Int:\
+				if (right.getType() == Int)\
+					REWRITE_INSTRUCTION(IntOp);\
+				BINARY_RESULT(left.asInt() Symbol right.asInt());\
+				break;\
+			case Float:\
+				if (right.getType() == Float)\
+					REWRITE_INSTRUCTION(FloatOp);\
+				BINARY_RESULT(left.asFloat() Symbol right.asFloat());\
+				break;\
+			default:\
+				VM_ERROR("Invalid numeric types for operator");\
+			}\
+			VM_DISPATCH();\
+		}
+
+#define INTEGER_OP(Symbol)\
+		{\
+			const Value& left = peek(1);\
+			const Value& right = peek(0);\
+			if (left.getType() != Int || right.getType() != Int)\
+				VM_ERROR("Operator can only interact with integer values");\
+			BINARY_RESULT(left.asInt() Symbol right.asInt());\
+			VM_DISPATCH();\
+		}
+
+//Only checks the operand types. Otherwise the general instruction is put back and run in its place
+#define SPECIALISED_OP(Symbol, ValueType, As, GenericOp)\
+		{\
+			const Value& left = peek(1);\
+			const Value& right = peek(0);\
+			if (left.getType() != ValueType || right.getType() != ValueType) {\
+				REWRITE_INSTRUCTION(GenericOp);\
+				ip--;\
+				VM_DISPATCH();\
+			}\
+			BINARY_RESULT(left.As() Symbol right.As());\
+			VM_DISPATCH();\
+		}
+
+#ifdef PITTA_COMPUTED_GOTO
+#define PITTA_LABEL_ADDRESS(name) &&op_##name,
+		static void* dispatchTable[] = { PITTA_OPCODES(PITTA_LABEL_ADDRESS) };
+#undef PITTA_LABEL_ADDRESS
+#define VM_CASE(name) op_##name:
+#define VM_DISPATCH() goto *dispatchTable[READ_BYTE()]
+#else
+#define VM_CASE(name) case OpCode::name:
+#define VM_DISPATCH() continue
+#endif
+
+		LOAD_FRAME();
+
+#ifdef PITTA_COMPUTED_GOTO
+		VM_DISPATCH();
+#else
+		for (;;) {
+			switch (static_cast<OpCode>(READ_BYTE())) {
+#endif
+
+		VM_CASE(CONSTANT) {
+			push(READ_CONSTANT());
+			VM_DISPATCH();
+		}
+		VM_CASE(NIL) {
+			push(Null);
+			VM_DISPATCH();
+		}
+		VM_CASE(UNDEFINED) {
+			push(Undefined);
+			VM_DISPATCH();
+		}
+		VM_CASE(TRUE) {
+			push(true);
+			VM_DISPATCH();
+		}
+		VM_CASE(FALSE) {
+			push(false);
+			VM_DISPATCH();
+		}
+		VM_CASE(POP) {
+			pop();
+			VM_DISPATCH();
+		}
+
+		VM_CASE(GET_LOCAL) {
+			push(frame->slots[READ_BYTE()]);
+			VM_DISPATCH();
+		}
+		VM_CASE(SET_LOCAL) {
+			frame->slots[READ_BYTE()].assign(peek(0).unbound(heap));
+			VM_DISPATCH();
+		}
+		VM_CASE(GET_GLOBAL) {
+			const Symbol name = READ_NAME();
+			STORE_FRAME();
+			push(globals->get(name));
+			VM_DISPATCH();
+		}
+		VM_CASE(DEFINE_GLOBAL) {
+			globals->define(READ_NAME(), peek(0));
+			pop();
+			VM_DISPATCH();
+		}
+		VM_CASE(SET_GLOBAL) {
+			globals->assign(READ_NAME(), peek(0).unbound(heap));
+			VM_DISPATCH();
+		}
+		VM_CASE(GET_UPVALUE) {
+			push(*frame->callable->upvalues[READ_BYTE()]->location);
+			VM_DISPATCH();
+		}
+		VM_CASE(SET_UPVALUE) {
+			frame->callable->upvalues[READ_BYTE()]->location->assign(peek(0).unbound(heap));
+			VM_DISPATCH();
+		}
+
+		VM_CASE(GET_PROPERTY) {
+			const Symbol name = READ_NAME();
+			PropertyCache& cache = chunk->propertyCaches[READ_SHORT()];
+			if (peek(0).getType() != ClassInstance)
+				VM_ERROR("On '" + name.str() + "': Only instances have properties.");
+
+			try {
+				peek(0) = peek(0).asInstance()->get(name, cache, runtime->inlineCaches, heap);
+			}
+			catch (PittaRuntimeException* exception) {
+				VM_REPORT(exception);
+			}
+			VM_DISPATCH();
+		}
+		VM_CASE(SET_PROPERTY) {
+			const Symbol name = READ_NAME();
+			PropertyCache& cache = chunk->propertyCaches[READ_SHORT()];
+			if (peek(1).getType() != ClassInstance)
+				VM_ERROR(name.str() + ": Only instances have fields.");
+
+			try {
+				peek(1).asInstance()->set(name, peek(0).unbound(heap), cache, runtime->inlineCaches);
+			}
+			catch (PittaRuntimeException* exception) {
+				VM_REPORT(exception);
+			}
+			peek(1) = peek(0);
+			pop();
+			VM_DISPATCH();
+		}
+		VM_CASE(GET_SUPER) {
+			const Symbol name = READ_NAME();
+			const Class* superclass = peek(0).asClass();
+			pop();
+			Instance* instance = peek(0).asInstance();
+
+			Callable* method = superclass->findMethod(name);
+			if (method == nullptr)
+				VM_ERROR("Undefined propery '" + name.str() + "'.");
+
+			peek(0) = Value(instance->bindMethod(method));
+			VM_DISPATCH();
+		}
+		VM_CASE(GET_INDEX) {
+			if (peek(1).getType() == Array)
+				peek(1) = peek(1).asArray()->get(peek(0));
+			else if (peek(1).getType() == Map)
+				peek(1) = peek(1).asMap()->get(peek(0));
+			else
+				VM_ERROR("Only arrays and maps can be indexed.");
+			pop();
+			VM_DISPATCH();
+		}
+		VM_CASE(SET_INDEX) {
+			if (peek(2).getType() == Array)
+				peek(2).asArray()->set(peek(1), peek(0).unbound(heap));
+			else if (peek(2).getType() == Map)
+				peek(2).asMap()->set(peek(1).unbound(heap), peek(0).unbound(heap));
+			else
+				VM_ERROR("Only arrays and maps can be indexed.");
+			peek(2) = peek(0);
+			pop(2);
+			VM_DISPATCH();
+		}
+		VM_CASE(BUILD_ARRAY) {
+			const int count = READ_BYTE();
+			//Nothing is collected between here and the push, so the new array needs no rooting
+			ArrayObject* array = heap.track(new ArrayObject());
+			array->reserve(count);
+			for (int i = count - 1; i >= 0; i--)
+				array->push(peek(i).unbound(heap));
+			pop(count);
+			push(array);
+			VM_DISPATCH();
+		}
+		VM_CASE(BUILD_MAP) {
+			//Keys and values alternate on the stack, in the order they were written
+			const int count = READ_BYTE();
+			MapObject* map = heap.track(new MapObject());
+			for (int i = count - 1; i >= 0; i--)
+				map->set(peek(i * 2 + 1).unbound(heap), peek(i * 2).unbound(heap));
+			pop(count * 2);
+			push(map);
+			VM_DISPATCH();
+		}
+		VM_CASE(APPEND_MAP) {
+			const int count = READ_BYTE();
+			MapObject* map = peek(count * 2).asMap();
+			for (int i = count - 1; i >= 0; i--)
+				map->set(peek(i * 2 + 1).unbound(heap), peek(i * 2).unbound(heap));
+			pop(count * 2);
+			VM_DISPATCH();
+		}
+		VM_CASE(APPEND_ARRAY) {
+			const int count = READ_BYTE();
+			ArrayObject* array = peek(count).asArray();
+			for (int i = count - 1; i >= 0; i--)
+				array->push(peek(i).unbound(heap));
+			pop(count);
+			VM_DISPATCH();
+		}
+
+		VM_CASE(EQUAL) {
+			BINARY_RESULT(peek(1) == peek(0));
+			VM_DISPATCH();
+		}
+		VM_CASE(NOT_EQUAL) {
+			BINARY_RESULT(!(peek(1) == peek(0)));
+			VM_DISPATCH();
+		}
+		VM_CASE(GREATER) NUMERIC_OP(>, GREATER_INT, GREATER_FLOAT)
+		VM_CASE(GREATER_EQUAL) NUMERIC_OP(>=, GREATER_EQUAL_INT, GREATER_EQUAL_FLOAT)
+		VM_CASE(LESS) NUMERIC_OP(<, LESS_INT, LESS_FLOAT)
+		VM_CASE(LESS_EQUAL) NUMERIC_OP(<=, LESS_EQUAL_INT, LESS_EQUAL_FLOAT)
+		VM_CASE(ADD) NUMERIC_OP(+, ADD_INT, ADD_FLOAT)
+		VM_CASE(SUBTRACT) NUMERIC_OP(-, SUBTRACT_INT, SUBTRACT_FLOAT)
+		VM_CASE(MULTIPLY) NUMERIC_OP(*, MULTIPLY_INT, MULTIPLY_FLOAT)
+		VM_CASE(DIVIDE) NUMERIC_OP(/, DIVIDE_INT, DIVIDE_FLOAT)
+		VM_CASE(MODULO) INTEGER_OP(%)
+		VM_CASE(BIT_AND) INTEGER_OP(&)
+		VM_CASE(BIT_OR) INTEGER_OP(|)
+		VM_CASE(BIT_XOR) INTEGER_OP(^)
+		VM_CASE(SHIFT_LEFT) {
+			BINARY_RESULT(peek(1).asInt() << peek(0).asInt());
+			VM_DISPATCH();
+		}
+		VM_CASE(SHIFT_RIGHT) {
+			BINARY_RESULT(peek(1).asInt() >> peek(0).asInt());
+			VM_DISPATCH();
+		}
+		VM_CASE(CONCAT) {
+			if (peek(1).getType() != String || peek(0).getType() != String)
+				VM_ERROR("Non string values cannot undergo string style concatination");
+			BINARY_RESULT(heap.makeString(peek(1).asString() + peek(0).asString()));
+			VM_DISPATCH();
+		}
+
+		VM_CASE(NOT) {
+			peek(0) = Value(!peek(0).isTruthy());
+			VM_DISPATCH();
+		}
+		VM_CASE(NEGATE) {
+			switch (peek(0).getType()) {
+			case Int:
+				peek(0) = Value(-1 * peek(0).asInt());
+				break;
+			case Float:
+				peek(0) = Value(-1.0f * peek(0).asFloat());
+				break;
+			default:
+				VM_ERROR("Negation must be followed by and integer or floating point value");
+			}
+			VM_DISPATCH();
+		}
+		VM_CASE(BIT_NOT) {
+			if (peek(0).getType() != Int)
+				VM_ERROR("Logical not operator may only be applied to integer values");
+			peek(0) = Value(~peek(0).asInt());
+			VM_DISPATCH();
+		}
+
+		VM_CASE(ADD_INT) SPECIALISED_OP(+, Int, intValue, ADD)
+		VM_CASE(SUBTRACT_INT) SPECIALISED_OP(-, Int, intValue, SUBTRACT)
+		VM_CASE(MULTIPLY_INT) SPECIALISED_OP(*, Int, intValue, MULTIPLY)
+		VM_CASE(DIVIDE_INT) SPECIALISED_OP(/, Int, intValue, DIVIDE)
+		VM_CASE(LESS_INT) SPECIALISED_OP(<, Int, intValue, LESS)
+		VM_CASE(LESS_EQUAL_INT) SPECIALISED_OP(<=, Int, intValue, LESS_EQUAL)
+		VM_CASE(GREATER_INT) SPECIALISED_OP(>, Int, intValue, GREATER)
+		VM_CASE(GREATER_EQUAL_INT) SPECIALISED_OP(>=, Int, intValue, GREATER_EQUAL)
+		VM_CASE(ADD_FLOAT) SPECIALISED_OP(+, Float, floatValue, ADD)
+		VM_CASE(SUBTRACT_FLOAT) SPECIALISED_OP(-, Float, floatValue, SUBTRACT)
+		VM_CASE(MULTIPLY_FLOAT) SPECIALISED_OP(*, Float, floatValue, MULTIPLY)
+		VM_CASE(DIVIDE_FLOAT) SPECIALISED_OP(/, Float, floatValue, DIVIDE)
+		VM_CASE(LESS_FLOAT) SPECIALISED_OP(<, Float, floatValue, LESS)
+		VM_CASE(LESS_EQUAL_FLOAT) SPECIALISED_OP(<=, Float, floatValue, LESS_EQUAL)
+		VM_CASE(GREATER_FLOAT) SPECIALISED_OP(>, Float, floatValue, GREATER)
+		VM_CASE(GREATER_EQUAL_FLOAT) SPECIALISED_OP(>=, Float, floatValue, GREATER_EQUAL)
+
+		VM_CASE(PRINT) {
+			printf("%s\n", peek(0).toString().c_str());
+			pop();
+			VM_DISPATCH();
+		}
+
+		VM_CASE(JUMP) {
+			const uint16_t offset = READ_SHORT();
+			ip += offset;
+			VM_DISPATCH();
+		}
+		VM_CASE(JUMP_IF_FALSE) {
+			const uint16_t offset = READ_SHORT();
+			if (!peek(0).isTruthy())
+				ip += offset;
+			VM_DISPATCH();
+		}
+		VM_CASE(LOOP) {
+			const uint16_t offset = READ_SHORT();
+			ip -= offset;
+			heap.safePoint();
+			VM_DISPATCH();
+		}
+
+		VM_CASE(CALL) {
+			const int argCount = READ_BYTE();
+			STORE_FRAME();
+			//Everything in use is on the stack between instructions, so this is a safe place to collect
+			heap.safePoint();
+			callValue(argCount);
+			LOAD_FRAME();
+			VM_DISPATCH();
+		}
+		VM_CASE(INVOKE) {
+			const Symbol name = READ_NAME();
+			PropertyCache& cache = chunk->propertyCaches[READ_SHORT()];
+			const int argCount = READ_BYTE();
+			STORE_FRAME();
+			heap.safePoint();
+			invoke(name, cache, argCount);
+			LOAD_FRAME();
+			VM_DISPATCH();
+		}
+		VM_CASE(CLOSURE) {
+			const CompiledFunction* function = chunk->functions[READ_SHORT()];
+			CompiledCallable* closure = heap.track(new CompiledCallable(function, this));
+
+			closure->upvalues.resize(function->upvalueCount);
+			for (int i = 0; i < function->upvalueCount; i++) {
+				const bool isLocal = READ_BYTE() != 0;
+				const uint8_t index = READ_BYTE();
+				closure->upvalues[i] = isLocal ? captureUpvalue(frame->slots + index) : frame->callable->upvalues[index];
+			}
+
+			push(closure);
+			VM_DISPATCH();
+		}
+		VM_CASE(CLOSE_UPVALUE) {
+			closeUpvalues(stackTop - 1);
+			pop();
+			VM_DISPATCH();
+		}
+		VM_CASE(RETURN) {
+			Value result(peek(0));
+			closeUpvalues(frame->slots);
+			pop(stackTop - frame->slots);
+			frameCount -= 1;
+
+			if (frameCount == exitFrameCount)
+				return result;
+
+			push(result);
+			LOAD_FRAME();
+			VM_DISPATCH();
+		}
+		VM_CASE(CLASS) {
+			const Symbol name = READ_NAME();
+			const int methodCount = READ_BYTE();
+			const bool hasSuperclass = READ_BYTE() != 0;
+
+			//Classes hold their methods mutably, but a closure can only be read back out of a value as const
+			std::unordered_map<Symbol, Callable*> methods;
+			for (int i = methodCount - 1; i >= 0; i--) {
+				Callable* method = const_cast<Callable*>(peek(i).asCallable());
+				methods.emplace(method->getName(), method);
+			}
+
+			const Class* superclass = nullptr;
+			if (hasSuperclass) {
+				if (peek(methodCount).getType() != ClassDef)
+					VM_ERROR("Superclass must be a class.");
+				superclass = peek(methodCount).asClass();
+			}
+			pop(methodCount);
+
+			Class* classDefinition = heap.track(new Class(name, superclass, std::move(methods)));
+			push(classDefinition);
+			VM_DISPATCH();
+		}
+
+#ifndef PITTA_COMPUTED_GOTO
+			}
+		}
+#endif
+
+#undef LOAD_FRAME
+#undef STORE_FRAME
+#undef READ_BYTE
+#undef READ_SHORT
+#undef READ_CONSTANT
+#undef READ_NAME
+#undef VM_ERROR
+#undef VM_REPORT
+#undef BINARY_RESULT
+#undef REWRITE_INSTRUCTION
+#undef NUMERIC_OP
+#undef SPECIALISED_OP
+#undef INTEGER_OP
+#undef VM_CASE
+#undef VM_DISPATCH
+	}
+
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include "PittaChunk.hpp"
+#include "PittaFunction.hpp"
+#include "PittaClass.hpp"
+
+//How deep calls can go on the vm before it reports a stack overflow. It is set past where the tree walker runs out
+//of native stack on a default sized thread, so a script that recurses deeply enough for one runs on both
+#ifndef PITTA_VM_MAX_FRAMES
+#define PITTA_VM_MAX_FRAMES (16 * 1024)
+#endif
+
+//How many values the vm's stack can hold, across every call in progress. The space is reserved up front but only
+//used as calls go deeper
+#ifndef PITTA_VM_MAX_STACK
+#define PITTA_VM_MAX_STACK (1024 * 1024)
+#endif
+
+namespace pitta {
+
+	class VM;
+
+	//A local captured by a closure. It points into the vm's stack while the local is alive, and holds
+	//the value itself once the local has gone out of scope
+	class Upvalue : public GCObject {
+	public:
+		Value* location;
+		Value closed;
+		Upvalue* next;
+
+		void trace(Heap& heap)const override {
+			heap.mark(*location);
+		}
+
+		Upvalue(Value* location, Upvalue* next) :
+			location(location),
+			next(next)
+		{}
+	};
+
+	//A compiled function along with the upvalues it closed over
+	class CompiledCallable : public Callable {
+	public:
+		const CompiledFunction* function;
+		std::vector<Upvalue*> upvalues;
+		//Set for methods that have been bound to an instance; placed in the frame's first slot as "this"
+		Instance* boundInstance;
+
+		//Only used when C++ calls into the script, such as from a native function. The vm calls these directly
+		Value operator()(Interpreter* interpreter, Arguments arguments)const override;
+
+		Callable* bind(Instance* instance) override;
+
+		void trace(Heap& heap)const override;
+
+		CompiledCallable(const CompiledFunction* function, VM* vm);
+
+	private:
+		VM* vm;
+	};
+
+	//Stack based alternative to the tree walking interpreter. It shares the interpreter's runtime, globals
+	//and native functions, so scripts and integrations behave the same on either engine
+	class VM : private GCRoots {
+	public:
+
+		void interpret(const std::vector<Stmt<void, Value>*>& statements);
+
+		Value call(const CompiledCallable* callable, Arguments arguments);
+
+		VM(Interpreter* interpreter);
+		VM(const VM&) = delete;
+		~VM();
+
+	private:
+		struct CallFrame {
+			const CompiledCallable* callable;
+			const uint8_t* ip;
+			Value* slots;
+		};
+
+		//Each call is given at least this many values of stack: room for every local it can have, a full batch of
+		//arguments or literal elements on top, and the temporaries of the expression around them
+		static constexpr size_t c_frameStackSize = 1024;
+
+		Interpreter* interpreter;
+		Runtime* runtime;
+		Environment* globals;
+		Heap& heap;
+
+		//Both only ever grow within the capacity reserved for them, so pointers into them stay valid while natives and
+		//outer runs hold on to them
+		std::vector<Value> stack;
+		Value* stackTop;
+		std::vector<CallFrame> frames;
+		int frameCount = 0;
+		Upvalue* openUpvalues = nullptr;
+
+		//Compiled code, deleted along with the vm. Everything made while running belongs to the interpreter's heap
+		std::vector<CompiledFunction*> scripts;
+
+		void push(const Value& value);
+		void pop(size_t count = 1);
+		Value& peek(size_t distance);
+		void resetStack();
+
+		void callValue(int argCount);
+		//Calls the receiver's property straight from the stack, without binding a method to it
+		void invoke(Symbol name, PropertyCache& cache, int argCount);
+		void checkArity(const Callable* callable, int argCount);
+		void callCompiled(const CompiledCallable* callable, int argCount);
+		void callNative(const Callable* callable, int argCount);
+
+		Upvalue* captureUpvalue(Value* local);
+		void closeUpvalues(Value* last);
+
+		[[noreturn]] void runtimeError(const std::string& message);
+
+		Value run(int exitFrameCount);
+
+		void markRoots(Heap& heap) override;
+	};
+}
@@ -1,6 +1,9 @@
 #include "PittaValue.hpp"
 #include "PittaFunction.hpp"
 #include "PittaClass.hpp"
+#include "PittaArray.hpp"
+#include "PittaMap.hpp"
+#include "PittaHeap.hpp"
 #include "PittaIntegration.hpp"
 
 #define basic_numerics \
@@ -52,17 +55,13 @@ namespace pitta {
 		details(detail)
 	{}
 
-	PittaReturn::PittaReturn(Value value) :
-		std::runtime_error("Return exception; should be caught"),
-		value(value)
-	{}
 
 
 
-		//Int, Float, String, Bool, Null, Undefined, ClassInstance, ClassDef, Function
+		//Int, Float, String, Bool, Null, Undefined, ClassInstance, ClassDef, Function, Array, Map
 #define TS(type) { type, #type }
 	const std::unordered_map<Type, std::string> c_typeToString = {
-		TS(Int), TS(Float), TS(String), TS(Bool), TS(Null), TS(Undefined), TS(ClassInstance), TS(ClassDef), TS(Function)
+		TS(Int), TS(Float), TS(String), TS(Bool), TS(Null), TS(Undefined), TS(ClassInstance), TS(ClassDef), TS(Function), TS(Array), TS(Map)
 	};
 #undef TS
 
@@ -70,12 +69,6 @@ namespace pitta {
 		return from.substr(startIndex, endIndex - startIndex);
 	}
 
-	Type Value::getType()const {
-		return type;
-	}
-	bool Value::isBoundValue()const {
-		return isBoundPointer;
-	}
 
 	bool Value::isTruthy()const {
 		switch (getType()) {
@@ -89,6 +82,10 @@ namespace pitta {
 			return asString().size() > 0;
 		case Function:
 			return true;
+		case Array:
+			return !rep.array->empty();
+		case Map:
+			return !rep.map->empty();
 		case Null:
 		case Undefined:
 		default:
@@ -114,16 +111,17 @@ namespace pitta {
 			else
 				return rep.boolVal ? "true" : "false";
 		case String:
-			if (isBoundValue())
-				return *rep.stringValP;
-			else
-				return *stringVal;
+			return asString();
 		case Function:
 			return "Function " + rep.func->getName() + " with arity " + std::to_string(rep.func->getArity());
 		case ClassDef:
 			return rep.classDef->asString();
 		case ClassInstance:
 			return rep.instance->asString();
+		case Array:
+			return rep.array->asString();
+		case Map:
+			return rep.map->asString();
 		case Null:
 			return "Null";
 		case Undefined:
@@ -156,7 +154,9 @@ namespace pitta {
 		if (type == String) {
 			if (isBoundValue())
 				return *rep.stringValP;
-			return *stringVal;
+			if (isHeapString)
+				return rep.stringObject->text;
+			return *rep.stringVal;
 		}
 		throw new PittaRuntimeException("No string conversion acceptable");
 	}
@@ -188,6 +188,35 @@ namespace pitta {
 		return asInstance();
 	}
 
+	ArrayObject* Value::asArray()const {
+		if (type == Array)
+			return rep.array;
+		throw new PittaRuntimeException("No array conversion acceptable");
+	}
+	Value::operator pitta::ArrayObject* ()const {
+		return asArray();
+	}
+
+	MapObject* Value::asMap()const {
+		if (type == Map)
+			return rep.map;
+		throw new PittaRuntimeException("No map conversion acceptable");
+	}
+	Value::operator pitta::MapObject* ()const {
+		return asMap();
+	}
+
+	Symbol Value::asSymbol()const {
+		if (type == String && !isBoundValue() && !isHeapString)
+			return Symbol(rep.stringVal);
+		return Symbol(asString());
+	}
+	const StringObject* Value::asHeapString()const {
+		if (type == String && !isBoundValue() && isHeapString)
+			return rep.stringObject;
+		return nullptr;
+	}
+
 	vec2 Value::asVec2()const {
 		if ((void*)rep.instance->getDefinition() != (void*)vec2Binding) {
 			throw new PittaRuntimeException("Value is not an instance of vec2");
@@ -245,7 +274,8 @@ namespace pitta {
 		}
 		else {
 			type = String;
-			*stringVal = value;
+			isHeapString = false;
+			rep.stringVal = StringTable::current().intern(value);
 		}
 	}
 	void Value::setCallable(const Callable* callable) {
@@ -266,6 +296,18 @@ namespace pitta {
 		type = ClassInstance;
 		rep.instance = instance;
 	}
+	void Value::setArray(ArrayObject* array) {
+		if (!(type == Null || type == Undefined || type == Array))
+			throw new PittaRuntimeException("Cannot assign an array to a non-array, null or undefined value");
+		type = Array;
+		rep.array = array;
+	}
+	void Value::setMap(MapObject* map) {
+		if (!(type == Null || type == Undefined || type == Map))
+			throw new PittaRuntimeException("Cannot assign a map to a non-map, null or undefined value");
+		type = Map;
+		rep.map = map;
+	}
 	void Value::setNull() {
 		if (isBoundValue()) {
 			throw new PittaRuntimeException("Cannot set a bound value to null");
@@ -297,10 +339,16 @@ namespace pitta {
 	void Value::bindString(std::string* toBind) {
 		isBoundPointer = true;
 		type = String;
+		isHeapString = false;
 		rep.stringValP = toBind;
 	}
 
-	Value& Value::operator=(const Value& right) {
+	Value& Value::assign(const Value& right) {
+		if (!isBoundValue() && !right.isBoundValue() && right.type == String && (type == String || type == Null || type == Undefined)) {
+			//Interned or owned by a heap already, so the value can just be copied
+			*this = right;
+			return *this;
+		}
 		switch (right.type) {
 		case Int:
 			setInt(right.asInt());
@@ -323,6 +371,12 @@ namespace pitta {
 		case ClassInstance:
 			setInstance(right.asInstance());
 			break;
+		case Array:
+			setArray(right.asArray());
+			break;
+		case Map:
+			setMap(right.asMap());
+			break;
 		case Null:
 			setNull();
 			break;
@@ -334,6 +388,21 @@ namespace pitta {
 		}
 		return *this;
 	}
+	Value Value::copyBound(Heap& heap)const {
+		switch (type) {
+		case Int:
+			return *rep.intValP;
+		case Float:
+			return *rep.floatValP;
+		case Bool:
+			return *rep.boolValP;
+		case String:
+			return heap.makeString(*rep.stringValP);
+		default:
+			throw new PittaRuntimeException("No conversions for bound values available");
+		}
+	}
+
 	Value& Value::operator=(int value) {
 		setInt(value);
 		return *this;
@@ -365,6 +434,14 @@ namespace pitta {
 		setInstance(instance);
 		return *this;
 	}
+	Value& Value::operator=(ArrayObject* array) {
+		setArray(array);
+		return *this;
+	}
+	Value& Value::operator=(MapObject* map) {
+		setMap(map);
+		return *this;
+	}
 	Value& Value::operator=(Type type) {
 		if (type == Undefined)
 			setUndefined();
@@ -389,7 +466,17 @@ namespace pitta {
 			case Bool:
 				return asBool() == right.asBool();
 			case String:
+				if (right.getType() != String)
+					return false;
+				//Two interned strings are only equal if they are the same string
+				if (!isBoundValue() && !right.isBoundValue() && !isHeapString && !right.isHeapString)
+					return rep.stringVal == right.rep.stringVal;
 				return asString() == right.asString();
+			case Array:
+				//Arrays and maps are compared by identity, like the objects they are
+				return right.getType() == Array && rep.array == right.rep.array;
+			case Map:
+				return right.getType() == Map && rep.map == right.rep.map;
 			default:
 				printf("Comparison with unknown type\n");
 			}
@@ -408,18 +495,22 @@ namespace pitta {
 			throw - 1;
 		}
 	}
-	Value::Value(int val) {
-		setInt(val);
-	}
-	Value::Value(float val) {
-		setFloat(val);
-	}
-	Value::Value(bool val) {
-		setBool(val);
-	}
 	Value::Value(const std::string& val) {
 		setString(val);
 	}
+	Value::Value(const char* val) :
+		Value(Symbol(val))
+	{}
+	Value::Value(Symbol val) {
+		type = String;
+		rep.stringVal = &val.str();
+	}
+	Value::Value(const StringObject* string) :
+		type(String),
+		isHeapString(true)
+	{
+		rep.stringObject = string;
+	}
 	Value::Value(int* val) {
 		bindInt(val);
 	}
@@ -441,12 +532,11 @@ namespace pitta {
 	Value::Value(Instance* instance) {
 		setInstance(instance);
 	}
-	Value::Value(const Value& value) {
-		rep = value.rep;
-		type = value.type;
-		isBoundPointer = value.isBoundPointer;
-		if (type == String && !isBoundPointer)
-			*stringVal = *value.stringVal;
+	Value::Value(ArrayObject* array) {
+		setArray(array);
+	}
+	Value::Value(MapObject* map) {
+		setMap(map);
 	}
 
 }
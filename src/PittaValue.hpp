@@ -3,13 +3,16 @@
 #include <stdexcept>
 #include <unordered_map>
 #include <memory>
+#include <type_traits>
+#include <vector>
 #include "SharedData.hpp"
+#include "PittaStringTable.hpp"
 #include "PittaHigherTypes.hpp"
 
 namespace pitta {
 
 	enum Type : char {
-		Int, Float, String, Bool, Null, Undefined, ClassInstance, ClassDef, Function
+		Int, Float, String, Bool, Null, Undefined, ClassInstance, ClassDef, Function, Array, Map
 	};
 
 	extern const std::unordered_map<Type, std::string> c_typeToString;
@@ -17,9 +20,16 @@ namespace pitta {
 	class Callable;
 	class Class;
 	class Instance;
+	class ArrayObject;
+	class MapObject;
+	class StringObject;
+	class Heap;
 
 	std::string getSubstring(const std::string& from, int startIndex, int endIndex);
 
+	//A tag and an 8 byte payload, copied as plain memory. Names and literals are interned strings; strings made while
+	//a script runs are owned by the heap that made them, and values only point at them.
+	//Bound values point at memory owned by C++; copies keep pointing at it, and assign writes through it
 	class Value {
 	public:
 		Type getType()const;
@@ -35,6 +45,10 @@ namespace pitta {
 		float asFloat()const;
 		operator float()const;
 
+		//The number in a value already known to be an int or a float, without converting between them
+		int intValue()const;
+		float floatValue()const;
+
 		bool asBool()const;
 		operator bool()const;
 
@@ -50,6 +64,17 @@ namespace pitta {
 		Instance* asInstance()const;
 		operator Instance* ()const;
 
+		ArrayObject* asArray()const;
+		operator ArrayObject* ()const;
+
+		MapObject* asMap()const;
+		operator MapObject* ()const;
+
+		//The string as a symbol, which is free for interned strings
+		Symbol asSymbol()const;
+		//The object holding a string made at runtime, or nullptr if the value is anything else
+		const StringObject* asHeapString()const;
+
 		//Shortcuts for when we just want the value
 		vec2 asVec2()const;
 		vec3 asVec3()const;
@@ -62,10 +87,13 @@ namespace pitta {
 		void setInt(int value);
 		void setFloat(float value);
 		void setBool(bool value);
+		//Interns the text, unless the value is bound. Strings made while a script runs go through Heap::makeString instead
 		void setString(const std::string& value);
 		void setCallable(const Callable* callable);
 		void setClass(const Class* classDef);
 		void setInstance(Instance* instance);
+		void setArray(ArrayObject* array);
+		void setMap(MapObject* map);
 		/*void setVector(vec2 vec);
 		void setVector(vec3 vec);
 		void setVector(vec4 vec);*/
@@ -77,7 +105,13 @@ namespace pitta {
 		void bindBool(bool* toBind);
 		void bindString(std::string* toBind);
 
-		Value& operator=(const Value& right);
+		//Assignment as the script sees it; writes through bound values and keeps the type restrictions of the set functions.
+		//Plain copy assignment just copies the value. A bound string should be unbound before it is assigned to
+		//anything that isn't bound, or its text is interned
+		Value& assign(const Value& right);
+		//A copy of the value this refers to, no longer bound to C++ memory. A bound string is copied into the heap
+		Value unbound(Heap& heap)const;
+
 		Value& operator=(int value);
 		Value& operator=(float value);
 		Value& operator=(bool value);
@@ -85,6 +119,8 @@ namespace pitta {
 		Value& operator=(const Callable* callable);
 		Value& operator=(const Class* classDef);
 		Value& operator=(Instance* instance);
+		Value& operator=(ArrayObject* array);
+		Value& operator=(MapObject* map);
 		Value& operator=(Type);
 
 		bool operator==(const Value& right)const;
@@ -95,6 +131,9 @@ namespace pitta {
 		Value(float val);
 		Value(bool val);
 		Value(const std::string & val);
+		//Without this a string literal would convert to bool before it converted to std::string
+		Value(const char* val);
+		Value(Symbol val);
 		Value(int* val);
 		Value(float* val);
 		Value(bool* val);
@@ -102,22 +141,101 @@ namespace pitta {
 		Value(const Callable* callable);
 		Value(const Class* classDef);
 		Value(Instance* instance);
-		Value(const Value& value);
+		Value(ArrayObject* array);
+		Value(MapObject* map);
+		Value(const StringObject* string);
 
 	private:
 		Type type = Undefined;
 		bool isBoundPointer = false;
+		//Only means anything for strings, and is set whenever a value becomes one
+		bool isHeapString = false;
+
+		Value copyBound(Heap& heap)const;
 
 		union {
+			Instance* instance = nullptr;
 			int intVal, * intValP;
 			float floatVal, * floatValP;
 			bool boolVal, * boolValP;
+			const std::string* stringVal;
 			std::string* stringValP;
+			const StringObject* stringObject;
 			const Callable* func;
 			const Class* classDef;
-			Instance* instance;
+			ArrayObject* array;
+			MapObject* map;
 		} rep;
-		std::unique_ptr<std::string> stringVal = std::make_unique<std::string>();
+	};
+
+	//Defined here so the operators of both engines can inline them
+	inline Type Value::getType()const {
+		return type;
+	}
+	inline bool Value::isBoundValue()const {
+		return isBoundPointer;
+	}
+	inline Value Value::unbound(Heap& heap)const {
+		return isBoundPointer ? copyBound(heap) : *this;
+	}
+	inline int Value::intValue()const {
+		return isBoundPointer ? *rep.intValP : rep.intVal;
+	}
+	inline float Value::floatValue()const {
+		return isBoundPointer ? *rep.floatValP : rep.floatVal;
+	}
+	inline Value::Value(int val) :
+		type(Int)
+	{
+		rep.intVal = val;
+	}
+	inline Value::Value(float val) :
+		type(Float)
+	{
+		rep.floatVal = val;
+	}
+	inline Value::Value(bool val) :
+		type(Bool)
+	{
+		rep.boolVal = val;
+	}
+
+	static_assert(std::is_trivially_copyable<Value>::value, "Values are copied as plain memory");
+	static_assert(sizeof(Value) <= 2 * sizeof(void*), "Values should be a tag and a pointer sized payload");
+
+	//The arguments of a call, viewed where they already are, usually on the stack of whichever engine made the call.
+	//Only valid during the call, so callables copy out anything they want to keep
+	class Arguments {
+	public:
+		const Value* begin()const {
+			return first;
+		}
+		const Value* end()const {
+			return first + count;
+		}
+		size_t size()const {
+			return count;
+		}
+		bool empty()const {
+			return count == 0;
+		}
+		const Value& operator[](size_t index)const {
+			return first[index];
+		}
+
+		Arguments() = default;
+		Arguments(const Value* first, size_t count) :
+			first(first),
+			count(count)
+		{}
+		Arguments(const std::vector<Value>& values) :
+			first(values.data()),
+			count(values.size())
+		{}
+
+	private:
+		const Value* first = nullptr;
+		size_t count = 0;
 	};
 
 	class PittaRuntimeException final : public std::runtime_error {
@@ -129,13 +247,6 @@ namespace pitta {
 		PittaRuntimeException(const std::string& detail);
 	};
 
-	class PittaReturn final : public std::runtime_error {
-	public:
-		Value value;
-
-		PittaReturn(Value value);
-	};
-
 }
 
 typedef pitta::Value PittaValue;
\ No newline at end of file
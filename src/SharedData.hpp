@@ -1,9 +1,56 @@
 #pragma once
 #include <stdio.h>
 #include<memory>
+#include <atomic>
+#include <type_traits>
+
+//Set to 1 so reference counts can be changed from several threads at once, at the cost of every copy being an atomic operation
+#ifndef PITTA_ATOMIC_REFCOUNT
+#define PITTA_ATOMIC_REFCOUNT 0
+#endif
 
 namespace pitta {
 
+#if PITTA_ATOMIC_REFCOUNT
+	using reference_count = std::atomic<size_t>;
+#else
+	using reference_count = size_t;
+#endif
+
+	inline void retainReference(reference_count& count) {
+#if PITTA_ATOMIC_REFCOUNT
+		count.fetch_add(1, std::memory_order_relaxed);
+#else
+		count += 1;
+#endif
+	}
+
+	//Returns true when that was the last reference
+	inline bool releaseReference(reference_count& count) {
+#if PITTA_ATOMIC_REFCOUNT
+		return count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+#else
+		return --count == 0;
+#endif
+	}
+
+	//Types deriving from this keep their reference count inside themselves, so sharing one needs a single allocation
+	class intrusive_count {
+	public:
+		intrusive_count() {}
+		//A copy is a new object, nothing refers to it yet
+		intrusive_count(const intrusive_count&) {}
+		intrusive_count& operator=(const intrusive_count&) {
+			return *this;
+		}
+
+	private:
+		template<class T>
+		friend class shared_data;
+
+		mutable reference_count referenceCount{ 0 };
+	};
+
 	template<class T>
 	class shared_data {
 	public:
@@ -38,11 +85,22 @@ namespace pitta {
 		}
 
 		shared_data<T>& operator=(const shared_data<T>& other) {
+			//Taken first, in case this is the last reference to what is being assigned
+			if (other.usageCount != nullptr)
+				retainReference(*other.usageCount);
 			decrimentIfInUse();
 			ptr = other.ptr;
 			usageCount = other.usageCount;
-			if (usageCount != nullptr)
-				(*usageCount) += 1;
+			return *this;
+		}
+		shared_data<T>& operator=(shared_data<T>&& other) {
+			if (this != &other) {
+				decrimentIfInUse();
+				ptr = other.ptr;
+				usageCount = other.usageCount;
+				other.ptr = nullptr;
+				other.usageCount = nullptr;
+			}
 			return *this;
 		}
 
@@ -51,23 +109,26 @@ namespace pitta {
 			usageCount(nullptr)
 		{}
 		shared_data(const T& data):
-			ptr(new T(data)),
-			usageCount(new size_t(1))
+			shared_data(new T(data))
 		{}
 		shared_data(T&& data):
-			ptr(new T(std::move(data))),
-			usageCount(new size_t(1))
+			shared_data(new T(std::move(data)))
 		{}
 		shared_data(T* data, usage_flag usage = usage_flag::Internal_Usage) :
 			ptr(data),
-			usageCount(usage == usage_flag::Internal_Usage ? new size_t(1) : nullptr)
-		{}
+			usageCount(nullptr)
+		{
+			if (usage == usage_flag::Internal_Usage && data != nullptr) {
+				usageCount = newCount(data);
+				retainReference(*usageCount);
+			}
+		}
 		shared_data(const shared_data& copy) :
 			ptr(copy.ptr),
 			usageCount(copy.usageCount)
 		{
 			if (usageCount != nullptr)
-				(*usageCount) += 1;
+				retainReference(*usageCount);
 		}
 		shared_data(shared_data&& move):
 			ptr(move.ptr),
@@ -83,22 +144,32 @@ namespace pitta {
 
 	private:
 		T* ptr;
-		size_t* usageCount;//If nullptr, then there is no usage, pitta does not own this data
+		reference_count* usageCount;//If nullptr, then there is no usage, pitta does not own this data
+
+		static constexpr bool isIntrusive() {
+			return std::is_base_of<intrusive_count, T>::value;
+		}
+
+		static reference_count* newCount(T* data) {
+			if constexpr (isIntrusive())
+				return &data->referenceCount;
+			else
+				return new reference_count(0);
+		}
 
 		void decrimentIfInUse() {
-			if (usageCount != nullptr) {
-				(*usageCount) -= 1;
-				if (*usageCount == 0) {
+			if (usageCount != nullptr && releaseReference(*usageCount)) {
+				//An intrusive count goes with the object
+				if constexpr (!isIntrusive())
 					delete usageCount;
-					delete ptr;
-				}
+				delete ptr;
 			}
 		}
 	};
 
 	template<class T, class... Args>
 	shared_data<T> make_shared_data(Args&&... args) {
-		shared_data<T> data(new T(std::move(args)...));
+		shared_data<T> data(new T(std::forward<Args>(args)...));
 		return data;
 	}
-}
\ No newline at end of file
+}